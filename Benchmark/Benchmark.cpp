@@ -0,0 +1,548 @@
+/////////////////////////////////////////////////////////////////////////////
+// Copyright  by W. T. Block, all rights reserved
+/////////////////////////////////////////////////////////////////////////////
+// a headless benchmark of the portable stages of OffsetHours which creates
+// a synthetic corpus and measures the files per second and megabytes per
+// second of each stage: walk, read, parse, shift and write
+#include "CorpusGenerator.h"
+#include "DirectoryWalker.h"
+#include "ExifDate.h"
+#include "ExifPatcher.h"
+#include "ExifReader.h"
+#include "FileClassifier.h"
+#include "FileClone.h"
+#include "FolderCache.h"
+#include "Pipeline.h"
+#include <stdlib.h>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/////////////////////////////////////////////////////////////////////////////
+// the command line settings of the benchmark
+typedef struct tagBenchSettings
+{
+	// the corpus to create or reuse
+	CORPUS_SETTINGS m_Corpus;
+
+	// worker threads of the walk, read and write stages
+	int m_nThreads;
+
+	// the number of times the parse and shift stages are repeated so
+	// they run long enough to be timed
+	int m_nRepeat;
+
+	// reuse the corpus in the root folder instead of creating one
+	bool m_bReuse;
+
+	// leave the corpus in place when the benchmark is done
+	bool m_bKeep;
+
+} BENCH_SETTINGS;
+
+/////////////////////////////////////////////////////////////////////////////
+// what a file contributed to the read stage
+typedef struct tagBenchFile
+{
+	// the full pathname of the file
+	string m_csPath;
+
+	// the size of the file in bytes
+	unsigned long long m_ullSize;
+
+	// the header was read and both dates can be patched in place
+	bool m_bComplete;
+
+	// the reader kept for the write stage
+	CExifReader m_Reader;
+
+	// the pathname of the corrected copy or empty if none was written
+	string m_csCopy;
+
+	// the shifted date written to the corrected copy
+	char m_szShifted[ 20 ];
+
+} BENCH_FILE;
+
+/////////////////////////////////////////////////////////////////////////////
+// the seconds since the given time
+static inline double GetSeconds( chrono::steady_clock::time_point tStart )
+{
+	return chrono::duration<double>( chrono::steady_clock::now() - tStart ).count();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// print one line of the results table
+static void Report
+(
+	const char* pcszStage, unsigned long long ullItems,
+	unsigned long long ullBytes, double dSeconds
+)
+{
+	if ( dSeconds <= 0.0 )
+	{
+		dSeconds = 1e-9;
+	}
+
+	printf
+	(
+		"%-10s %12llu %10.3f %14.0f %10.1f\n",
+		pcszStage, ullItems, dSeconds,
+		(double)ullItems / dSeconds,
+		(double)ullBytes / ( 1024.0 * 1024.0 ) / dSeconds
+	);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// run the work function on the given number of threads where each call
+// claims the next index until all of the items are done
+static void ParallelFor
+(
+	int nThreads, size_t tItems, function<void( size_t tItem )> work
+)
+{
+	atomic<size_t> tNext( 0 );
+	CPipelineStage stage;
+	stage.Start
+	(
+		nThreads,
+		[ & ]()
+		{
+			size_t tItem = 0;
+			while ( ( tItem = tNext++ ) < tItems )
+			{
+				work( tItem );
+			}
+		},
+		[]() {}
+	);
+	stage.Join();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// clone a file into its corrected folder and patch its dates the way the
+// tool does, naming the copy relative to the folder's handle when one is
+// held
+static bool WriteCopy
+(
+	const BENCH_FILE& file, const string& csCopy, int nFolder,
+	const string& csName, const char* pcszDate
+)
+{
+#ifdef _WIN32
+	return
+		CFileClone::Clone( file.m_csPath.c_str(), csCopy.c_str() ) &&
+		CExifPatcher::Patch( csCopy.c_str(), file.m_Reader, pcszDate );
+#else
+	const string& csTarget = nFolder >= 0 ? csName : csCopy;
+	if ( nFolder < 0 )
+	{
+		nFolder = AT_FDCWD;
+	}
+
+	return
+		CFileClone::Clone( file.m_csPath.c_str(), nFolder, csTarget.c_str() ) &&
+		CExifPatcher::Patch
+		(
+			CFolderCache::OpenFile( nFolder, csTarget.c_str() ),
+			file.m_Reader, pcszDate
+		);
+#endif
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// show the command line
+static void Usage()
+{
+	printf
+	(
+		"Usage:\n"
+		".  OffsetHoursBenchmark [options]\n"
+		".\n"
+		"Where:\n"
+		".  --root folder     where the corpus is created (default\n"
+		".                    offsethours-corpus)\n"
+		".  --files n         image files in the corpus (default 2000)\n"
+		".  --depth n         folder levels below the root (default 3)\n"
+		".  --width n         sub-folders in each folder (default 4)\n"
+		".  --min-size n      smallest file in bytes (default 4096)\n"
+		".  --max-size n      largest file in bytes (default 262144)\n"
+		".  --seed n          random seed of the corpus (default 1)\n"
+		".  --threads n       walk, read and write threads (default\n"
+		".                    the number of cores)\n"
+		".  --repeat n        passes of the parse and shift stages\n"
+		".                    (default 100)\n"
+		".  --reuse           measure the corpus already in the root\n"
+		".  --keep            leave the corpus when done\n"
+	);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// read the command line, returning false if it is not valid
+static bool ParseArgs( int argc, char* argv[], BENCH_SETTINGS& settings )
+{
+	settings.m_Corpus.m_csRoot = "offsethours-corpus";
+	settings.m_Corpus.m_tFiles = 2000;
+	settings.m_Corpus.m_nDepth = 3;
+	settings.m_Corpus.m_nWidth = 4;
+	settings.m_Corpus.m_tMinSize = 4096;
+	settings.m_Corpus.m_tMaxSize = 256 * 1024;
+	settings.m_Corpus.m_ullSeed = 1;
+	settings.m_nThreads = (int)thread::hardware_concurrency();
+	if ( settings.m_nThreads < 1 )
+	{
+		settings.m_nThreads = 1;
+	}
+	settings.m_nRepeat = 100;
+	settings.m_bReuse = false;
+	settings.m_bKeep = false;
+
+	for ( int nArg = 1; nArg < argc; nArg++ )
+	{
+		const string csArg = argv[ nArg ];
+		if ( csArg == "--reuse" )
+		{
+			settings.m_bReuse = true;
+			continue;
+		}
+		if ( csArg == "--keep" )
+		{
+			settings.m_bKeep = true;
+			continue;
+		}
+		if ( nArg + 1 >= argc )
+		{
+			return false;
+		}
+
+		const char* pcszValue = argv[ ++nArg ];
+		const unsigned long long ullValue = strtoull( pcszValue, nullptr, 10 );
+		if ( csArg == "--root" )
+		{
+			settings.m_Corpus.m_csRoot = pcszValue;
+
+		} else if ( csArg == "--files" )
+		{
+			settings.m_Corpus.m_tFiles = (size_t)ullValue;
+
+		} else if ( csArg == "--depth" )
+		{
+			settings.m_Corpus.m_nDepth = (int)ullValue;
+
+		} else if ( csArg == "--width" )
+		{
+			settings.m_Corpus.m_nWidth = (int)ullValue;
+
+		} else if ( csArg == "--min-size" )
+		{
+			settings.m_Corpus.m_tMinSize = (size_t)ullValue;
+
+		} else if ( csArg == "--max-size" )
+		{
+			settings.m_Corpus.m_tMaxSize = (size_t)ullValue;
+
+		} else if ( csArg == "--seed" )
+		{
+			settings.m_Corpus.m_ullSeed = ullValue;
+
+		} else if ( csArg == "--threads" )
+		{
+			settings.m_nThreads = ullValue < 1 ? 1 : (int)ullValue;
+
+		} else if ( csArg == "--repeat" )
+		{
+			settings.m_nRepeat = ullValue < 1 ? 1 : (int)ullValue;
+
+		} else
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+int main( int argc, char* argv[] )
+{
+	BENCH_SETTINGS settings;
+	if ( !ParseArgs( argc, argv, settings ) )
+	{
+		Usage();
+		return 1;
+	}
+
+	const string& csRoot = settings.m_Corpus.m_csRoot;
+	error_code error;
+
+	// create the corpus
+	if ( !settings.m_bReuse )
+	{
+		// never write over a folder that may hold real images
+		if ( filesystem::exists( csRoot, error ) )
+		{
+			printf
+			(
+				"%s already exists, remove it or measure it with --reuse\n",
+				csRoot.c_str()
+			);
+			return 2;
+		}
+
+		CCorpusGenerator generator;
+		const auto tStart = chrono::steady_clock::now();
+		if ( !generator.Generate( settings.m_Corpus ) )
+		{
+			printf( "Unable to create the corpus in %s\n", csRoot.c_str() );
+			return 2;
+		}
+		const double dSeconds = GetSeconds( tStart );
+
+		printf
+		(
+			"Corpus: %zu folders, %zu JPEG, %zu TIFF, %zu PNG files, "
+			"%zu valid, %zu original only, %zu missing, %zu malformed dates\n",
+			generator.GetFolders(),
+			generator.GetFiles( CCorpusGenerator::ikJPEG ),
+			generator.GetFiles( CCorpusGenerator::ikTIFF ),
+			generator.GetFiles( CCorpusGenerator::ikPNG ),
+			generator.GetDates( CCorpusGenerator::dkValid ),
+			generator.GetDates( CCorpusGenerator::dkOriginalOnly ),
+			generator.GetDates( CCorpusGenerator::dkMissing ),
+			generator.GetDates( CCorpusGenerator::dkMalformed )
+		);
+		printf( ".\n%-10s %12s %10s %14s %10s\n", "stage", "items", "seconds", "items/s", "MB/s" );
+		Report
+		(
+			"generate", settings.m_Corpus.m_tFiles,
+			generator.GetBytes( CCorpusGenerator::ikJPEG ) +
+			generator.GetBytes( CCorpusGenerator::ikTIFF ) +
+			generator.GetBytes( CCorpusGenerator::ikPNG ),
+			dSeconds
+		);
+
+	} else
+	{
+		printf( ".\n%-10s %12s %10s %14s %10s\n", "stage", "items", "seconds", "items/s", "MB/s" );
+	}
+
+	// walk: enumerate the image files of the tree skipping the corrected
+	// folders
+	vector<BENCH_FILE> files;
+	mutex lock;
+	CDirectoryWalker walker;
+	walker.SetThreads( settings.m_nThreads );
+	walker.SetExclude( "Corrected" );
+	auto tStart = chrono::steady_clock::now();
+	walker.Walk
+	(
+		csRoot, "*", true,
+		[ & ]( const CPathView& path, int )
+		{
+			if ( CFileClassifier::GetPathKind( path ) == CFileClassifier::fkNone )
+			{
+				return;
+			}
+
+			lock_guard<mutex> guard( lock );
+			files.push_back( BENCH_FILE() );
+			files.back().m_csPath = path.GetPath();
+		}
+	);
+	Report( "walk", files.size(), 0, GetSeconds( tStart ) );
+
+	// the sizes are not part of any stage
+	unsigned long long ullBytes = 0;
+	for ( BENCH_FILE& file : files )
+	{
+		file.m_ullSize = filesystem::file_size( file.m_csPath, error );
+		ullBytes += error ? 0 : file.m_ullSize;
+	}
+
+	// read: find the dates in the headers
+	tStart = chrono::steady_clock::now();
+	ParallelFor
+	(
+		settings.m_nThreads, files.size(),
+		[ & ]( size_t tFile )
+		{
+			BENCH_FILE& file = files[ tFile ];
+			file.m_bComplete =
+				file.m_Reader.Read( file.m_csPath.c_str() ) &&
+				file.m_Reader.GetComplete();
+			file.m_Reader.Release();
+		}
+	);
+	Report( "read", files.size(), ullBytes, GetSeconds( tStart ) );
+
+	// gather the date values as fixed 20 byte records
+	vector<char> dates;
+	for ( const BENCH_FILE& file : files )
+	{
+		const char* pcszDate = file.m_Reader.GetValue( CExifReader::ttDTOrig );
+		if ( *pcszDate != 0 )
+		{
+			const size_t tDate = dates.size();
+			dates.resize( tDate + 20 );
+			const size_t tLength = strlen( pcszDate );
+			memcpy( dates.data() + tDate, pcszDate, tLength < 19 ? tLength : 19 );
+		}
+	}
+	const size_t tDates = dates.size() / 20;
+
+	// parse: validate the layout and the calendar of every date
+	size_t tValid = 0;
+	tStart = chrono::steady_clock::now();
+	for ( int nPass = 0; nPass < settings.m_nRepeat; nPass++ )
+	{
+		tValid = 0;
+		for ( size_t tDate = 0; tDate < tDates; tDate++ )
+		{
+			DATE_FIELDS fields;
+			if
+			(
+				CExifDate::Parse( dates.data() + tDate * 20, 20, fields ) &&
+				CExifDate::IsValid( fields )
+			)
+			{
+				tValid++;
+			}
+		}
+	}
+	Report
+	(
+		"parse", (unsigned long long)tDates * settings.m_nRepeat,
+		(unsigned long long)tDates * settings.m_nRepeat * 20, GetSeconds( tStart )
+	);
+
+	// shift: move every date by an hour and a second
+	vector<char> shifted( dates.size() );
+	const int64_t llOffset = CExifDate::GetOffsetMilliseconds( 1.0 + 1.0 / 3600.0 );
+	tStart = chrono::steady_clock::now();
+	for ( int nPass = 0; nPass < settings.m_nRepeat; nPass++ )
+	{
+		CExifDate::ShiftBatch( dates.data(), tDates, llOffset, shifted.data() );
+	}
+	Report
+	(
+		"shift", (unsigned long long)tDates * settings.m_nRepeat,
+		(unsigned long long)tDates * settings.m_nRepeat * 20, GetSeconds( tStart )
+	);
+
+	// write: clone each file that can be patched into a corrected folder
+	// and patch its dates, creating each corrected folder once and 
+	// opening the copies relative to it
+	CFolderCache folders;
+	atomic<unsigned long long> ullWritten( 0 );
+	atomic<unsigned long long> ullWrittenBytes( 0 );
+	tStart = chrono::steady_clock::now();
+	ParallelFor
+	(
+		settings.m_nThreads, files.size(),
+		[ & ]( size_t tFile )
+		{
+			BENCH_FILE& file = files[ tFile ];
+			if ( !file.m_bComplete )
+			{
+				return;
+			}
+
+			const CPathView path( file.m_csPath );
+			const string csFolder = string( path.GetFolder() ) + "Corrected";
+			const string csName( path.GetDataName() );
+#ifdef _WIN32
+			const string csCopy = csFolder + "\\" + csName;
+#else
+			const string csCopy = csFolder + "/" + csName;
+#endif
+			int nFolder = -1;
+			if ( !folders.Ensure( csFolder, nFolder ) )
+			{
+				return;
+			}
+
+			char szDate[ 20 ];
+			const char* pcszDate = file.m_Reader.GetValue( CExifReader::ttDTOrig );
+			if
+			(
+				CExifDate::Shift( pcszDate, strlen( pcszDate ), llOffset, szDate ) &&
+				WriteCopy( file, csCopy, nFolder, csName, szDate )
+			)
+			{
+				file.m_csCopy = csCopy;
+				memcpy( file.m_szShifted, szDate, sizeof( szDate ) );
+				ullWritten++;
+				ullWrittenBytes += file.m_ullSize;
+			}
+		}
+	);
+	Report( "write", ullWritten, ullWrittenBytes, GetSeconds( tStart ) );
+
+	// in place: patch the dates of each corrected copy in the copy itself
+	// with a single write, putting the original dates back, so the corpus
+	// is never written
+	atomic<unsigned long long> ullPatched( 0 );
+	tStart = chrono::steady_clock::now();
+	ParallelFor
+	(
+		settings.m_nThreads, files.size(),
+		[ & ]( size_t tFile )
+		{
+			const BENCH_FILE& file = files[ tFile ];
+			const char* pcszDate = file.m_Reader.GetValue( CExifReader::ttDTOrig );
+			if
+			(
+				!file.m_csCopy.empty() &&
+				CExifPatcher::GetFits( file.m_Reader ) &&
+				strlen( pcszDate ) == 19 &&
+				CExifPatcher::PatchInPlace
+				(
+					file.m_csCopy.c_str(), file.m_Reader, pcszDate,
+					file.m_szShifted
+				)
+			)
+			{
+				ullPatched++;
+			}
+		}
+	);
+	Report( "in-place", ullPatched, 0, GetSeconds( tStart ) );
+
+	// remove the corrected folders the write stage created so a later
+	// run with --reuse measures the same corpus
+	folders.Clear();
+	set<string> corrected;
+	for ( const BENCH_FILE& file : files )
+	{
+		if ( file.m_bComplete )
+		{
+			const CPathView path( file.m_csPath );
+			corrected.insert( string( path.GetFolder() ) + "Corrected" );
+		}
+	}
+	for ( const string& csFolder : corrected )
+	{
+		filesystem::remove_all( csFolder, error );
+	}
+
+	printf
+	(
+		".\n%zu files, %zu dates, %zu valid, %llu written, %llu patched in place\n",
+		files.size(), tDates, tValid, ullWritten.load(), ullPatched.load()
+	);
+
+	if ( !settings.m_bKeep && !settings.m_bReuse )
+	{
+		filesystem::remove_all( csRoot, error );
+	}
+
+	return 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,611 @@
+/////////////////////////////////////////////////////////////////////////////
+// Copyright  by W. T. Block, all rights reserved
+/////////////////////////////////////////////////////////////////////////////
+#pragma once
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/////////////////////////////////////////////////////////////////////////////
+// the settings of a synthetic corpus
+typedef struct tagCorpusSettings
+{
+	// the folder the corpus is created in
+	string m_csRoot;
+
+	// the number of image files
+	size_t m_tFiles;
+
+	// the number of folder levels below the root
+	int m_nDepth;
+
+	// the number of sub-folders in each folder
+	int m_nWidth;
+
+	// the smallest and largest file sizes in bytes (sizes are spread
+	// evenly on a log scale between the two)
+	size_t m_tMinSize;
+	size_t m_tMaxSize;
+
+	// the seed of the random numbers, the same seed and settings always
+	// produce the same corpus
+	uint64_t m_ullSeed;
+
+} CORPUS_SETTINGS;
+
+/////////////////////////////////////////////////////////////////////////////
+// this class writes a reproducible tree of JPEG, TIFF and PNG files with
+// and without EXIF dates, including the malformed dates the tool has to
+// reject, so the stages of the tool can be measured without a photo
+// library. The image data is random filler: the files are only meant to
+// be read and patched by the metadata code, not decoded.
+class CCorpusGenerator
+{
+	// public definitions
+public:
+	// the kinds of image written
+	typedef enum
+	{
+		ikJPEG = 0,
+		ikTIFF = 1,
+		ikPNG = 2,
+	} IMAGE_KIND;
+
+	// the kinds of date written
+	typedef enum
+	{
+		dkValid = 0,			// original and digitized dates
+		dkOriginalOnly = 1,		// only the original date
+		dkMissing = 2,			// no EXIF data at all
+		dkMalformed = 3,		// dates that do not parse
+	} DATE_KIND;
+
+	// protected definitions
+protected:
+	// TIFF tags and field types written
+	enum
+	{
+		ttImageWidth = 0x0100,
+		ttImageLength = 0x0101,
+		ttStripOffsets = 0x0111,
+		ttStripByteCounts = 0x0117,
+		ttDateTime = 0x0132,
+		ttExifIFD = 0x8769,
+		ttDTOrig = 0x9003,
+		ttDTDigitized = 0x9004,
+		ftShort = 3,
+		ftLong = 4,
+		ftASCII = 2,
+	};
+
+	// an entry of an IFD before it is laid out
+	typedef struct tagEntry
+	{
+		unsigned short m_usTag;
+		unsigned short m_usType;
+		unsigned long m_ulValue;
+
+		// the ASCII value stored outside of the entry (if any)
+		string m_csValue;
+
+	} ENTRY;
+
+	// protected data
+protected:
+	// the settings of the corpus
+	CORPUS_SETTINGS m_Settings;
+
+	// the state of the random number generator
+	uint64_t m_ullState;
+
+	// the folders of the tree
+	vector<string> m_Folders;
+
+	// the number of files and bytes written by each kind of image
+	size_t m_tFiles[ 3 ];
+	unsigned long long m_ullBytes[ 3 ];
+
+	// the number of files written with each kind of date
+	size_t m_tDates[ 4 ];
+
+	// protected methods
+protected:
+	// the next random number (splitmix64)
+	inline uint64_t Next()
+	{
+		uint64_t value = ( m_ullState += 0x9E3779B97F4A7C15ull );
+		value = ( value ^ ( value >> 30 ) ) * 0xBF58476D1CE4E5B9ull;
+		value = ( value ^ ( value >> 27 ) ) * 0x94D049BB133111EBull;
+		return value ^ ( value >> 31 );
+	}
+
+	// a random number from 0 to nLimit - 1
+	inline int Next( int nLimit )
+	{
+		return (int)( Next() % (uint64_t)nLimit );
+	}
+
+	// fill the buffer with random bytes
+	void Fill( unsigned char* pBuffer, size_t tLength )
+	{
+		while ( tLength >= 8 )
+		{
+			const uint64_t ullValue = Next();
+			memcpy( pBuffer, &ullValue, 8 );
+			pBuffer += 8;
+			tLength -= 8;
+		}
+		while ( tLength-- > 0 )
+		{
+			*pBuffer++ = (unsigned char)Next();
+		}
+	}
+
+	// append a 16 or 32 bit value in the given byte order
+	static void PutShort( vector<unsigned char>& data, unsigned value, bool bIntel )
+	{
+		if ( bIntel )
+		{
+			data.push_back( (unsigned char)value );
+			data.push_back( (unsigned char)( value >> 8 ) );
+
+		} else
+		{
+			data.push_back( (unsigned char)( value >> 8 ) );
+			data.push_back( (unsigned char)value );
+		}
+	}
+	static void PutLong( vector<unsigned char>& data, unsigned long value, bool bIntel )
+	{
+		if ( bIntel )
+		{
+			PutShort( data, value & 0xFFFF, true );
+			PutShort( data, value >> 16, true );
+
+		} else
+		{
+			PutShort( data, value >> 16, false );
+			PutShort( data, value & 0xFFFF, false );
+		}
+	}
+
+	// overwrite a 32 bit value in the given byte order
+	static void SetLong
+	(
+		vector<unsigned char>& data, size_t tPos, unsigned long value, bool bIntel
+	)
+	{
+		vector<unsigned char> bytes;
+		PutLong( bytes, value, bIntel );
+		memcpy( data.data() + tPos, bytes.data(), 4 );
+	}
+
+	// append an IFD at the end of the data (offsets are relative to the
+	// start of the data) with its ASCII values following it, returning
+	// the position of the first entry so pointers can be patched
+	static size_t PutIFD
+	(
+		vector<unsigned char>& data, const vector<ENTRY>& entries, bool bIntel
+	)
+	{
+		const size_t tIFD = data.size();
+		size_t tValues = tIFD + 2 + entries.size() * 12 + 4;
+
+		PutShort( data, (unsigned)entries.size(), bIntel );
+		for ( const ENTRY& entry : entries )
+		{
+			PutShort( data, entry.m_usTag, bIntel );
+			PutShort( data, entry.m_usType, bIntel );
+			if ( entry.m_usType == ftASCII )
+			{
+				PutLong( data, (unsigned long)entry.m_csValue.size() + 1, bIntel );
+				PutLong( data, (unsigned long)tValues, bIntel );
+				tValues += entry.m_csValue.size() + 1;
+
+			} else if ( entry.m_usType == ftShort )
+			{
+				PutLong( data, 1, bIntel );
+				PutShort( data, entry.m_ulValue, bIntel );
+				PutShort( data, 0, bIntel );
+
+			} else
+			{
+				PutLong( data, 1, bIntel );
+				PutLong( data, entry.m_ulValue, bIntel );
+			}
+		}
+
+		// no next IFD
+		PutLong( data, 0, bIntel );
+
+		for ( const ENTRY& entry : entries )
+		{
+			if ( entry.m_usType == ftASCII )
+			{
+				data.insert( data.end(), entry.m_csValue.begin(), entry.m_csValue.end() );
+				data.push_back( 0 );
+			}
+		}
+
+		return tIFD + 2;
+	}
+
+	// a random date in the canonical layout
+	string GetValidDate()
+	{
+		char szDate[ 32 ];
+		snprintf
+		(
+			szDate, sizeof( szDate ), "%04d:%02d:%02d %02d:%02d:%02d",
+			1990 + Next( 35 ), 1 + Next( 12 ), 1 + Next( 28 ),
+			Next( 24 ), Next( 60 ), Next( 60 )
+		);
+		return szDate;
+	}
+
+	// a date the tool has to reject
+	string GetMalformedDate()
+	{
+		static const char* dates[] =
+		{
+			"2020:13:01 10:00:00",		// no such month
+			"2019:02:29 12:00:00",		// not a leap year
+			"2020:01:01 25:00:00",		// no such hour
+			"0000:00:00 00:00:00",		// the "unknown" placeholder
+			"    :  :     :  :  ",		// blank placeholder
+			"2020-01-01 10:00:00",		// wrong separators
+			"garbage",
+		};
+		return dates[ Next( (int)( sizeof( dates ) / sizeof( dates[ 0 ] ) ) ) ];
+	}
+
+	// a TIFF structure with the dates of the given kind and a strip of
+	// tStrip bytes of image data at its end. Offsets are relative to the
+	// start of the structure which is how EXIF stores them.
+	vector<unsigned char> GetTiff( DATE_KIND eDate, bool bIntel, size_t tStrip )
+	{
+		string csOriginal;
+		string csDigitized;
+		if ( eDate == dkMalformed )
+		{
+			csOriginal = GetMalformedDate();
+			csDigitized = csOriginal;
+
+		} else
+		{
+			csOriginal = GetValidDate();
+			csDigitized = eDate == dkValid ? csOriginal : string();
+		}
+
+		vector<unsigned char> data;
+		data.push_back( bIntel ? 'I' : 'M' );
+		data.push_back( bIntel ? 'I' : 'M' );
+		PutShort( data, 42, bIntel );
+		PutLong( data, 8, bIntel );
+
+		// IFD0 (the tags are in ascending order as TIFF requires)
+		vector<ENTRY> entries;
+		entries.push_back( { ttImageWidth, ftShort, 64, "" } );
+		entries.push_back( { ttImageLength, ftShort, 64, "" } );
+		entries.push_back( { ttStripOffsets, ftLong, 0, "" } );
+		entries.push_back( { ttStripByteCounts, ftLong, (unsigned long)tStrip, "" } );
+		if ( eDate != dkMissing )
+		{
+			entries.push_back( { ttDateTime, ftASCII, 0, csOriginal } );
+			entries.push_back( { ttExifIFD, ftLong, 0, "" } );
+		}
+		const size_t tEntries = PutIFD( data, entries, bIntel );
+
+		// the EXIF sub-IFD
+		if ( eDate != dkMissing )
+		{
+			SetLong( data, tEntries + 5 * 12 + 8, (unsigned long)data.size(), bIntel );
+			entries.clear();
+			entries.push_back( { ttDTOrig, ftASCII, 0, csOriginal } );
+			if ( !csDigitized.empty() )
+			{
+				entries.push_back( { ttDTDigitized, ftASCII, 0, csDigitized } );
+			}
+			PutIFD( data, entries, bIntel );
+		}
+
+		// the image strip
+		SetLong( data, tEntries + 2 * 12 + 8, (unsigned long)data.size(), bIntel );
+		const size_t tData = data.size();
+		data.resize( tData + tStrip );
+		Fill( data.data() + tData, tStrip );
+		return data;
+	}
+
+	// a JPEG file of about the given size
+	vector<unsigned char> GetJpeg( DATE_KIND eDate, size_t tSize )
+	{
+		vector<unsigned char> data = { 0xFF, 0xD8 };
+
+		// APP0 JFIF
+		static const unsigned char jfif[] =
+		{
+			0xFF, 0xE0, 0x00, 0x10, 'J', 'F', 'I', 'F', 0x00, 0x01, 0x01,
+			0x00, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00
+		};
+		data.insert( data.end(), jfif, jfif + sizeof( jfif ) );
+
+		// APP1 EXIF with a 4K thumbnail sized gap like a camera writes
+		if ( eDate != dkMissing )
+		{
+			const vector<unsigned char> tiff = GetTiff( eDate, Next( 2 ) == 0, 4096 );
+			const size_t tLength = 2 + 6 + tiff.size();
+			data.push_back( 0xFF );
+			data.push_back( 0xE1 );
+			data.push_back( (unsigned char)( tLength >> 8 ) );
+			data.push_back( (unsigned char)tLength );
+			static const unsigned char exif[] = { 'E', 'x', 'i', 'f', 0, 0 };
+			data.insert( data.end(), exif, exif + sizeof( exif ) );
+			data.insert( data.end(), tiff.begin(), tiff.end() );
+		}
+
+		// the start of scan followed by the entropy coded data, which
+		// cannot contain a marker so 0xFF bytes are cleared
+		static const unsigned char sos[] =
+		{
+			0xFF, 0xDA, 0x00, 0x08, 0x01, 0x01, 0x00, 0x00, 0x3F, 0x00
+		};
+		data.insert( data.end(), sos, sos + sizeof( sos ) );
+
+		const size_t tScan = data.size();
+		const size_t tData = tSize > tScan + 2 ? tSize - tScan - 2 : 0;
+		data.resize( tScan + tData );
+		Fill( data.data() + tScan, tData );
+		for ( size_t tPos = tScan; tPos < data.size(); tPos++ )
+		{
+			if ( data[ tPos ] == 0xFF )
+			{
+				data[ tPos ] = 0x00;
+			}
+		}
+
+		data.push_back( 0xFF );
+		data.push_back( 0xD9 );
+		return data;
+	}
+
+	// the CRC of a PNG chunk
+	static unsigned long GetCrc( const unsigned char* pData, size_t tLength )
+	{
+		static unsigned long table[ 256 ] = { 0 };
+		if ( table[ 1 ] == 0 )
+		{
+			for ( unsigned long ulByte = 0; ulByte < 256; ulByte++ )
+			{
+				unsigned long ulValue = ulByte;
+				for ( int nBit = 0; nBit < 8; nBit++ )
+				{
+					ulValue = ulValue & 1 ? 0xEDB88320ul ^ ( ulValue >> 1 ) : ulValue >> 1;
+				}
+				table[ ulByte ] = ulValue;
+			}
+		}
+
+		unsigned long value = 0xFFFFFFFFul;
+		for ( size_t tByte = 0; tByte < tLength; tByte++ )
+		{
+			value = table[ ( value ^ pData[ tByte ] ) & 0xFF ] ^ ( value >> 8 );
+		}
+		return value ^ 0xFFFFFFFFul;
+	}
+
+	// append a PNG chunk with its length and CRC
+	static void PutChunk
+	(
+		vector<unsigned char>& data, const char* pcszType,
+		const unsigned char* pChunk, size_t tLength
+	)
+	{
+		PutLong( data, (unsigned long)tLength, false );
+		const size_t tType = data.size();
+		data.insert( data.end(), pcszType, pcszType + 4 );
+		data.insert( data.end(), pChunk, pChunk + tLength );
+		PutLong( data, GetCrc( data.data() + tType, tLength + 4 ), false );
+	}
+
+	// a PNG file of about the given size
+	vector<unsigned char> GetPng( DATE_KIND eDate, size_t tSize )
+	{
+		vector<unsigned char> data =
+		{
+			0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A
+		};
+
+		// 64 x 64 RGB
+		vector<unsigned char> header;
+		PutLong( header, 64, false );
+		PutLong( header, 64, false );
+		header.insert( header.end(), { 8, 2, 0, 0, 0 } );
+		PutChunk( data, "IHDR", header.data(), header.size() );
+
+		// the EXIF data is a TIFF structure without the JPEG identifier
+		if ( eDate != dkMissing )
+		{
+			const vector<unsigned char> tiff = GetTiff( eDate, Next( 2 ) == 0, 0 );
+			PutChunk( data, "eXIf", tiff.data(), tiff.size() );
+		}
+
+		// image data in 64K chunks like most encoders write
+		size_t tData = tSize > data.size() + 12 ? tSize - data.size() - 12 : 0;
+		vector<unsigned char> chunk;
+		while ( tData > 0 )
+		{
+			const size_t tChunk = tData > 65536 + 12 ? 65536 : tData;
+			chunk.resize( tChunk );
+			Fill( chunk.data(), tChunk );
+			PutChunk( data, "IDAT", chunk.data(), tChunk );
+			tData -= tChunk + 12 > tData ? tData : tChunk + 12;
+		}
+
+		PutChunk( data, "IEND", nullptr, 0 );
+		return data;
+	}
+
+	// a file size spread evenly on a log scale between the limits
+	size_t GetSize()
+	{
+		const double dMin = (double)m_Settings.m_tMinSize;
+		const double dMax = (double)m_Settings.m_tMaxSize;
+		const double dFraction = (double)( Next() >> 11 ) / 9007199254740992.0;
+		return (size_t)( dMin * pow( dMax / dMin, dFraction ) );
+	}
+
+	// add the folders below the given folder to the given depth
+	void AddFolders( const string& csFolder, int nDepth )
+	{
+		m_Folders.push_back( csFolder );
+		if ( nDepth == 0 || m_Folders.size() >= m_Settings.m_tFiles )
+		{
+			return;
+		}
+
+		for ( int nFolder = 0; nFolder < m_Settings.m_nWidth; nFolder++ )
+		{
+			char szName[ 32 ];
+			snprintf( szName, sizeof( szName ), "/d%02d", nFolder );
+			AddFolders( csFolder + szName, nDepth - 1 );
+		}
+	}
+
+	// public properties
+public:
+	// the number of folders in the tree
+	inline size_t GetFolders() const
+	{
+		return m_Folders.size();
+	}
+
+	// the number of files written of the given kind
+	inline size_t GetFiles( IMAGE_KIND eKind ) const
+	{
+		return m_tFiles[ eKind ];
+	}
+
+	// the number of bytes written of the given kind
+	inline unsigned long long GetBytes( IMAGE_KIND eKind ) const
+	{
+		return m_ullBytes[ eKind ];
+	}
+
+	// the number of files written with the given kind of date
+	inline size_t GetDates( DATE_KIND eKind ) const
+	{
+		return m_tDates[ eKind ];
+	}
+
+	// public methods
+public:
+	// write the corpus, returning false if a folder or file cannot be
+	// created
+	bool Generate( const CORPUS_SETTINGS& settings )
+	{
+		m_Settings = settings;
+		if ( m_Settings.m_tMinSize < 1024 )
+		{
+			m_Settings.m_tMinSize = 1024;
+		}
+		if ( m_Settings.m_tMaxSize < m_Settings.m_tMinSize )
+		{
+			m_Settings.m_tMaxSize = m_Settings.m_tMinSize;
+		}
+
+		m_ullState = m_Settings.m_ullSeed;
+		m_Folders.clear();
+		memset( m_tFiles, 0, sizeof( m_tFiles ) );
+		memset( m_ullBytes, 0, sizeof( m_ullBytes ) );
+		memset( m_tDates, 0, sizeof( m_tDates ) );
+
+		AddFolders( m_Settings.m_csRoot, m_Settings.m_nDepth );
+		error_code error;
+		for ( const string& csFolder : m_Folders )
+		{
+			filesystem::create_directories( csFolder, error );
+			if ( error )
+			{
+				return false;
+			}
+		}
+
+		for ( size_t tFile = 0; tFile < m_Settings.m_tFiles; tFile++ )
+		{
+			// mostly JPEG files with valid dates like a camera roll
+			const int nKind = Next( 100 );
+			const IMAGE_KIND eKind =
+				nKind < 70 ? ikJPEG : nKind < 85 ? ikTIFF : ikPNG;
+			const int nDate = Next( 100 );
+			const DATE_KIND eDate =
+				nDate < 80 ? dkValid : nDate < 84 ? dkOriginalOnly :
+				nDate < 92 ? dkMissing : dkMalformed;
+
+			const size_t tSize = GetSize();
+			vector<unsigned char> data;
+			const char* pcszExt = nullptr;
+			switch ( eKind )
+			{
+				case ikJPEG:
+					data = GetJpeg( eDate, tSize );
+					pcszExt = Next( 4 ) == 0 ? ".JPG" : ".jpg";
+					break;
+
+				case ikTIFF:
+					data = GetTiff
+					(
+						eDate, Next( 2 ) == 0, tSize > 512 ? tSize - 512 : 0
+					);
+					pcszExt = ".tif";
+					break;
+
+				default:
+					data = GetPng( eDate, tSize );
+					pcszExt = ".png";
+					break;
+			}
+
+			char szName[ 32 ];
+			snprintf( szName, sizeof( szName ), "/img%07zu", tFile );
+			const string csPath =
+				m_Folders[ tFile % m_Folders.size() ] + szName + pcszExt;
+
+			FILE* pFile = fopen( csPath.c_str(), "wb" );
+			if ( pFile == nullptr )
+			{
+				return false;
+			}
+			const bool bWritten =
+				fwrite( data.data(), 1, data.size(), pFile ) == data.size();
+			if ( fclose( pFile ) != 0 || !bWritten )
+			{
+				return false;
+			}
+
+			m_tFiles[ eKind ]++;
+			m_ullBytes[ eKind ] += data.size();
+			m_tDates[ eDate ]++;
+		}
+
+		return true;
+	}
+
+	// public construction
+public:
+	CCorpusGenerator()
+	{
+		m_ullState = 0;
+		memset( m_tFiles, 0, sizeof( m_tFiles ) );
+		memset( m_ullBytes, 0, sizeof( m_ullBytes ) );
+		memset( m_tDates, 0, sizeof( m_tDates ) );
+	}
+};
+
+/////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,351 @@
+/////////////////////////////////////////////////////////////////////////////
+// Copyright  by W. T. Block, all rights reserved
+/////////////////////////////////////////////////////////////////////////////
+// a command line front end of the portable engine which shifts the date
+// taken of the JPEG, PNG and TIFF based images of a folder tree or of a
+// list of files without MFC or GDI+, so it can run on the servers next 
+// to the storage. Files that can only be corrected by re-encoding them
+// (GIF, BMP and images missing one of the two dates) are reported as 
+// unsupported and left to the Windows front end.
+#include "DateShifter.h"
+#include "DirectoryWalker.h"
+#include "FileList.h"
+#include "LogSink.h"
+#include "PathView.h"
+#include "Pipeline.h"
+#include "PlanManifest.h"
+#include "RunConfig.h"
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/////////////////////////////////////////////////////////////////////////////
+// buffers the output of every thread and writes it in large blocks
+static CLogSink m_Log;
+
+/////////////////////////////////////////////////////////////////////////////
+// the manifest of a dry run (only opened with the --plan option)
+static CLogSink m_Plan( nullptr );
+
+/////////////////////////////////////////////////////////////////////////////
+// show the command line
+static void Usage()
+{
+	printf
+	(
+		".\n"
+		"Usage:\n"
+		".\n"
+		".  OffsetHoursCli [options] pathname hour_offset [recurse_folders]\n"
+		".  OffsetHoursCli [options] --files-from list_file hour_offset\n"
+		".\n"
+		"Where:\n"
+		".\n"
+		".  pathname is a folder, an image file or a folder followed by\n"
+		".    a wild card pattern like \"/photos/IMG_*.JPG\".\n"
+		".  hour_offset is the number of hours to offset the date taken\n"
+		".    by, where fractional values are okay.\n"
+		".  recurse_folders is optional true | false parameter\n"
+		".    to include sub-folders or not (default is false).\n"
+		".  options:\n"
+		".    --walk-threads n    folder enumeration threads\n"
+		".    --write-threads n   read, shift and patch threads\n"
+		".    --queue-depth n     files waiting to be shifted\n"
+		".    --queue-stats       report the queue backpressure\n"
+		".    --verbosity level   quiet, summary or file (default)\n"
+		".    --plan plan_file    write the planned changes to the\n"
+		".                        file (- for the console) and do\n"
+		".                        not write any images\n"
+		".    --files-from file   process the files listed one per\n"
+		".                        line or separated by NULs (- for\n"
+		".                        the standard input) instead of a tree\n"
+		".    --in-place          correct the files themselves instead\n"
+		".                        of writing copies to Corrected folders\n"
+		".\n"
+	);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// true if the arguments hold an option of the Windows front end that the
+// single stage of this tool has no use for, such as the threads of the
+// stages it does not have
+static bool GetStageOption( const vector<string>& arrArgs )
+{
+	static const char* const options[] =
+	{
+		"--read-threads", "--offset-threads", "--checkpoint-seconds",
+		"--journal-hash",
+	};
+
+	for ( string csArg : arrArgs )
+	{
+		for ( char& cArg : csArg )
+		{
+			cArg = (char)tolower( (unsigned char)cArg );
+		}
+		for ( const char* pcszOption : options )
+		{
+			if ( csArg == pcszOption )
+			{
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// true if the pathname is a folder
+static bool GetFolder( const string& csPath )
+{
+	struct stat info;
+	return stat( csPath.c_str(), &info ) == 0 && S_ISDIR( info.st_mode );
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// walk the tree of the run and shift the files found on a stage of 
+// worker threads fed by a bounded queue, returning the exit code
+static int Run( const CRunConfig& config )
+{
+	// a folder is walked whole, otherwise the last part of the pathname
+	// is the pattern of the files in its folder
+	const string& csFilesFrom = config.GetFilesFrom();
+	const string& csPathname = config.GetPathname();
+	string csFolder = csPathname;
+	string csPattern;
+	if ( csFilesFrom.empty() && !GetFolder( csPathname ) )
+	{
+		const CPathView path( csPathname );
+		csFolder = path.GetFolder();
+		csPattern = path.GetDataName();
+		if ( csFolder.empty() )
+		{
+			csFolder = ".";
+		}
+	}
+	if ( csFilesFrom.empty() && !GetFolder( csFolder ) )
+	{
+		printf( ".\nInvalid pathname: %s\n.\n", csPathname.c_str() );
+		return 4;
+	}
+
+	// open the manifest of a dry run
+	const string& csPlan = config.GetPlan();
+	FILE* pPlan = nullptr;
+	if ( csPlan == "-" )
+	{
+		// keep the manifest on the console free of other output
+		pPlan = stdout;
+		m_Log.SetVerbosity( CLogSink::lvQuiet );
+
+	} else if ( !csPlan.empty() )
+	{
+		pPlan = fopen( csPlan.c_str(), "wb" );
+		if ( pPlan == nullptr )
+		{
+			printf( ".\nUnable to create the plan: %s\n.\n", csPlan.c_str() );
+			return 6;
+		}
+	}
+	if ( pPlan != nullptr )
+	{
+		m_Plan.SetStream( pPlan );
+		m_Plan.Write( CLogSink::lvFile, CPlanManifest::GetHeader() );
+	}
+
+	CDateShifter shifter( config.GetOffset(), config.GetInPlace(), pPlan != nullptr );
+
+	// the totals of the run
+	atomic<unsigned long long> ullShifted( 0 );
+	atomic<unsigned long long> ullSkipped( 0 );
+
+	// read, shift and write the files
+	CBoundedQueue<string> queue( (size_t)config.GetQueueDepth() );
+	CPipelineStage stage;
+	stage.Start
+	(
+		config.GetWriteThreads(),
+		[ & ]()
+		{
+			PLAN_ENTRY entry;
+			string csLine;
+			string csPath;
+			while ( queue.Pop( csPath ) )
+			{
+				if ( shifter.Shift( CPathView( csPath ), entry ) )
+				{
+					ullShifted++;
+
+				} else
+				{
+					ullSkipped++;
+				}
+
+				// the manifest lists every file of a dry run and the 
+				// log every file of a run
+				CPlanManifest::Format( entry, csLine );
+				if ( pPlan != nullptr )
+				{
+					m_Plan.Write( CLogSink::lvFile, csLine.data(), csLine.size() );
+
+				} else
+				{
+					m_Log.Write( CLogSink::lvFile, csLine.data(), csLine.size() );
+				}
+			}
+		},
+		[]() {}
+	);
+
+	// hand an image file to the stage
+	auto queueFile = [ & ]( const CPathView& path )
+	{
+		if ( CFileClassifier::GetPathKind( path ) != CFileClassifier::fkNone )
+		{
+			queue.Push( string( path.GetPath() ) );
+		}
+	};
+
+	CDirectoryWalker walker;
+	int nExit = 0;
+	if ( !csFilesFrom.empty() )
+	{
+		// the files come from a list which is processed as it is read
+		if ( !CFileList::Read( csFilesFrom.c_str(), queueFile ) )
+		{
+			m_Log.Format
+			(
+				CLogSink::lvSummary, ".\nUnable to read the file list: %s\n.\n",
+				csFilesFrom.c_str()
+			);
+			nExit = 4;
+		}
+
+	} else // the walker will not enter the corrected folders
+	{
+		walker.SetThreads( config.GetWalkThreads() );
+		walker.SetExclude( CDateShifter::GetCorrectedFolder() );
+		walker.Walk
+		(
+			csFolder,
+			csPattern,
+			config.GetRecurse(),
+			[ & ]( const CPathView& path, int )
+			{
+				queueFile( path );
+			}
+		);
+	}
+	queue.Close();
+	stage.Join();
+
+	m_Log.Format
+	(
+		CLogSink::lvSummary,
+		".\n%llu folders, %llu files, %llu %s, %llu skipped\n.\n",
+		walker.GetDirectories(),
+		queue.GetPushes(),
+		ullShifted.load(),
+		pPlan != nullptr ? CPlanManifest::PLANNED : CRunJournal::CORRECTED,
+		ullSkipped.load()
+	);
+
+	// the backpressure of the queue feeding the stage
+	if ( config.GetQueueStats() )
+	{
+		m_Log.Format
+		(
+			CLogSink::lvSummary,
+			"Shift queue: %llu files, %llu full waits, "
+			"%llu empty waits, high water %zu of %zu\n.\n",
+			queue.GetPushes(),
+			queue.GetFullWaits(),
+			queue.GetEmptyWaits(),
+			queue.GetHighWater(),
+			queue.GetCapacity()
+		);
+	}
+	m_Log.Flush();
+
+	// finish the manifest
+	if ( pPlan != nullptr )
+	{
+		m_Plan.Flush();
+		m_Plan.SetStream( nullptr );
+		if ( pPlan != stdout )
+		{
+			fclose( pPlan );
+		}
+	}
+
+	return nExit;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+int main( int argc, char* argv[] )
+{
+	vector<string> arrArgs( argv, argv + argc );
+
+	// the settings of the run which are only read once processing starts
+	CRunConfig config;
+	string csError;
+	const bool bStageOption = GetStageOption( arrArgs );
+	if ( !config.ParseOptions( arrArgs, csError ) )
+	{
+		printf( ".\n%s\n", csError.c_str() );
+		Usage();
+		return 1;
+	}
+
+	// the journal, checkpoints, metrics, plans being applied and the
+	// threads of the separate stages belong to the Windows front end
+	if
+	(
+		bStageOption ||
+		!config.GetApply().empty() || !config.GetJournal().empty() ||
+		!config.GetCheckpoint().empty() || !config.GetTrace().empty() ||
+		config.GetMetrics()
+	)
+	{
+		printf( ".\nOnly the options listed below are supported\n" );
+		Usage();
+		return 1;
+	}
+
+	// a list of files only needs the hour offset
+	const bool bFilesFrom = !config.GetFilesFrom().empty();
+	const size_t nArgs = arrArgs.size();
+	if ( bFilesFrom ? nArgs != 2 : nArgs != 3 && nArgs != 4 )
+	{
+		Usage();
+		return 1;
+	}
+
+	const string& csOffset = arrArgs[ bFilesFrom ? 1 : 2 ];
+	const double dHourOffset = atof( csOffset.c_str() );
+	if ( !CRunConfig::GetValidHourOffset( dHourOffset ) )
+	{
+		printf( ".\nInvalid hour offset: %s\n.\n", csOffset.c_str() );
+		return 5;
+	}
+
+	// default to no recursion through sub-folders
+	string csRecurse = nArgs == 4 ? arrArgs[ 3 ] : string();
+	for ( char& cValue : csRecurse )
+	{
+		cValue = (char)tolower( (unsigned char)cValue );
+	}
+
+	config.SetPathname( bFilesFrom ? string() : arrArgs[ 1 ] );
+	config.SetHourOffset( dHourOffset );
+	config.SetRecurse( csRecurse == "true" );
+	m_Log.SetVerbosity( config.GetVerbosity() );
+
+	return Run( config );
+}
+
+/////////////////////////////////////////////////////////////////////////////
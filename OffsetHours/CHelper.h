@@ -3,6 +3,7 @@
 /////////////////////////////////////////////////////////////////////////////
 #pragma once
 #include "stdafx.h"
+#include "PathView.h"
 #include <vector>
 
 using namespace std;
@@ -98,86 +99,53 @@ public:
 		return value;
 	}
 
+	/////////////////////////////////////////////////////////////////////////////
+	// a part of a pathname as a string
+	static inline CString GetString( string_view value )
+	{
+		return CString( value.data(), (int)value.length() );
+	}
+
 	/////////////////////////////////////////////////////////////////////////////
 	// parse the filename from a pathname
 	static inline CString GetFileName( LPCTSTR pcszPath )
 	{
-		CString csPath( pcszPath );
-		TCHAR* pBuf = csPath.GetBuffer( csPath.GetLength() + 1 );
-		TCHAR szDrive[ _MAX_DRIVE ];
-		TCHAR szDir[ _MAX_DIR ];
-		TCHAR szFile[ _MAX_FNAME ];
-		TCHAR szExt[ _MAX_EXT ];
-
-		_tsplitpath( pBuf, szDrive, szDir, szFile, szExt );
-		csPath.ReleaseBuffer();
-		return szFile;
+		return GetString( CPathView( pcszPath ).GetFileName() );
 	}
 
 	/////////////////////////////////////////////////////////////////////////////
 	// parse the extension from a pathname
 	static inline CString GetExtension( LPCTSTR pcszPath )
 	{
-		CString csPath( pcszPath );
-		TCHAR* pBuf = csPath.GetBuffer( csPath.GetLength() + 1 );
-		TCHAR szDrive[ _MAX_DRIVE ];
-		TCHAR szDir[ _MAX_DIR ];
-		TCHAR szFile[ _MAX_FNAME ];
-		TCHAR szExt[ _MAX_EXT ];
-
-		_tsplitpath( pBuf, szDrive, szDir, szFile, szExt );
-		csPath.ReleaseBuffer();
-		return szExt;
+		return GetString( CPathView( pcszPath ).GetExtension() );
 	}
 
 	/////////////////////////////////////////////////////////////////////////////
 	// parse the directory from a pathname
 	static inline CString GetDirectory( LPCTSTR pcszPath )
 	{
-		CString csPath( pcszPath );
-		TCHAR* pBuf = csPath.GetBuffer( csPath.GetLength() + 1 );
-		TCHAR szDrive[ _MAX_DRIVE ];
-		TCHAR szDir[ _MAX_DIR ];
-		TCHAR szFile[ _MAX_FNAME ];
-		TCHAR szExt[ _MAX_EXT ];
-
-		_tsplitpath( pBuf, szDrive, szDir, szFile, szExt );
-		csPath.ReleaseBuffer();
-		return szDir;
+		return GetString( CPathView( pcszPath ).GetDirectory() );
 	}
 
 	/////////////////////////////////////////////////////////////////////////////
 	// parse the drive from a pathname
 	static inline CString GetDrive( LPCTSTR pcszPath )
 	{
-		CString csPath( pcszPath );
-		TCHAR* pBuf = csPath.GetBuffer( csPath.GetLength() + 1 );
-		TCHAR szDrive[ _MAX_DRIVE ];
-		TCHAR szDir[ _MAX_DIR ];
-		TCHAR szFile[ _MAX_FNAME ];
-		TCHAR szExt[ _MAX_EXT ];
-
-		_tsplitpath( pBuf, szDrive, szDir, szFile, szExt );
-		csPath.ReleaseBuffer();
-		return szDrive;
+		return GetString( CPathView( pcszPath ).GetDrive() );
 	}
 
 	/////////////////////////////////////////////////////////////////////////////
 	// parse folder from a pathname (drive and directory)
 	static inline CString GetFolder( LPCTSTR pcszPath )
 	{
-		CString csDrive = GetDrive( pcszPath );
-		CString csDir = GetDirectory( pcszPath );
-		return csDrive + csDir;
+		return GetString( CPathView( pcszPath ).GetFolder() );
 	}
 
 	/////////////////////////////////////////////////////////////////////////////
 	// parse data name from a pathname (filename and extension)
 	static inline CString GetDataName( LPCTSTR pcszPath )
 	{
-		CString csFile = GetFileName( pcszPath );
-		CString csExt = GetExtension( pcszPath );
-		return csFile + csExt;
+		return GetString( CPathView( pcszPath ).GetDataName() );
 	}
 
 	CHelper()
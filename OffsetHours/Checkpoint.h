@@ -0,0 +1,404 @@
+/////////////////////////////////////////////////////////////////////////////
+// Copyright  by W. T. Block, all rights reserved
+/////////////////////////////////////////////////////////////////////////////
+#pragma once
+#include "FileCommit.h"
+#include "PlanManifest.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+using namespace std;
+
+/////////////////////////////////////////////////////////////////////////////
+// this class tracks the progress of a walk so a run that dies can be
+// resumed where it left off. A folder is complete once it has been
+// enumerated, every file found in it has been finished and every one of
+// its sub-folders is complete, so a complete folder stands for its whole
+// sub-tree and a resumed run does not enumerate it again. The checkpoint
+// only holds the frontier of the walk: the complete folders whose parent
+// is not complete, the finished files of folders that are not complete
+// and the files that were in flight. It is written to a temporary file
+// which is flushed to the disk and renamed over the last checkpoint, so
+// a crash at any moment leaves either the old or the new checkpoint.
+// Files in flight are not finished and are processed again on resume;
+// their corrected copies are always written from the unchanged original,
+// so a file is never shifted twice.
+class CCheckpoint
+{
+	// protected definitions
+protected:
+	// a folder that is not complete yet
+	typedef struct tagFolder
+	{
+		// the folder it was found in (empty for the root)
+		string m_csParent;
+
+		// its enumeration, files and sub-folders not yet finished
+		long m_lPending;
+
+		// its finished files
+		vector<string> m_arrDone;
+
+		// its complete sub-folders
+		vector<string> m_arrComplete;
+
+	} FOLDER;
+
+	// protected data
+protected:
+	// the pathname of the checkpoint
+	string m_csPath;
+
+	// the root of the walk and the offset which must match on resume
+	string m_csRoot;
+	int64_t m_llOffset;
+
+	// protects everything below
+	mutex m_Lock;
+
+	// the folders being walked that are not complete
+	unordered_map<string, FOLDER> m_Folders;
+
+	// the complete folders of the frontier
+	unordered_set<string> m_Complete;
+
+	// the finished files of folders that are not complete
+	unordered_set<string> m_Done;
+
+	// the files being processed
+	unordered_set<string> m_InFlight;
+
+	// true once the root is complete
+	bool m_bFinished;
+
+	// the number of files skipped because a resumed checkpoint has
+	// them finished
+	unsigned long long m_ullResumed;
+
+	// protected methods
+protected:
+	// the folder of a file's pathname
+	static inline string GetFolder( const string& csPath )
+	{
+		const size_t tSeparator = csPath.find_last_of( "\\/" );
+		return tSeparator == string::npos ? string() : csPath.substr( 0, tSeparator );
+	}
+
+	// one item of the frontier less for a folder, which completes the
+	// folder when nothing is left (called with the lock held)
+	void Release( const string& csFolder )
+	{
+		string csName = csFolder;
+		while ( true )
+		{
+			auto pos = m_Folders.find( csName );
+			if ( pos == m_Folders.end() || --pos->second.m_lPending > 0 )
+			{
+				return;
+			}
+
+			// the folder stands for its files and sub-folders from now on
+			FOLDER& folder = pos->second;
+			for ( const string& csDone : folder.m_arrDone )
+			{
+				m_Done.erase( csDone );
+			}
+			for ( const string& csComplete : folder.m_arrComplete )
+			{
+				m_Complete.erase( csComplete );
+			}
+			m_Complete.insert( csName );
+
+			const string csParent = folder.m_csParent;
+			m_Folders.erase( pos );
+			if ( csParent.empty() )
+			{
+				m_bFinished = true;
+				return;
+			}
+
+			// the parent has one sub-folder less to wait for
+			auto parent = m_Folders.find( csParent );
+			if ( parent != m_Folders.end() )
+			{
+				parent->second.m_arrComplete.push_back( csName );
+			}
+			csName = csParent;
+		}
+	}
+
+	// append a line of a checkpoint
+	static inline void AddLine( const char* pcszType, const string& csValue, string& csText )
+	{
+		csText += pcszType;
+		csText += '\t';
+		CPlanManifest::Escape( csValue, csText );
+		csText += '\n';
+	}
+
+	// public properties
+public:
+	// true when checkpoints are being kept
+	inline bool GetEnabled() const
+	{
+		return !m_csPath.empty();
+	}
+
+	// true once the root of the walk is complete
+	inline bool GetFinished()
+	{
+		lock_guard<mutex> lock( m_Lock );
+		return m_bFinished;
+	}
+
+	// the number of files skipped because a resumed checkpoint has
+	// them finished
+	inline unsigned long long GetResumed()
+	{
+		lock_guard<mutex> lock( m_Lock );
+		return m_ullResumed;
+	}
+
+	// public methods
+public:
+	// keep checkpoints of the walk of the given root with the given
+	// offset, optionally resuming the checkpoint a run left behind.
+	// Returns false with a message if the checkpoint cannot be read or
+	// belongs to another run; a missing checkpoint starts a new run.
+	bool Open
+	(
+		const char* pcszPath, const string& csRoot, int64_t llOffset,
+		bool bResume, string& csError
+	)
+	{
+		lock_guard<mutex> lock( m_Lock );
+		m_csPath = pcszPath;
+		m_csRoot = csRoot;
+		m_llOffset = llOffset;
+		m_Folders.clear();
+		m_Complete.clear();
+		m_Done.clear();
+		m_InFlight.clear();
+		m_bFinished = false;
+		m_ullResumed = 0;
+
+		if ( !bResume )
+		{
+			return true;
+		}
+
+		FILE* pFile = fopen( pcszPath, "rb" );
+		if ( pFile == nullptr )
+		{
+			return true;
+		}
+
+		// the checkpoint is small (only the frontier) so read it whole
+		string csText;
+		char buffer[ 64 * 1024 ];
+		size_t tRead = 0;
+		while ( ( tRead = fread( buffer, 1, sizeof( buffer ), pFile ) ) > 0 )
+		{
+			csText.append( buffer, tRead );
+		}
+		fclose( pFile );
+
+		string_view text( csText );
+		bool bRoot = false;
+		bool bOffset = false;
+		while ( !text.empty() )
+		{
+			const size_t tBreak = text.find( '\n' );
+			string_view line = text.substr( 0, tBreak );
+			text.remove_prefix( tBreak == string_view::npos ? text.size() : tBreak + 1 );
+
+			const size_t tTab = line.find( '\t' );
+			if ( line.empty() || line[ 0 ] == '#' || tTab == string_view::npos )
+			{
+				continue;
+			}
+
+			const string_view type = line.substr( 0, tTab );
+			const string csValue = CPlanManifest::Unescape( line.substr( tTab + 1 ) );
+			if ( type == "root" )
+			{
+				bRoot = csValue == m_csRoot;
+
+			} else if ( type == "offset" )
+			{
+				bOffset = strtoll( csValue.c_str(), nullptr, 10 ) == m_llOffset;
+
+			} else if ( type == "complete" )
+			{
+				m_Complete.insert( csValue );
+
+			} else if ( type == "done" )
+			{
+				m_Done.insert( csValue );
+			}
+
+			// the files that were in flight are processed again
+		}
+
+		if ( !bRoot || !bOffset )
+		{
+			csError = "The checkpoint belongs to a run with another folder or offset";
+			m_Complete.clear();
+			m_Done.clear();
+			return false;
+		}
+
+		return true;
+	}
+
+	// called by the walker for each folder before it is queued, returning
+	// false if the folder is complete and does not need to be walked
+	bool BeginFolder( const string& csFolder, const string& csParent )
+	{
+		lock_guard<mutex> lock( m_Lock );
+		if ( m_Complete.count( csFolder ) > 0 )
+		{
+			m_bFinished = m_bFinished || csParent.empty();
+			auto parent = m_Folders.find( csParent );
+			if ( parent != m_Folders.end() )
+			{
+				parent->second.m_arrComplete.push_back( csFolder );
+			}
+			return false;
+		}
+
+		FOLDER& folder = m_Folders[ csFolder ];
+		folder.m_csParent = csParent;
+		folder.m_lPending = 1;
+
+		auto parent = m_Folders.find( csParent );
+		if ( parent != m_Folders.end() )
+		{
+			parent->second.m_lPending++;
+		}
+		return true;
+	}
+
+	// called by the walker when a folder has been enumerated
+	void EndFolder( const string& csFolder )
+	{
+		lock_guard<mutex> lock( m_Lock );
+		Release( csFolder );
+	}
+
+	// called for each file found, returning false if a resumed checkpoint
+	// has the file finished
+	bool BeginFile( const string& csPath )
+	{
+		const string csFolder = GetFolder( csPath );
+		lock_guard<mutex> lock( m_Lock );
+		auto folder = m_Folders.find( csFolder );
+		if ( m_Done.count( csPath ) > 0 )
+		{
+			if ( folder != m_Folders.end() )
+			{
+				folder->second.m_arrDone.push_back( csPath );
+			}
+			m_ullResumed++;
+			return false;
+		}
+
+		if ( folder != m_Folders.end() )
+		{
+			folder->second.m_lPending++;
+		}
+		m_InFlight.insert( csPath );
+		return true;
+	}
+
+	// called when a file begun by BeginFile is finished whatever the
+	// outcome
+	void EndFile( const string& csPath )
+	{
+		const string csFolder = GetFolder( csPath );
+		lock_guard<mutex> lock( m_Lock );
+		if ( m_InFlight.erase( csPath ) == 0 )
+		{
+			return;
+		}
+
+		auto folder = m_Folders.find( csFolder );
+		if ( folder != m_Folders.end() )
+		{
+			m_Done.insert( csPath );
+			folder->second.m_arrDone.push_back( csPath );
+			Release( csFolder );
+		}
+	}
+
+	// write the frontier of the walk to a new checkpoint and rename it
+	// over the last one, returning false if it cannot be written
+	bool Save()
+	{
+		string csText = "# OffsetHours checkpoint\n";
+		{
+			lock_guard<mutex> lock( m_Lock );
+			AddLine( "root", m_csRoot, csText );
+			AddLine( "offset", to_string( m_llOffset ), csText );
+			for ( const string& csFolder : m_Complete )
+			{
+				AddLine( "complete", csFolder, csText );
+			}
+			for ( const string& csDone : m_Done )
+			{
+				AddLine( "done", csDone, csText );
+			}
+			for ( const string& csFile : m_InFlight )
+			{
+				AddLine( "in-flight", csFile, csText );
+			}
+		}
+
+		const string csTemp = m_csPath + ".tmp";
+		FILE* pFile = fopen( csTemp.c_str(), "wb" );
+		if ( pFile == nullptr )
+		{
+			return false;
+		}
+
+		const bool bWritten =
+			fwrite( csText.data(), 1, csText.size(), pFile ) == csText.size() &&
+			CFileCommit::Commit( pFile );
+		if
+		(
+			fclose( pFile ) != 0 || !bWritten ||
+			!CFileCommit::Rename( csTemp.c_str(), m_csPath.c_str() )
+		)
+		{
+			remove( csTemp.c_str() );
+			return false;
+		}
+
+		return true;
+	}
+
+	// remove the checkpoint of a run that is finished
+	bool Remove()
+	{
+		return remove( m_csPath.c_str() ) == 0;
+	}
+
+	// public construction
+public:
+	CCheckpoint()
+	{
+		m_llOffset = 0;
+		m_bFinished = false;
+		m_ullResumed = 0;
+	}
+};
+
+/////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,376 @@
+/////////////////////////////////////////////////////////////////////////////
+// Copyright  by W. T. Block, all rights reserved
+/////////////////////////////////////////////////////////////////////////////
+#pragma once
+#include "ExifDate.h"
+#include "ExifPatcher.h"
+#include "ExifReader.h"
+#include "FileClassifier.h"
+#include "FileClone.h"
+#include "FileCommit.h"
+#include "FolderCache.h"
+#include "PathView.h"
+#include "PlanManifest.h"
+#include "PngRewriter.h"
+#include "RunJournal.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+using namespace std;
+
+/////////////////////////////////////////////////////////////////////////////
+// this class is the portable engine of the tool: it reads the date taken
+// from a file's header, shifts it and patches it into a corrected copy or
+// into the file itself without decoding the image or using any Windows
+// library. The Windows front end calls it for every file it can patch
+// natively and only falls back to GDI+ for the rest, and the command line
+// front end built by CMake runs on it alone. The settings are fixed when
+// the shifter is made so one shifter is shared by every worker thread.
+class CDateShifter
+{
+	// public definitions
+public:
+	// the outcome of a file whose dates could only be written by
+	// re-encoding the image
+	static constexpr const char* UNSUPPORTED = "unsupported";
+
+	// the outcome of a file whose new dates could not be written
+	static constexpr const char* FAILED = "failed";
+
+	// protected data
+protected:
+	// the offset in milliseconds added to every date
+	int64_t m_llOffset;
+
+	// correct the files themselves instead of writing corrected copies
+	bool m_bInPlace;
+
+	// only work out the new dates without writing anything
+	bool m_bDryRun;
+
+	// the corrected folders that have been created
+	CFolderCache m_Folders;
+
+	// public properties
+public:
+	// the offset in milliseconds added to every date
+	inline int64_t GetOffset() const
+	{
+		return m_llOffset;
+	}
+
+	// correct the files themselves instead of writing corrected copies
+	inline bool GetInPlace() const
+	{
+		return m_bInPlace;
+	}
+
+	// only work out the new dates without writing anything
+	inline bool GetDryRun() const
+	{
+		return m_bDryRun;
+	}
+
+	// the corrected folders that have been created
+	inline CFolderCache& GetFolders()
+	{
+		return m_Folders;
+	}
+
+	// public methods
+public:
+	// the folder under each image folder that holds the corrected images
+	static inline const char* GetCorrectedFolder()
+	{
+		return "Corrected";
+	}
+
+	// build the pathname of the given image inside of the corrected
+	// folder below the image's folder, creating the folder the first time
+	// it is seen, along with the handle held for the folder or -1 if none
+	// is held, and return false if the folder cannot be created
+	static bool GetCorrectedPath
+	(
+		CFolderCache& folders, const CPathView& path, string& csPath,
+		int& nFolder
+	)
+	{
+		const string_view folder = path.GetFolder();
+		csPath.assign( folder.data(), folder.length() );
+		csPath += GetCorrectedFolder();
+		if ( !folders.Ensure( csPath, nFolder ) )
+		{
+			return false;
+		}
+
+#ifdef _WIN32
+		csPath += '\\';
+#else
+		csPath += '/';
+#endif
+		const string_view data = path.GetDataName();
+		csPath.append( data.data(), data.length() );
+		return true;
+	}
+
+	// build the pathname of the given image inside of the corrected
+	// folder below the image's folder, creating the folder the first time
+	// it is seen, and return false if the folder cannot be created
+	static bool GetCorrectedPath
+	(
+		CFolderCache& folders, const CPathView& path, string& csPath
+	)
+	{
+		int nFolder = -1;
+		return GetCorrectedPath( folders, path, csPath, nFolder );
+	}
+
+	// build the pathname the new version of the given image is written
+	// to, which is a temporary file beside the image when it is corrected
+	// in place or the image's pathname inside of the corrected folder,
+	// along with the handle held for the corrected folder or -1
+	static bool GetOutputPath
+	(
+		CFolderCache& folders, const char* pcszPath, bool bInPlace,
+		string& csPath, int& nFolder
+	)
+	{
+		nFolder = -1;
+		if ( bInPlace )
+		{
+			csPath = CFileCommit::GetTempPath( pcszPath );
+			return true;
+		}
+
+		return GetCorrectedPath( folders, CPathView( pcszPath ), csPath, nFolder );
+	}
+
+	// build the pathname the new version of the given image is written
+	// to, which is a temporary file beside the image when it is corrected
+	// in place or the image's pathname inside of the corrected folder
+	static bool GetOutputPath
+	(
+		CFolderCache& folders, const char* pcszPath, bool bInPlace,
+		string& csPath
+	)
+	{
+		int nFolder = -1;
+		return GetOutputPath( folders, pcszPath, bInPlace, csPath, nFolder );
+	}
+
+	// the date taken found by the reader, which is the original date or
+	// else the digitized date, or null if neither is a valid date in the
+	// "YYYY:MM:DD HH:MM:SS" format. The outcome is INVALID when a date is
+	// there but not valid and MISSING when there is none.
+	static const char* GetDateTaken
+	(
+		const CExifReader& reader, const char*& pcszStatus
+	)
+	{
+		pcszStatus = CPlanManifest::MISSING;
+		const unsigned short tags[] =
+		{
+			CExifReader::ttDTOrig, CExifReader::ttDTDigitized
+		};
+		for ( const unsigned short usTag : tags )
+		{
+			const char* pcszDate = reader.GetValue( usTag );
+			if ( *pcszDate == 0 )
+			{
+				continue;
+			}
+
+			DATE_FIELDS fields;
+			if
+			(
+				CExifDate::Parse( pcszDate, strlen( pcszDate ), fields ) &&
+				CExifDate::IsValid( fields )
+			)
+			{
+				return pcszDate;
+			}
+			pcszStatus = CPlanManifest::INVALID;
+		}
+		return nullptr;
+	}
+
+	// true if the dates of the file that was read can be written without
+	// re-encoding it: both dates are there to be overwritten or it is a
+	// PNG file whose eXIf chunk can be rewritten to hold them
+	static inline bool GetNative( const CExifReader& reader )
+	{
+		return reader.GetComplete() || reader.GetChunk() >= 0;
+	}
+
+	// Save a copy of a JPEG, PNG or TIFF based file to the corrected 
+	// folder with its original and digitized date values overwritten in 
+	// place by the new date ("YYYY:MM:DD HH:MM:SS") at the locations found
+	// by the reader, so the image data is never decoded or re-encoded. The
+	// copy is a clone of the file where the file system can share its 
+	// blocks, so only the patched blocks are written, and it is opened
+	// relative to the handle held for the corrected folder when there is
+	// one. A PNG file whose eXIf chunk lacks one of the date values is
+	// copied with an eXIf chunk that has both. When correcting in place,
+	// the dates are written to the file itself by a single write if they
+	// are close together, or else the copy is written beside the file and
+	// renamed over it.
+	// Returns false if the file cannot be written natively (see GetNative)
+	// or the write fails.
+	static bool Save
+	(
+		CFolderCache& folders, const char* pcszPath,
+		const CExifReader& reader, const char* pcszDate,
+		const char* pcszOldDate, bool bInPlace
+	)
+	{
+		const bool bRewrite = reader.GetChunk() >= 0 && !reader.GetComplete();
+		if ( !reader.GetComplete() && !bRewrite )
+		{
+			return false;
+		}
+
+		if ( bInPlace && !bRewrite && CExifPatcher::GetFits( reader ) )
+		{
+			return CExifPatcher::PatchInPlace
+			(
+				pcszPath, reader, pcszDate, pcszOldDate
+			);
+		}
+
+		string csPath;
+		int nFolder = -1;
+		if ( !GetOutputPath( folders, pcszPath, bInPlace, csPath, nFolder ) )
+		{
+			return false;
+		}
+
+		// the copy shares the original's header so the same locations 
+		// apply
+		if ( bRewrite )
+		{
+			CPngRewriter rewriter;
+			if ( !rewriter.Write( pcszPath, csPath.c_str(), reader, pcszDate ) )
+			{
+				return false;
+			}
+
+#ifndef _WIN32
+		} else if ( nFolder >= 0 )
+		{
+			// the copy has the image's name inside of the held folder
+			const string_view data = CPathView( pcszPath ).GetDataName();
+			const char* pcszName = csPath.c_str() + csPath.length() - data.length();
+			if ( !CFileClone::Clone( pcszPath, nFolder, pcszName ) )
+			{
+				return false;
+			}
+
+			FILE* pFile = CFolderCache::OpenFile( nFolder, pcszName );
+			if ( !CExifPatcher::Patch( pFile, reader, pcszDate ) )
+			{
+				unlinkat( nFolder, pcszName, 0 );
+				return false;
+			}
+#endif
+		} else
+		{
+			if ( !CFileClone::Clone( pcszPath, csPath.c_str() ) )
+			{
+				return false;
+			}
+
+			if ( !CExifPatcher::Patch( csPath.c_str(), reader, pcszDate ) )
+			{
+				remove( csPath.c_str() );
+				return false;
+			}
+		}
+
+		return !bInPlace || CFileCommit::Replace( csPath.c_str(), pcszPath );
+	}
+
+	// read, shift and write the date taken of one file, filling in the
+	// entry with the file's old and new dates and its outcome, which is
+	// PLANNED for a dry run and CRunJournal::CORRECTED once written. 
+	// Returns false if the file was not shifted. Any number of threads
+	// may shift files at once.
+	bool Shift( const CPathView& path, PLAN_ENTRY& entry )
+	{
+		entry.m_csPath = path.GetPath();
+		entry.m_csOld.clear();
+		entry.m_csNew.clear();
+		const char* pcszPath = entry.m_csPath.c_str();
+
+		// the first bytes of the file tell what it really is whatever
+		// its name says
+		CExifReader reader;
+		const bool bRead = reader.Read( pcszPath );
+		const CFileClassifier::FILE_KIND eKind = CFileClassifier::Classify
+		(
+			CFileClassifier::GetPathKind( path ),
+			reader.GetMagic(), reader.GetMagicSize()
+		);
+		if ( eKind == CFileClassifier::fkNone )
+		{
+			entry.m_csStatus = CPlanManifest::MISSING;
+			return false;
+		}
+		if ( !bRead )
+		{
+			const bool bEncoded =
+				eKind == CFileClassifier::fkGif || eKind == CFileClassifier::fkBmp;
+			entry.m_csStatus = bEncoded ? UNSUPPORTED : CPlanManifest::MISSING;
+			return false;
+		}
+
+		const char* pcszStatus = nullptr;
+		const char* pcszOldDate = GetDateTaken( reader, pcszStatus );
+		if ( pcszOldDate == nullptr )
+		{
+			entry.m_csStatus = pcszStatus;
+			return false;
+		}
+		entry.m_csOld = pcszOldDate;
+
+		char szDate[ 20 ];
+		if ( !CExifDate::Shift( pcszOldDate, strlen( pcszOldDate ), m_llOffset, szDate ) )
+		{
+			entry.m_csStatus = CPlanManifest::RANGE;
+			return false;
+		}
+		entry.m_csNew = szDate;
+
+		if ( !GetNative( reader ) )
+		{
+			entry.m_csStatus = UNSUPPORTED;
+			return false;
+		}
+		if ( m_bDryRun )
+		{
+			entry.m_csStatus = CPlanManifest::PLANNED;
+			return true;
+		}
+
+		if ( !Save( m_Folders, pcszPath, reader, szDate, pcszOldDate, m_bInPlace ) )
+		{
+			entry.m_csStatus = FAILED;
+			return false;
+		}
+
+		entry.m_csStatus = CRunJournal::CORRECTED;
+		return true;
+	}
+
+	// public construction
+public:
+	CDateShifter( int64_t llOffset, bool bInPlace, bool bDryRun )
+	{
+		m_llOffset = llOffset;
+		m_bInPlace = bInPlace;
+		m_bDryRun = bDryRun;
+	}
+};
+
+/////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,541 @@
+/////////////////////////////////////////////////////////////////////////////
+// Copyright  by W. T. Block, all rights reserved
+/////////////////////////////////////////////////////////////////////////////
+#pragma once
+#include "Metrics.h"
+#include "PathView.h"
+#include <ctype.h>
+#include <string.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include <dirent.h>
+	#include <fcntl.h>
+	#include <sys/stat.h>
+#endif
+
+using namespace std;
+
+/////////////////////////////////////////////////////////////////////////////
+// this class crawls a directory tree with a pool of worker threads where
+// each worker owns a deque of directories waiting to be enumerated. A
+// worker takes its newest directory (depth first) and when it runs dry
+// it steals the oldest directory from another worker (breadth first),
+// so wide and deep trees both keep every thread busy. Files are handed
+// to a callback on the worker thread that found them as a view of a 
+// buffer the worker reuses for every entry of a folder, already split at
+// the folder, so no pathname is built or split again for each file.
+class CDirectoryWalker
+{
+	// public definitions
+public:
+	// called for each file found with a view of its full pathname, which
+	// is only good during the call, and the open handle of the folder it
+	// is in for opening it with openat (-1 where there is none)
+	typedef function<void( const CPathView& path, int nFolder )> FILE_CALLBACK;
+
+	// called for each folder before it is queued along with the folder
+	// it was found in (empty for the root), returning false to skip it
+	typedef function<bool( const string& csFolder, const string& csParent )> FOLDER_CALLBACK;
+
+	// called when a folder has been enumerated
+	typedef function<void( const string& csFolder )> DONE_CALLBACK;
+
+	// protected definitions
+protected:
+	// a worker's queue of directories waiting to be enumerated
+	typedef struct tagWorker
+	{
+		// protects the deque from thieves
+		mutex m_Lock;
+
+		// directory pathnames without a trailing separator
+		deque<string> m_Directories;
+
+	} WORKER;
+
+	// protected data
+protected:
+	// one queue for each worker thread
+	vector<unique_ptr<WORKER>> m_Workers;
+
+	// directories queued or being enumerated, the walk is over
+	// when this reaches zero
+	atomic<long> m_lPending;
+
+	// idle workers sleep on this until a directory is queued or the
+	// walk is over
+	mutex m_IdleLock;
+	condition_variable m_Idle;
+
+	// the number of directories queued so far, which idle workers
+	// compare to tell if a directory was queued since they last looked
+	atomic<unsigned long> m_ulQueued;
+
+	// the number of directories enumerated
+	atomic<unsigned long long> m_ullDirectories;
+
+	// the number of files handed to the callback
+	atomic<unsigned long long> m_ullFiles;
+
+	// wild card pattern entries must match (empty matches everything)
+	string m_csPattern;
+
+	// when true, sub-folders will be processed as well as the base folder
+	bool m_bRecurse;
+
+	// sub-folders ending with this name are not entered
+	string m_csExclude;
+
+	// the number of worker threads
+	int m_nThreads;
+
+	// receives the files found
+	FILE_CALLBACK m_Callback;
+
+	// decides whether each folder is walked (may be empty)
+	FOLDER_CALLBACK m_FolderCallback;
+
+	// told when each folder has been enumerated (may be empty)
+	DONE_CALLBACK m_DoneCallback;
+
+	// times the enumeration of each folder (may be null)
+	CMetrics* m_pMetrics;
+
+	// protected methods
+protected:
+	// case insensitive wild card match supporting '*' and '?'
+	static bool Match( const char* pName, const char* pPattern )
+	{
+		const char* pStar = nullptr;
+		const char* pResume = nullptr;
+
+		while ( *pName != 0 )
+		{
+			if
+			(
+				*pPattern == '?' ||
+				tolower( (unsigned char)*pPattern ) ==
+					tolower( (unsigned char)*pName )
+			)
+			{
+				pName++;
+				pPattern++;
+
+			} else if ( *pPattern == '*' )
+			{
+				pStar = pPattern++;
+				pResume = pName;
+
+			} else if ( pStar != nullptr )
+			{
+				pPattern = pStar + 1;
+				pName = ++pResume;
+
+			} else
+			{
+				return false;
+			}
+		}
+
+		while ( *pPattern == '*' )
+		{
+			pPattern++;
+		}
+
+		return *pPattern == 0;
+	}
+
+	// true if the entry name passes the wild card pattern
+	inline bool GetMatched( const char* pName ) const
+	{
+		if ( m_csPattern.empty() )
+		{
+			return true;
+		}
+		return Match( pName, m_csPattern.c_str() );
+	}
+
+	// true if the sub-folder should be entered
+	inline bool GetEnter( const char* pName ) const
+	{
+		if ( !m_bRecurse || !GetMatched( pName ) )
+		{
+			return false;
+		}
+
+		// do not recurse into the corrected folder
+		const size_t tName = strlen( pName );
+		const size_t tExclude = m_csExclude.length();
+		if
+		(
+			tExclude > 0 && tName >= tExclude &&
+			m_csExclude.compare( 0, tExclude, pName + tName - tExclude ) == 0
+		)
+		{
+			return false;
+		}
+
+		return true;
+	}
+
+	// queue a directory found in the given parent on the given worker
+	// unless the folder callback skips it
+	void Push( int nWorker, const string& csFolder, const string& csParent )
+	{
+		if ( m_FolderCallback && !m_FolderCallback( csFolder, csParent ) )
+		{
+			return;
+		}
+
+		m_lPending++;
+		{
+			WORKER* pWorker = m_Workers[ nWorker ].get();
+			lock_guard<mutex> lock( pWorker->m_Lock );
+			pWorker->m_Directories.push_back( csFolder );
+		}
+
+		// wake an idle worker to steal it
+		{
+			lock_guard<mutex> lock( m_IdleLock );
+			m_ulQueued++;
+		}
+		m_Idle.notify_one();
+	}
+
+	// take the newest directory of the given worker or steal the oldest
+	// directory of another worker, returning false if there is none
+	bool Pop( int nWorker, string& csFolder )
+	{
+		{
+			WORKER* pWorker = m_Workers[ nWorker ].get();
+			lock_guard<mutex> lock( pWorker->m_Lock );
+			if ( !pWorker->m_Directories.empty() )
+			{
+				csFolder = move( pWorker->m_Directories.back() );
+				pWorker->m_Directories.pop_back();
+				return true;
+			}
+		}
+
+		for ( int nVictim = 1; nVictim < m_nThreads; nVictim++ )
+		{
+			WORKER* pWorker =
+				m_Workers[ ( nWorker + nVictim ) % m_nThreads ].get();
+			lock_guard<mutex> lock( pWorker->m_Lock );
+			if ( !pWorker->m_Directories.empty() )
+			{
+				csFolder = move( pWorker->m_Directories.front() );
+				pWorker->m_Directories.pop_front();
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	// enumerate a single directory, queuing its sub-folders on the given
+	// worker and handing its files to the callback
+	void Enumerate( int nWorker, const string& csFolder )
+	{
+		CMetricTimer timer( m_pMetrics, CMetrics::mpEnumerate, csFolder.c_str() );
+		m_ullDirectories++;
+
+		// every entry's pathname is the folder's with the name appended
+		string csPath;
+		csPath.reserve( csFolder.length() + 256 );
+		csPath = csFolder;
+#ifdef _WIN32
+		csPath += '\\';
+#else
+		csPath += '/';
+#endif
+		const size_t tName = csPath.length();
+
+#ifdef _WIN32
+		const string csWildcard = csFolder + "\\*";
+		WIN32_FIND_DATAA data;
+		HANDLE hFind = ::FindFirstFileExA
+		(
+			csWildcard.c_str(), FindExInfoBasic, &data,
+			FindExSearchNameMatch, NULL, FIND_FIRST_EX_LARGE_FETCH
+		);
+		if ( hFind == INVALID_HANDLE_VALUE )
+		{
+			return;
+		}
+
+		do
+		{
+			const char* pName = data.cFileName;
+
+			// skip "." and ".." folder names
+			if
+			(
+				pName[ 0 ] == '.' &&
+				( pName[ 1 ] == 0 || ( pName[ 1 ] == '.' && pName[ 2 ] == 0 ) )
+			)
+			{
+				continue;
+			}
+
+			csPath.resize( tName );
+			csPath += pName;
+			if ( data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY )
+			{
+				if ( GetEnter( pName ) )
+				{
+					Push( nWorker, csPath, csFolder );
+				}
+
+			} else if ( GetMatched( pName ) )
+			{
+				m_ullFiles++;
+				m_Callback( CPathView( csPath, tName ), -1 );
+			}
+
+		} while ( ::FindNextFileA( hFind, &data ) );
+
+		::FindClose( hFind );
+#else
+		DIR* pDir = opendir( csFolder.c_str() );
+		if ( pDir == nullptr )
+		{
+			return;
+		}
+
+		// readdir already fills a buffer of entries with each getdents
+		// call, so calling getdents directly would only save the copy
+		// of each entry at the cost of a Linux only path
+		const int nDir = dirfd( pDir );
+		struct dirent* pEntry = nullptr;
+		while ( ( pEntry = readdir( pDir ) ) != nullptr )
+		{
+			const char* pName = pEntry->d_name;
+
+			// skip "." and ".." folder names
+			if
+			(
+				pName[ 0 ] == '.' &&
+				( pName[ 1 ] == 0 || ( pName[ 1 ] == '.' && pName[ 2 ] == 0 ) )
+			)
+			{
+				continue;
+			}
+
+			// the type is usually known from the directory entry itself,
+			// only ask the file system when it is not
+			bool bDirectory = pEntry->d_type == DT_DIR;
+			bool bFile = pEntry->d_type == DT_REG;
+			if ( pEntry->d_type == DT_UNKNOWN || pEntry->d_type == DT_LNK )
+			{
+				struct stat info;
+				const int nFlags =
+					pEntry->d_type == DT_LNK ? 0 : AT_SYMLINK_NOFOLLOW;
+				if ( fstatat( nDir, pName, &info, nFlags ) == 0 )
+				{
+					// symbolic links to folders are not followed to
+					// avoid cycles in the tree
+					bDirectory =
+						pEntry->d_type != DT_LNK && S_ISDIR( info.st_mode );
+					bFile = S_ISREG( info.st_mode );
+				}
+			}
+
+			csPath.resize( tName );
+			csPath += pName;
+			if ( bDirectory )
+			{
+				if ( GetEnter( pName ) )
+				{
+					Push( nWorker, csPath, csFolder );
+				}
+
+			} else if ( bFile && GetMatched( pName ) )
+			{
+				m_ullFiles++;
+				m_Callback( CPathView( csPath, tName ), nDir );
+			}
+		}
+
+		closedir( pDir );
+#endif
+	}
+
+	// the worker thread's loop which runs until every queue is empty
+	// and no directory is being enumerated
+	void Work( int nWorker )
+	{
+		string csFolder;
+		do
+		{
+			// read before looking in the queues so a directory queued
+			// after they were found empty is not missed
+			const unsigned long ulQueued = m_ulQueued;
+			if ( Pop( nWorker, csFolder ) )
+			{
+				Enumerate( nWorker, csFolder );
+				if ( m_DoneCallback )
+				{
+					m_DoneCallback( csFolder );
+				}
+
+				// the last directory wakes every idle worker to leave
+				if ( --m_lPending == 0 )
+				{
+					{
+						lock_guard<mutex> lock( m_IdleLock );
+					}
+					m_Idle.notify_all();
+				}
+
+			} else if ( m_lPending == 0 )
+			{
+				break;
+
+			} else // sleep while another worker is still enumerating
+			{
+				unique_lock<mutex> lock( m_IdleLock );
+				m_Idle.wait
+				(
+					lock,
+					[ & ]
+					{
+						return m_ulQueued != ulQueued || m_lPending == 0;
+					}
+				);
+			}
+
+		} while ( true );
+	}
+
+	// public properties
+public:
+	// the number of directories enumerated by the last walk
+	inline unsigned long long GetDirectories() const
+	{
+		return m_ullDirectories;
+	}
+
+	// the number of files found by the last walk
+	inline unsigned long long GetFiles() const
+	{
+		return m_ullFiles;
+	}
+
+	// the number of worker threads (defaults to the number of cores)
+	inline int GetThreads() const
+	{
+		return m_nThreads;
+	}
+	// the number of worker threads (defaults to the number of cores)
+	inline void SetThreads( int value )
+	{
+		m_nThreads = value < 1 ? 1 : value;
+	}
+
+	// sub-folders ending with this name are not entered
+	inline void SetExclude( const string& value )
+	{
+		m_csExclude = value;
+	}
+
+	// times the enumeration of each folder (may be null)
+	inline void SetMetrics( CMetrics* value )
+	{
+		m_pMetrics = value;
+	}
+
+	// decides whether each folder is walked (may be empty)
+	inline void SetFolderCallback( FOLDER_CALLBACK value )
+	{
+		m_FolderCallback = value;
+	}
+
+	// told when each folder has been enumerated (may be empty)
+	inline void SetDoneCallback( DONE_CALLBACK value )
+	{
+		m_DoneCallback = value;
+	}
+
+	// public methods
+public:
+	// walk the tree rooted at the given folder handing each file that
+	// matches the wild card pattern (empty for all files) to the callback.
+	// Sub-folders must also match the pattern to be entered, which
+	// matches the behavior of a wild card search.
+	void Walk
+	(
+		const string& csFolder,
+		const string& csPattern,
+		bool bRecurse,
+		FILE_CALLBACK callback
+	)
+	{
+		m_csPattern = csPattern == "*.*" ? string( "*" ) : csPattern;
+		m_bRecurse = bRecurse;
+		m_Callback = callback;
+		m_lPending = 0;
+		m_ulQueued = 0;
+		m_ullDirectories = 0;
+		m_ullFiles = 0;
+
+		m_Workers.clear();
+		for ( int nWorker = 0; nWorker < m_nThreads; nWorker++ )
+		{
+			m_Workers.push_back( unique_ptr<WORKER>( new WORKER ) );
+		}
+
+		// trim the trailing separator from the root
+		string csRoot = csFolder;
+		while
+		(
+			csRoot.length() > 1 &&
+			( csRoot.back() == '\\' || csRoot.back() == '/' )
+		)
+		{
+			csRoot.pop_back();
+		}
+		Push( 0, csRoot, string() );
+
+		vector<thread> threads;
+		for ( int nWorker = 1; nWorker < m_nThreads; nWorker++ )
+		{
+			threads.push_back( thread( &CDirectoryWalker::Work, this, nWorker ) );
+		}
+		Work( 0 );
+
+		for ( thread& worker : threads )
+		{
+			worker.join();
+		}
+	}
+
+	// public construction
+public:
+	CDirectoryWalker()
+	{
+		m_lPending = 0;
+		m_ulQueued = 0;
+		m_ullDirectories = 0;
+		m_ullFiles = 0;
+		m_bRecurse = false;
+		m_pMetrics = nullptr;
+		m_nThreads = (int)thread::hardware_concurrency();
+		if ( m_nThreads < 1 )
+		{
+			m_nThreads = 1;
+		}
+	}
+};
+
+/////////////////////////////////////////////////////////////////////////////
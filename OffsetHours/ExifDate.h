@@ -0,0 +1,363 @@
+/////////////////////////////////////////////////////////////////////////////
+// Copyright  by W. T. Block, all rights reserved
+/////////////////////////////////////////////////////////////////////////////
+#pragma once
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <string_view>
+
+using namespace std;
+
+/////////////////////////////////////////////////////////////////////////////
+// the fields of a date and time
+typedef struct tagDateFields
+{
+	// 4 digit year
+	int m_nYear;
+
+	// month as a number (1..12)
+	int m_nMonth;
+
+	// day of the month (1..31)
+	int m_nDay;
+
+	// hour of the day (0..23)
+	int m_nHour;
+
+	// minute of the hour (0..59)
+	int m_nMinute;
+
+	// second of the minute (0..59)
+	int m_nSecond;
+
+} DATE_FIELDS;
+
+/////////////////////////////////////////////////////////////////////////////
+// this class parses the canonical EXIF date layout "YYYY:MM:DD HH:MM:SS"
+// directly from the bytes of the value without any allocation. The 19
+// bytes are loaded as three overlapping 64 bit words and all of the
+// digits and separators are validated at once (SIMD within a register),
+// so a well formed date costs a handful of instructions and only the
+// nonstandard strings need the slower tokenizing parser.
+//
+// Dates are shifted as whole seconds since 1970-01-01 00:00:00 in 64 bit
+// integers (days from civil and back), so an offset is exact and there
+// is no floating point rounding between reading and writing a date.
+class CExifDate
+{
+	// protected methods
+protected:
+	// load 8 bytes as a 64 bit word (the byte order does not matter
+	// because the masks are loaded the same way)
+	static inline uint64_t Load( const char* p )
+	{
+		uint64_t value;
+		memcpy( &value, p, sizeof( value ) );
+		return value;
+	}
+
+	// true if every byte under the mask is an ASCII digit and every
+	// other byte equals the expected separator byte
+	static inline bool Check
+	(
+		uint64_t ullWord, uint64_t ullDigits, uint64_t ullSeparators
+	)
+	{
+		const uint64_t ullHigh = 0xF0F0F0F0F0F0F0F0ull;
+		const uint64_t ullZero = 0x3030303030303030ull;
+		const uint64_t ullSix = 0x0606060606060606ull;
+
+		// a digit is 0x30..0x39 so its high nibble is 3 and adding 6
+		// does not carry into the high nibble, which cannot overflow
+		// into the next byte once the first test has passed
+		const bool bNibble = ( ullWord & ullHigh & ullDigits ) == ( ullZero & ullDigits );
+		const bool bRange =
+			( ( ullWord + ullSix ) & ullHigh & ullDigits ) == ( ullZero & ullDigits );
+		const bool bSeparators = ( ullWord & ~ullDigits ) == ullSeparators;
+		return bNibble & bRange & bSeparators;
+	}
+
+	// convert two ASCII digits already validated to a number
+	static inline int Two( const char* p )
+	{
+		return ( p[ 0 ] - '0' ) * 10 + ( p[ 1 ] - '0' );
+	}
+
+	// public methods
+public:
+	// true for leap years of the Gregorian calendar
+	static inline bool IsLeapYear( int nYear )
+	{
+		return ( nYear % 4 == 0 && nYear % 100 != 0 ) || nYear % 400 == 0;
+	}
+
+	// the number of days in the given month of the given year
+	static inline int GetDaysInMonth( int nYear, int nMonth )
+	{
+		static const int days[] =
+		{
+			31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31
+		};
+
+		if ( nMonth < 1 || nMonth > 12 )
+		{
+			return 0;
+		}
+		if ( nMonth == 2 && IsLeapYear( nYear ) )
+		{
+			return 29;
+		}
+		return days[ nMonth - 1 ];
+	}
+
+	// true if the fields describe a real date and time in the range
+	// supported by COleDateTime (years 100 through 9999)
+	static inline bool IsValid( const DATE_FIELDS& fields )
+	{
+		return
+			fields.m_nYear >= 100 && fields.m_nYear <= 9999 &&
+			fields.m_nMonth >= 1 && fields.m_nMonth <= 12 &&
+			fields.m_nDay >= 1 &&
+			fields.m_nDay <= GetDaysInMonth( fields.m_nYear, fields.m_nMonth ) &&
+			fields.m_nHour >= 0 && fields.m_nHour <= 23 &&
+			fields.m_nMinute >= 0 && fields.m_nMinute <= 59 &&
+			fields.m_nSecond >= 0 && fields.m_nSecond <= 59;
+	}
+
+	// parse the canonical "YYYY:MM:DD HH:MM:SS" layout into the fields,
+	// returning false if the value does not have that exact layout. The
+	// fields are not range checked, use IsValid for that.
+	static bool Parse( const char* pcszDate, size_t tLength, DATE_FIELDS& fields )
+	{
+		// the value may be followed by its terminating NUL but nothing else
+		if ( tLength < 19 || ( tLength > 19 && pcszDate[ 19 ] != 0 ) )
+		{
+			return false;
+		}
+
+		// digit lanes and expected separators of the three words:
+		// bytes 0..7 "YYYY:MM:", bytes 8..15 "DD HH:MM" and
+		// bytes 11..18 "HH:MM:SS"
+		static const unsigned char digits0[ 8 ] =
+			{ 0xFF, 0xFF, 0xFF, 0xFF, 0, 0xFF, 0xFF, 0 };
+		static const unsigned char separators0[ 8 ] =
+			{ 0, 0, 0, 0, ':', 0, 0, ':' };
+		static const unsigned char digits1[ 8 ] =
+			{ 0xFF, 0xFF, 0, 0xFF, 0xFF, 0, 0xFF, 0xFF };
+		static const unsigned char separators1[ 8 ] =
+			{ 0, 0, ' ', 0, 0, ':', 0, 0 };
+		static const unsigned char digits2[ 8 ] =
+			{ 0xFF, 0xFF, 0, 0xFF, 0xFF, 0, 0xFF, 0xFF };
+		static const unsigned char separators2[ 8 ] =
+			{ 0, 0, ':', 0, 0, ':', 0, 0 };
+
+		const bool bLayout =
+			Check
+			(
+				Load( pcszDate ),
+				Load( (const char*)digits0 ), Load( (const char*)separators0 )
+			) &
+			Check
+			(
+				Load( pcszDate + 8 ),
+				Load( (const char*)digits1 ), Load( (const char*)separators1 )
+			) &
+			Check
+			(
+				Load( pcszDate + 11 ),
+				Load( (const char*)digits2 ), Load( (const char*)separators2 )
+			);
+
+		if ( !bLayout )
+		{
+			return false;
+		}
+
+		fields.m_nYear = Two( pcszDate ) * 100 + Two( pcszDate + 2 );
+		fields.m_nMonth = Two( pcszDate + 5 );
+		fields.m_nDay = Two( pcszDate + 8 );
+		fields.m_nHour = Two( pcszDate + 11 );
+		fields.m_nMinute = Two( pcszDate + 14 );
+		fields.m_nSecond = Two( pcszDate + 17 );
+		return true;
+	}
+
+	// parse the canonical "YYYY:MM:DD HH:MM:SS" layout into the fields,
+	// returning false if the value does not have that exact layout
+	static inline bool Parse( string_view value, DATE_FIELDS& fields )
+	{
+		return Parse( value.data(), value.size(), fields );
+	}
+
+	// the number of days since 1970-01-01 of the given date in the
+	// proleptic Gregorian calendar (negative before 1970)
+	static inline int64_t DaysFromCivil( int nYear, int nMonth, int nDay )
+	{
+		// years begin in March so the leap day is the last day of a year
+		const int64_t llYear = (int64_t)nYear - ( nMonth <= 2 ? 1 : 0 );
+		const int64_t llEra = ( llYear >= 0 ? llYear : llYear - 399 ) / 400;
+		const int64_t llYearOfEra = llYear - llEra * 400;
+		const int64_t llDayOfYear =
+			( 153 * ( nMonth > 2 ? nMonth - 3 : nMonth + 9 ) + 2 ) / 5 + nDay - 1;
+		const int64_t llDayOfEra =
+			llYearOfEra * 365 + llYearOfEra / 4 - llYearOfEra / 100 + llDayOfYear;
+		return llEra * 146097 + llDayOfEra - 719468;
+	}
+
+	// the year, month and day of the given number of days since 1970-01-01
+	static inline void CivilFromDays( int64_t llDays, DATE_FIELDS& fields )
+	{
+		llDays += 719468;
+		const int64_t llEra = ( llDays >= 0 ? llDays : llDays - 146096 ) / 146097;
+		const int64_t llDayOfEra = llDays - llEra * 146097;
+		const int64_t llYearOfEra =
+		(
+			llDayOfEra - llDayOfEra / 1460 + llDayOfEra / 36524 -
+			llDayOfEra / 146096
+		) / 365;
+		const int64_t llDayOfYear =
+			llDayOfEra - ( 365 * llYearOfEra + llYearOfEra / 4 - llYearOfEra / 100 );
+		const int64_t llMonth = ( 5 * llDayOfYear + 2 ) / 153;
+
+		fields.m_nDay = (int)( llDayOfYear - ( 153 * llMonth + 2 ) / 5 + 1 );
+		fields.m_nMonth = (int)( llMonth < 10 ? llMonth + 3 : llMonth - 9 );
+		fields.m_nYear =
+			(int)( llYearOfEra + llEra * 400 + ( fields.m_nMonth <= 2 ? 1 : 0 ) );
+	}
+
+	// the number of seconds since 1970-01-01 00:00:00 of the fields
+	static inline int64_t ToSeconds( const DATE_FIELDS& fields )
+	{
+		return
+			DaysFromCivil( fields.m_nYear, fields.m_nMonth, fields.m_nDay ) * 86400 +
+			fields.m_nHour * 3600 + fields.m_nMinute * 60 + fields.m_nSecond;
+	}
+
+	// the fields of the given number of seconds since 1970-01-01 00:00:00
+	static inline void FromSeconds( int64_t llSeconds, DATE_FIELDS& fields )
+	{
+		int64_t llDays = llSeconds / 86400;
+		int64_t llTime = llSeconds % 86400;
+		if ( llTime < 0 )
+		{
+			llTime += 86400;
+			llDays--;
+		}
+
+		CivilFromDays( llDays, fields );
+		fields.m_nHour = (int)( llTime / 3600 );
+		fields.m_nMinute = (int)( llTime / 60 % 60 );
+		fields.m_nSecond = (int)( llTime % 60 );
+	}
+
+	// convert an offset in hours to milliseconds, rounding once so the
+	// fractions in the usage text (a second is 0.0002777777777777 hours)
+	// become exact whole numbers of seconds
+	static inline int64_t GetOffsetMilliseconds( double dHours )
+	{
+		return (int64_t)llround( dHours * 3600000.0 );
+	}
+
+	// shift the fields by the given number of milliseconds, rounding a
+	// partial second to the nearest second because EXIF dates have no
+	// fraction, and returning false if the result is not a valid date
+	static inline bool Shift( DATE_FIELDS& fields, int64_t llOffset )
+	{
+		if ( !IsValid( fields ) )
+		{
+			return false;
+		}
+
+		int64_t llSeconds = llOffset / 1000;
+		const int64_t llFraction = llOffset % 1000;
+		if ( llFraction >= 500 )
+		{
+			llSeconds++;
+
+		} else if ( llFraction <= -500 )
+		{
+			llSeconds--;
+		}
+
+		FromSeconds( ToSeconds( fields ) + llSeconds, fields );
+		return IsValid( fields );
+	}
+
+	// write the fields as "YYYY:MM:DD HH:MM:SS" and a terminating NUL into
+	// the 20 byte buffer (the fields must be valid)
+	static inline void Format( const DATE_FIELDS& fields, char* pszDate )
+	{
+		const int nCentury = fields.m_nYear / 100;
+		const int nYear = fields.m_nYear % 100;
+		const char pairs[ 7 ] =
+		{
+			(char)nCentury, (char)nYear, (char)fields.m_nMonth,
+			(char)fields.m_nDay, (char)fields.m_nHour,
+			(char)fields.m_nMinute, (char)fields.m_nSecond
+		};
+
+		// the positions of the pairs of digits in the output
+		static const int positions[ 7 ] = { 0, 2, 5, 8, 11, 14, 17 };
+		for ( int nPair = 0; nPair < 7; nPair++ )
+		{
+			char* pDigits = pszDate + positions[ nPair ];
+			pDigits[ 0 ] = (char)( '0' + pairs[ nPair ] / 10 );
+			pDigits[ 1 ] = (char)( '0' + pairs[ nPair ] % 10 );
+		}
+
+		pszDate[ 4 ] = ':';
+		pszDate[ 7 ] = ':';
+		pszDate[ 10 ] = ' ';
+		pszDate[ 13 ] = ':';
+		pszDate[ 16 ] = ':';
+		pszDate[ 19 ] = 0;
+	}
+
+	// parse, shift and format a single canonical date into the 20 byte
+	// output buffer, returning false if the input is not a valid date in
+	// the canonical layout or the result is out of range
+	static inline bool Shift
+	(
+		const char* pcszDate, size_t tLength, int64_t llOffset, char* pszDate
+	)
+	{
+		DATE_FIELDS fields;
+		if ( !Parse( pcszDate, tLength, fields ) || !Shift( fields, llOffset ) )
+		{
+			return false;
+		}
+
+		Format( fields, pszDate );
+		return true;
+	}
+
+	// shift a batch of dates stored as fixed 20 byte records (the size of
+	// an EXIF date value with its NUL) by the same offset. A record that
+	// cannot be shifted is written as an empty string and the number of
+	// records that were shifted is returned.
+	static size_t ShiftBatch
+	(
+		const char* pcszDates, size_t tCount, int64_t llOffset, char* pszDates
+	)
+	{
+		size_t value = 0;
+		for ( size_t tDate = 0; tDate < tCount; tDate++ )
+		{
+			const char* pcszDate = pcszDates + tDate * 20;
+			char* pszDate = pszDates + tDate * 20;
+			if ( Shift( pcszDate, 20, llOffset, pszDate ) )
+			{
+				value++;
+
+			} else
+			{
+				pszDate[ 0 ] = 0;
+			}
+		}
+
+		return value;
+	}
+};
+
+/////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,296 @@
+/////////////////////////////////////////////////////////////////////////////
+// Copyright  by W. T. Block, all rights reserved
+/////////////////////////////////////////////////////////////////////////////
+#pragma once
+#include "Crc32.h"
+#include "ExifReader.h"
+#include "FileCommit.h"
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#ifdef _WIN32
+	#include <windows.h>
+	#include <io.h>
+#else
+	#include <unistd.h>
+#endif
+
+/////////////////////////////////////////////////////////////////////////////
+// this class overwrites the EXIF original and digitized date values
+// located by CExifReader directly in the file, so the image data is
+// never decoded or re-encoded and the cost of each file depends on the
+// size of its header instead of the size of its image. The CRC of the
+// eXIf chunk of a PNG file is computed again over the patched chunk.
+// A file patched in place has every changed byte written by a single
+// write of the span that covers them, so it is never left with one date
+// changed and the other not.
+class CExifPatcher
+{
+	// public definitions
+public:
+	// the largest span of bytes that is patched in place
+	static const long long m_llMaxSpan = 64 * 1024;
+
+	// protected methods
+protected:
+	// read or write the bytes at the given offset of the file by a 
+	// single positional call that neither moves the file position nor
+	// passes through the stream's buffer
+	static bool TransferAt
+	(
+		FILE* pFile, long long llOffset, unsigned char* pData, size_t tSize,
+		bool bWrite
+	)
+	{
+#ifdef _WIN32
+		const HANDLE hFile = (HANDLE)_get_osfhandle( _fileno( pFile ) );
+		if ( hFile == INVALID_HANDLE_VALUE || tSize > MAXDWORD )
+		{
+			return false;
+		}
+
+		OVERLAPPED overlapped = {};
+		overlapped.Offset = (DWORD)llOffset;
+		overlapped.OffsetHigh = (DWORD)( (unsigned long long)llOffset >> 32 );
+		DWORD dwDone = 0;
+		const BOOL bDone = bWrite ?
+			::WriteFile( hFile, pData, (DWORD)tSize, &dwDone, &overlapped ) :
+			::ReadFile( hFile, pData, (DWORD)tSize, &dwDone, &overlapped );
+		return bDone && dwDone == tSize;
+#else
+		const ssize_t tDone = bWrite ?
+			pwrite( fileno( pFile ), pData, tSize, (off_t)llOffset ) :
+			pread( fileno( pFile ), pData, tSize, (off_t)llOffset );
+		return tDone >= 0 && (size_t)tDone == tSize;
+#endif
+	}
+
+	// true for the dates that are patched
+	static inline bool IsPatched( const EXIF_DATE& date )
+	{
+		return
+			date.m_usTag == CExifReader::ttDTOrig ||
+			date.m_usTag == CExifReader::ttDTDigitized;
+	}
+
+	// the span of the file that covers the patched dates along with the
+	// eXIf chunk of a PNG file, returning false if there is nothing to
+	// patch
+	static bool GetSpan
+	(
+		const CExifReader& reader, long long& llStart, long long& llEnd
+	)
+	{
+		llStart = -1;
+		llEnd = -1;
+		for ( const EXIF_DATE& date : reader.GetDates() )
+		{
+			if ( !IsPatched( date ) )
+			{
+				continue;
+			}
+			if ( llStart < 0 || date.m_llOffset < llStart )
+			{
+				llStart = date.m_llOffset;
+			}
+			if ( date.m_llOffset + 20 > llEnd )
+			{
+				llEnd = date.m_llOffset + 20;
+			}
+		}
+
+		// the chunk's type and data which the CRC covers and the CRC
+		if ( llStart >= 0 && reader.GetPng() )
+		{
+			llStart = min( llStart, reader.GetChunk() + 4 );
+			llEnd = max
+			(
+				llEnd, reader.GetChunk() + 12 + (long long)reader.GetChunkLength()
+			);
+		}
+
+		return llStart >= 0;
+	}
+
+	// compute the CRC of a PNG chunk again after its data was changed
+	static bool UpdateCrc( FILE* pFile, long long llChunk, unsigned long ulLength )
+	{
+		// the CRC covers the chunk type and data
+		vector<unsigned char> chunk( 4 + (size_t)ulLength );
+		if
+		(
+			!CExifReader::Seek( pFile, llChunk + 4 ) ||
+			fread( chunk.data(), 1, chunk.size(), pFile ) != chunk.size()
+		)
+		{
+			return false;
+		}
+
+		const uint32_t ulCrc = CCrc32::Update( 0, chunk.data(), chunk.size() );
+		const unsigned char crc[ 4 ] =
+		{
+			(unsigned char)( ulCrc >> 24 ), (unsigned char)( ulCrc >> 16 ),
+			(unsigned char)( ulCrc >> 8 ), (unsigned char)ulCrc
+		};
+		return
+			CExifReader::Seek( pFile, llChunk + 8 + (long long)ulLength ) &&
+			fwrite( crc, 1, sizeof( crc ), pFile ) == sizeof( crc );
+	}
+
+	// public methods
+public:
+	// true if the dates found by the reader can be patched in place by
+	// a single write
+	static bool GetFits( const CExifReader& reader )
+	{
+		long long llStart = 0;
+		long long llEnd = 0;
+		return
+			reader.GetComplete() &&
+			GetSpan( reader, llStart, llEnd ) &&
+			llEnd - llStart <= m_llMaxSpan;
+	}
+
+	// overwrite the original and digitized date values of the file that
+	// was read with the given date by reading the span that covers them,
+	// patching it in memory and writing it back with a single write which
+	// is flushed to the disk. The span must still hold the date that was
+	// read so a file that has changed since is left alone.
+	static bool PatchInPlace
+	(
+		const char* pcszPath, const CExifReader& reader, const char* pcszDate,
+		const char* pcszOldDate
+	)
+	{
+		long long llStart = 0;
+		long long llEnd = 0;
+		if
+		(
+			!GetFits( reader ) || strlen( pcszDate ) != 19 ||
+			!GetSpan( reader, llStart, llEnd )
+		)
+		{
+			return false;
+		}
+
+		FILE* pFile = fopen( pcszPath, "r+b" );
+		if ( pFile == nullptr )
+		{
+			return false;
+		}
+
+		vector<unsigned char> span( (size_t)( llEnd - llStart ) );
+		bool value = TransferAt( pFile, llStart, span.data(), span.size(), false );
+
+		bool bFound = false;
+		for ( const EXIF_DATE& date : reader.GetDates() )
+		{
+			if ( !value || !IsPatched( date ) )
+			{
+				continue;
+			}
+
+			unsigned char* pDate = span.data() + ( date.m_llOffset - llStart );
+			bFound = bFound || memcmp( pDate, pcszOldDate, 19 ) == 0;
+			memcpy( pDate, pcszDate, 20 );
+		}
+		value = value && bFound;
+
+		if ( value && reader.GetPng() )
+		{
+			const size_t tChunk = (size_t)( reader.GetChunk() + 4 - llStart );
+			const size_t tLength = 4 + (size_t)reader.GetChunkLength();
+			const uint32_t ulCrc =
+				CCrc32::Update( 0, span.data() + tChunk, tLength );
+			unsigned char* pCrc = span.data() + tChunk + tLength;
+			pCrc[ 0 ] = (unsigned char)( ulCrc >> 24 );
+			pCrc[ 1 ] = (unsigned char)( ulCrc >> 16 );
+			pCrc[ 2 ] = (unsigned char)( ulCrc >> 8 );
+			pCrc[ 3 ] = (unsigned char)ulCrc;
+		}
+
+		// the span goes to the file in one write
+		value =
+			value &&
+			TransferAt( pFile, llStart, span.data(), span.size(), true ) &&
+			CFileCommit::Commit( pFile );
+
+		if ( fclose( pFile ) != 0 )
+		{
+			value = false;
+		}
+
+		return value;
+	}
+
+	// overwrite the original and digitized date values found by the
+	// reader with the given date in "YYYY:MM:DD HH:MM:SS" format. The
+	// file is not required to be the one that was read, only to share
+	// its header, so a copy of the original can be patched.
+	static bool Patch
+	(
+		const char* pcszPath, const CExifReader& reader, const char* pcszDate
+	)
+	{
+		if ( !reader.GetComplete() || strlen( pcszDate ) != 19 )
+		{
+			return false;
+		}
+
+		return Patch( fopen( pcszPath, "r+b" ), reader, pcszDate );
+	}
+
+	// overwrite the dates of a file opened for reading and writing which
+	// is closed when done
+	static bool Patch
+	(
+		FILE* pFile, const CExifReader& reader, const char* pcszDate
+	)
+	{
+		if ( pFile == nullptr )
+		{
+			return false;
+		}
+		if ( !reader.GetComplete() || strlen( pcszDate ) != 19 )
+		{
+			fclose( pFile );
+			return false;
+		}
+
+		bool value = true;
+		for ( const EXIF_DATE& date : reader.GetDates() )
+		{
+			if ( !IsPatched( date ) )
+			{
+				continue;
+			}
+
+			// write the terminating NUL as well in case the old value
+			// was longer than the standard format
+			if
+			(
+				!CExifReader::Seek( pFile, date.m_llOffset ) ||
+				fwrite( pcszDate, 1, 20, pFile ) != 20
+			)
+			{
+				value = false;
+				break;
+			}
+		}
+
+		if ( value && reader.GetPng() )
+		{
+			value = UpdateCrc( pFile, reader.GetChunk(), reader.GetChunkLength() );
+		}
+
+		if ( fclose( pFile ) != 0 )
+		{
+			value = false;
+		}
+
+		return value;
+	}
+};
+
+/////////////////////////////////////////////////////////////////////////////
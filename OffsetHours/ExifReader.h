@@ -0,0 +1,806 @@
+/////////////////////////////////////////////////////////////////////////////
+// Copyright  by W. T. Block, all rights reserved
+/////////////////////////////////////////////////////////////////////////////
+#pragma once
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#ifndef _WIN32
+	#include <sys/types.h>
+#endif
+
+using namespace std;
+
+/////////////////////////////////////////////////////////////////////////////
+// an ASCII date value found in the EXIF header of an image file
+typedef struct tagExifDate
+{
+	// the TIFF tag of the date value
+	unsigned short m_usTag;
+
+	// the number of characters reserved for the value including
+	// the terminating NUL
+	unsigned long m_ulCount;
+
+	// offset of the value's first character from the start of the file
+	// (which may be beyond 4 GB in a BigTIFF file)
+	long long m_llOffset;
+
+	// the value which should be in the format "YYYY:MM:DD HH:MM:SS"
+	char m_szValue[ 32 ];
+
+} EXIF_DATE;
+
+/////////////////////////////////////////////////////////////////////////////
+// this class opens an image file once and reads only the leading bytes
+// holding the EXIF segment (usually well under 64 KB) to return the
+// values and file offsets of every date tag without constructing an
+// image, so the same result can be used to read the dates and later
+// to patch them. TIFF files and the raw formats built on TIFF (DNG, CR2,
+// NEF and ARW) are TIFF structures themselves, so their directories are
+// read wherever they are in the file with a seek for each directory and
+// date, which costs a few page reads however large the image is. Both
+// byte orders and BigTIFF's 64 bit offsets are supported. A PNG file
+// keeps its EXIF data in an eXIf chunk which is found by hopping from
+// chunk header to chunk header up to the image data.
+class CExifReader
+{
+	// public definitions
+public:
+	typedef enum
+	{
+		ttDateTime = 0x0132,	// DateTime (IFD0)
+		ttExifIFD = 0x8769,		// pointer to the EXIF sub-IFD
+		ttDTOrig = 0x9003,		// DateTimeOriginal
+		ttDTDigitized = 0x9004,	// DateTimeDigitized
+	} TIFF_TAG;
+
+	// protected definitions
+protected:
+	typedef enum
+	{
+		jmMarker = 0xFF,		// every marker begins with this byte
+		jmSOI = 0xD8,			// start of image
+		jmEOI = 0xD9,			// end of image
+		jmSOS = 0xDA,			// start of scan (image data follows)
+		jmAPP1 = 0xE1,			// application segment holding EXIF
+		jmTEM = 0x01,			// temporary marker (no length)
+		jmRST0 = 0xD0,			// first restart marker (no length)
+		jmRST7 = 0xD7,			// last restart marker (no length)
+	} JPEG_MARKER;
+
+	typedef enum
+	{
+		ftASCII = 2,			// NUL terminated 7-bit ASCII
+		ftLong = 4,				// 32 bit unsigned integer
+		ftIFD = 13,				// 32 bit offset to an IFD
+		ftLong8 = 16,			// 64 bit unsigned integer (BigTIFF)
+		ftIFD8 = 18,			// 64 bit offset to an IFD (BigTIFF)
+	} FIELD_TYPE;
+
+	typedef enum
+	{
+		tvClassic = 42,			// 32 bit offsets
+		tvBig = 43,				// 64 bit offsets (BigTIFF)
+	} TIFF_VERSION;
+
+	// the number of leading bytes read in a single request
+	static const size_t m_tBlock = 64 * 1024;
+
+	// the most entries a TIFF directory is trusted to have
+	static const unsigned long long m_ullMaxEntries = 4096;
+
+	// the largest eXIf chunk that is read
+	static const unsigned long m_ulMaxChunk = 16 * 1024 * 1024;
+
+	// protected data
+protected:
+	// the leading bytes of the file
+	vector<unsigned char> m_Header;
+
+	// true for Intel (little endian) byte order, false for Motorola
+	bool m_bIntel;
+
+	// the offset of the TIFF header in the leading bytes
+	size_t m_tTiff;
+
+	// the number of bytes of TIFF data in the EXIF segment
+	size_t m_tTiffSize;
+
+	// true for a BigTIFF file with 64 bit counts and offsets
+	bool m_bBig;
+
+	// the offset in the file of the first byte of the header (not zero
+	// when the header holds the eXIf chunk of a PNG file)
+	long long m_llHeader;
+
+	// true for a PNG file
+	bool m_bPng;
+
+	// the offset of a PNG file's eXIf chunk (-1 if there is none) and
+	// the length of its data
+	long long m_llChunk;
+	unsigned long m_ulChunk;
+
+	// the first bytes of the file which identify its format and their
+	// number (less than all of them for a short file)
+	unsigned char m_Magic[ 16 ];
+	size_t m_tMagic;
+
+	// the date values found in the EXIF header
+	vector<EXIF_DATE> m_Dates;
+
+	// protected methods
+protected:
+	// read an unsigned 16 bit value in the file's byte order
+	inline unsigned short GetShort( const unsigned char* p ) const
+	{
+		if ( m_bIntel )
+		{
+			return (unsigned short)( p[ 0 ] | p[ 1 ] << 8 );
+		}
+		return (unsigned short)( p[ 0 ] << 8 | p[ 1 ] );
+	}
+
+	// read an unsigned 32 bit value in the file's byte order
+	inline unsigned long GetLong( const unsigned char* p ) const
+	{
+		if ( m_bIntel )
+		{
+			return
+				(unsigned long)p[ 0 ] | (unsigned long)p[ 1 ] << 8 |
+				(unsigned long)p[ 2 ] << 16 | (unsigned long)p[ 3 ] << 24;
+		}
+		return
+			(unsigned long)p[ 0 ] << 24 | (unsigned long)p[ 1 ] << 16 |
+			(unsigned long)p[ 2 ] << 8 | (unsigned long)p[ 3 ];
+	}
+
+	// read an unsigned 64 bit value in the file's byte order
+	inline unsigned long long GetLongLong( const unsigned char* p ) const
+	{
+		const unsigned long long ullFirst = GetLong( p );
+		const unsigned long long ullSecond = GetLong( p + 4 );
+		return m_bIntel ? ullSecond << 32 | ullFirst : ullFirst << 32 | ullSecond;
+	}
+
+	// make sure at least tSize leading bytes have been read, reading
+	// whole blocks at a time, and return false at the end of the file
+	bool Fill( FILE* pFile, size_t tSize )
+	{
+		size_t tHave = m_Header.size();
+		while ( tHave < tSize )
+		{
+			m_Header.resize( tHave + m_tBlock );
+			const size_t tRead =
+				fread( m_Header.data() + tHave, 1, m_tBlock, pFile );
+			tHave += tRead;
+			m_Header.resize( tHave );
+			if ( tRead == 0 )
+			{
+				break;
+			}
+		}
+
+		return tHave >= tSize;
+	}
+
+	// find the 12 byte directory entry of the given tag in the IFD at the
+	// given offset of the TIFF data or return null if it is not found
+	const unsigned char* FindEntry( unsigned long ulIFD, unsigned short usTag )
+	{
+		// compare without adding so a crafted offset cannot wrap around
+		if ( ulIFD < 8 || ulIFD > m_tTiffSize || m_tTiffSize - ulIFD < 2 )
+		{
+			return nullptr;
+		}
+
+		const unsigned char* pTiff = m_Header.data() + m_tTiff;
+		const unsigned short usEntries = GetShort( pTiff + ulIFD );
+		const unsigned char* pEntry = pTiff + ulIFD + 2;
+		const unsigned char* pEnd = pTiff + m_tTiffSize;
+
+		for ( unsigned short usEntry = 0; usEntry < usEntries; usEntry++ )
+		{
+			if ( pEntry + 12 > pEnd )
+			{
+				break;
+			}
+
+			if ( GetShort( pEntry ) == usTag )
+			{
+				return pEntry;
+			}
+
+			pEntry += 12;
+		}
+
+		return nullptr;
+	}
+
+	// record the value and location of an ASCII date described by
+	// the given directory entry
+	void AddDate( const unsigned char* pEntry )
+	{
+		if ( pEntry == nullptr || GetShort( pEntry + 2 ) != ftASCII )
+		{
+			return;
+		}
+
+		// a date is too long to be stored inside of the entry itself
+		const unsigned long ulCount = GetLong( pEntry + 4 );
+		const unsigned long ulOffset = GetLong( pEntry + 8 );
+		if
+		(
+			ulCount <= 4 || ulOffset > m_tTiffSize ||
+			ulCount > m_tTiffSize - ulOffset
+		)
+		{
+			return;
+		}
+
+		EXIF_DATE date;
+		date.m_usTag = GetShort( pEntry );
+		date.m_ulCount = ulCount;
+		date.m_llOffset = m_llHeader + (long long)( m_tTiff + ulOffset );
+
+		// copy up to the terminating NUL
+		const char* pValue =
+			(const char*)m_Header.data() + m_tTiff + ulOffset;
+		size_t tLength = 0;
+		while
+		(
+			tLength < ulCount && tLength < sizeof( date.m_szValue ) - 1 &&
+			pValue[ tLength ] != 0
+		)
+		{
+			tLength++;
+		}
+		memcpy( date.m_szValue, pValue, tLength );
+		date.m_szValue[ tLength ] = 0;
+
+		m_Dates.push_back( date );
+	}
+
+	// walk IFD0 and the EXIF sub-IFD and record the date values found
+	void ParseTiff()
+	{
+		if ( m_tTiffSize < 8 )
+		{
+			return;
+		}
+
+		const unsigned char* pTiff = m_Header.data() + m_tTiff;
+		if ( pTiff[ 0 ] == 'I' && pTiff[ 1 ] == 'I' )
+		{
+			m_bIntel = true;
+
+		} else if ( pTiff[ 0 ] == 'M' && pTiff[ 1 ] == 'M' )
+		{
+			m_bIntel = false;
+
+		} else // not a TIFF header
+		{
+			return;
+		}
+
+		if ( GetShort( pTiff + 2 ) != 42 )
+		{
+			return;
+		}
+
+		const unsigned long ulIFD0 = GetLong( pTiff + 4 );
+		AddDate( FindEntry( ulIFD0, ttDateTime ) );
+
+		const unsigned char* pExif = FindEntry( ulIFD0, ttExifIFD );
+		if ( pExif == nullptr )
+		{
+			return;
+		}
+
+		const unsigned short usType = GetShort( pExif + 2 );
+		if ( usType != ftLong && usType != ftIFD )
+		{
+			return;
+		}
+
+		const unsigned long ulExif = GetLong( pExif + 8 );
+		AddDate( FindEntry( ulExif, ttDTOrig ) );
+		AddDate( FindEntry( ulExif, ttDTDigitized ) );
+	}
+
+	// read bytes of a TIFF file from the leading bytes already read or
+	// from anywhere else in the file
+	bool ReadAt
+	(
+		FILE* pFile, unsigned long long ullOffset, size_t tSize, unsigned char* pData
+	)
+	{
+		// compare without adding so a crafted offset cannot wrap around
+		const size_t tHave = m_Header.size();
+		if ( ullOffset <= tHave && tSize <= tHave - ullOffset )
+		{
+			memcpy( pData, m_Header.data() + ullOffset, tSize );
+			return true;
+		}
+
+		return
+			Seek( pFile, (long long)ullOffset ) &&
+			fread( pData, 1, tSize, pFile ) == tSize;
+	}
+
+	// the size of a directory entry of a TIFF file
+	inline size_t GetEntrySize() const
+	{
+		return m_bBig ? 20 : 12;
+	}
+
+	// read the entries of the TIFF directory at the given offset of the
+	// file, returning false if it cannot be read
+	bool ReadDirectory
+	(
+		FILE* pFile, unsigned long long ullIFD, vector<unsigned char>& entries
+	)
+	{
+		unsigned char count[ 8 ];
+		const size_t tCount = m_bBig ? 8 : 2;
+		if ( ullIFD < 8 || !ReadAt( pFile, ullIFD, tCount, count ) )
+		{
+			return false;
+		}
+
+		const unsigned long long ullEntries =
+			m_bBig ? GetLongLong( count ) : GetShort( count );
+		if ( ullEntries == 0 || ullEntries > m_ullMaxEntries )
+		{
+			return false;
+		}
+
+		entries.resize( (size_t)ullEntries * GetEntrySize() );
+		return ReadAt( pFile, ullIFD + tCount, entries.size(), entries.data() );
+	}
+
+	// find the entry of the given tag in a TIFF directory or return null
+	const unsigned char* FindEntry
+	(
+		const vector<unsigned char>& entries, unsigned short usTag
+	) const
+	{
+		const size_t tEntry = GetEntrySize();
+		for ( size_t tPos = 0; tPos + tEntry <= entries.size(); tPos += tEntry )
+		{
+			if ( GetShort( entries.data() + tPos ) == usTag )
+			{
+				return entries.data() + tPos;
+			}
+		}
+		return nullptr;
+	}
+
+	// the count and the value or offset of a TIFF directory entry
+	inline unsigned long long GetCount( const unsigned char* pEntry ) const
+	{
+		return m_bBig ? GetLongLong( pEntry + 4 ) : GetLong( pEntry + 4 );
+	}
+	inline unsigned long long GetValue( const unsigned char* pEntry ) const
+	{
+		return m_bBig ? GetLongLong( pEntry + 12 ) : GetLong( pEntry + 8 );
+	}
+
+	// record the value and location of an ASCII date described by the
+	// given entry of a TIFF directory
+	void AddDate( FILE* pFile, const unsigned char* pEntry )
+	{
+		if ( pEntry == nullptr || GetShort( pEntry + 2 ) != ftASCII )
+		{
+			return;
+		}
+
+		// a date is too long to be stored inside of the entry itself
+		const unsigned long long ullCount = GetCount( pEntry );
+		if ( ullCount <= ( m_bBig ? 8u : 4u ) )
+		{
+			return;
+		}
+
+		EXIF_DATE date;
+		date.m_usTag = GetShort( pEntry );
+		date.m_ulCount =
+			ullCount > 0xFFFFFFFF ? 0xFFFFFFFF : (unsigned long)ullCount;
+		date.m_llOffset = (long long)GetValue( pEntry );
+
+		// copy up to the terminating NUL
+		const size_t tRead = ullCount < sizeof( date.m_szValue ) - 1 ?
+			(size_t)ullCount : sizeof( date.m_szValue ) - 1;
+		unsigned char value[ sizeof( date.m_szValue ) ];
+		if ( !ReadAt( pFile, (unsigned long long)date.m_llOffset, tRead, value ) )
+		{
+			return;
+		}
+		size_t tLength = 0;
+		while ( tLength < tRead && value[ tLength ] != 0 )
+		{
+			tLength++;
+		}
+		memcpy( date.m_szValue, value, tLength );
+		date.m_szValue[ tLength ] = 0;
+
+		m_Dates.push_back( date );
+	}
+
+	// walk IFD0 and the EXIF sub-IFD of a TIFF file and record the date
+	// values found, returning false if it is not a TIFF file
+	bool ReadTiff( FILE* pFile )
+	{
+		if ( !Fill( pFile, 16 ) )
+		{
+			return false;
+		}
+
+		const unsigned char* pHeader = m_Header.data();
+		m_bIntel = pHeader[ 0 ] == 'I';
+		const unsigned short usVersion = GetShort( pHeader + 2 );
+		unsigned long long ullIFD0 = 0;
+		if ( usVersion == tvClassic )
+		{
+			m_bBig = false;
+			ullIFD0 = GetLong( pHeader + 4 );
+
+		} else if ( usVersion == tvBig && GetShort( pHeader + 4 ) == 8 )
+		{
+			m_bBig = true;
+			ullIFD0 = GetLongLong( pHeader + 8 );
+
+		} else // not a TIFF file
+		{
+			return false;
+		}
+
+		vector<unsigned char> entries;
+		if ( !ReadDirectory( pFile, ullIFD0, entries ) )
+		{
+			return true;
+		}
+		AddDate( pFile, FindEntry( entries, ttDateTime ) );
+
+		const unsigned char* pExif = FindEntry( entries, ttExifIFD );
+		if ( pExif == nullptr )
+		{
+			return true;
+		}
+
+		const unsigned short usType = GetShort( pExif + 2 );
+		if
+		(
+			usType != ftLong && usType != ftIFD &&
+			usType != ftLong8 && usType != ftIFD8
+		)
+		{
+			return true;
+		}
+
+		// a 32 bit pointer is in the first 4 bytes of a BigTIFF value
+		unsigned long long ullExif = GetValue( pExif );
+		if ( m_bBig && ( usType == ftLong || usType == ftIFD ) )
+		{
+			ullExif = GetLong( pExif + 12 );
+		}
+
+		vector<unsigned char> exif;
+		if ( ReadDirectory( pFile, ullExif, exif ) )
+		{
+			AddDate( pFile, FindEntry( exif, ttDTOrig ) );
+			AddDate( pFile, FindEntry( exif, ttDTDigitized ) );
+		}
+		return true;
+	}
+
+	// find the eXIf chunk of a PNG file before its image data and record
+	// the date values it holds
+	void ReadPng( FILE* pFile )
+	{
+		m_bPng = true;
+		unsigned long long ullPos = 8;
+		unsigned char chunk[ 8 ];
+		while ( ReadAt( pFile, ullPos, sizeof( chunk ), chunk ) )
+		{
+			// chunk lengths are always in network byte order
+			const unsigned long ulLength =
+				(unsigned long)chunk[ 0 ] << 24 | (unsigned long)chunk[ 1 ] << 16 |
+				(unsigned long)chunk[ 2 ] << 8 | (unsigned long)chunk[ 3 ];
+			const char* pType = (const char*)chunk + 4;
+
+			if ( memcmp( pType, "IDAT", 4 ) == 0 || memcmp( pType, "IEND", 4 ) == 0 )
+			{
+				break;
+			}
+
+			if ( memcmp( pType, "eXIf", 4 ) == 0 )
+			{
+				vector<unsigned char> data( ulLength );
+				if
+				(
+					ulLength > m_ulMaxChunk ||
+					!ReadAt( pFile, ullPos + 8, data.size(), data.data() )
+				)
+				{
+					break;
+				}
+
+				m_llChunk = (long long)ullPos;
+				m_ulChunk = ulLength;
+				m_Header.swap( data );
+				m_llHeader = (long long)ullPos + 8;
+				m_tTiff = 0;
+				m_tTiffSize = ulLength;
+				ParseTiff();
+				break;
+			}
+
+			ullPos += 12 + (unsigned long long)ulLength;
+		}
+	}
+
+	// public properties
+public:
+	// true when the file read is a PNG file
+	inline bool GetPng() const
+	{
+		return m_bPng;
+	}
+
+	// the offset of a PNG file's eXIf chunk (-1 if there is none)
+	inline long long GetChunk() const
+	{
+		return m_llChunk;
+	}
+
+	// the length of the data of a PNG file's eXIf chunk
+	inline unsigned long GetChunkLength() const
+	{
+		return m_ulChunk;
+	}
+
+	// the first bytes of the file which identify its format, which are
+	// kept after the header is released
+	inline const unsigned char* GetMagic() const
+	{
+		return m_Magic;
+	}
+
+	// the number of the first bytes of the file that were read
+	inline size_t GetMagicSize() const
+	{
+		return m_tMagic;
+	}
+
+	// the leading bytes of the file that were read (empty once the
+	// header is released)
+	inline const vector<unsigned char>& GetHeader() const
+	{
+		return m_Header;
+	}
+
+	// the EXIF data of a JPEG or PNG file found in the leading bytes
+	// (null if there is none or the header was released)
+	inline const unsigned char* GetExif() const
+	{
+		return m_tTiffSize == 0 ? nullptr : m_Header.data() + m_tTiff;
+	}
+
+	// the number of bytes of EXIF data found in the leading bytes
+	inline size_t GetExifSize() const
+	{
+		return m_tTiffSize;
+	}
+
+	// the date values found in the EXIF header
+	inline const vector<EXIF_DATE>& GetDates() const
+	{
+		return m_Dates;
+	}
+
+	// find the date value of the given tag or return null
+	inline const EXIF_DATE* Find( unsigned short usTag ) const
+	{
+		for ( const EXIF_DATE& date : m_Dates )
+		{
+			if ( date.m_usTag == usTag )
+			{
+				return &date;
+			}
+		}
+		return nullptr;
+	}
+
+	// the value of the given tag or an empty string if it is missing
+	inline const char* GetValue( unsigned short usTag ) const
+	{
+		const EXIF_DATE* pDate = Find( usTag );
+		return pDate == nullptr ? "" : pDate->m_szValue;
+	}
+
+	// true if both the original and digitized dates were found with
+	// room for a "YYYY:MM:DD HH:MM:SS" value and its terminating NUL
+	inline bool GetComplete() const
+	{
+		const EXIF_DATE* pOriginal = Find( ttDTOrig );
+		const EXIF_DATE* pDigitized = Find( ttDTDigitized );
+		return
+			pOriginal != nullptr && pOriginal->m_ulCount >= 20 &&
+			pDigitized != nullptr && pDigitized->m_ulCount >= 20;
+	}
+
+	// public methods
+public:
+	// move to an offset of a file which may be beyond 2 GB
+	static inline bool Seek( FILE* pFile, long long llOffset )
+	{
+#ifdef _WIN32
+		return _fseeki64( pFile, llOffset, SEEK_SET ) == 0;
+#else
+		return fseeko( pFile, (off_t)llOffset, SEEK_SET ) == 0;
+#endif
+	}
+
+	// open the given JPEG, PNG or TIFF based file and read its leading
+	// bytes up to the EXIF segment, the eXIf chunk or the directories of
+	// a TIFF file. Returns false if the file cannot be opened or is none
+	// of these, otherwise the dates found (if any) are available from the
+	// properties.
+	bool Read( const char* pcszPath )
+	{
+		m_Header.clear();
+		m_Dates.clear();
+		m_tTiff = 0;
+		m_tTiffSize = 0;
+		m_bBig = false;
+		m_llHeader = 0;
+		m_bPng = false;
+		m_llChunk = -1;
+		m_ulChunk = 0;
+		m_tMagic = 0;
+
+		FILE* pFile = fopen( pcszPath, "rb" );
+		if ( pFile == nullptr )
+		{
+			return false;
+		}
+
+		// the first block read holds the bytes that identify the format
+		Fill( pFile, sizeof( m_Magic ) );
+		m_tMagic = min( m_Header.size(), sizeof( m_Magic ) );
+		if ( m_tMagic > 0 )
+		{
+			memcpy( m_Magic, m_Header.data(), m_tMagic );
+		}
+
+		// a PNG file starts with its signature
+		static const unsigned char signature[ 8 ] =
+		{
+			0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'
+		};
+		if ( Fill( pFile, 8 ) && memcmp( m_Header.data(), signature, 8 ) == 0 )
+		{
+			ReadPng( pFile );
+			fclose( pFile );
+			return true;
+		}
+
+		// a TIFF file starts with its byte order
+		if
+		(
+			Fill( pFile, 2 ) &&
+			(
+				( m_Header[ 0 ] == 'I' && m_Header[ 1 ] == 'I' ) ||
+				( m_Header[ 0 ] == 'M' && m_Header[ 1 ] == 'M' )
+			)
+		)
+		{
+			const bool value = ReadTiff( pFile );
+			fclose( pFile );
+			return value;
+		}
+
+		// a JPEG file starts with the start of image marker
+		if
+		(
+			!Fill( pFile, 2 ) ||
+			m_Header[ 0 ] != jmMarker || m_Header[ 1 ] != jmSOI
+		)
+		{
+			fclose( pFile );
+			return false;
+		}
+
+		size_t tPos = 2;
+		while ( Fill( pFile, tPos + 1 ) && m_Header[ tPos ] == jmMarker )
+		{
+			// markers may be preceded by any number of fill bytes
+			while ( Fill( pFile, tPos + 2 ) && m_Header[ tPos + 1 ] == jmMarker )
+			{
+				tPos++;
+			}
+			if ( !Fill( pFile, tPos + 2 ) )
+			{
+				break;
+			}
+
+			const unsigned char ucMarker = m_Header[ tPos + 1 ];
+			tPos += 2;
+
+			if ( ucMarker == jmSOS || ucMarker == jmEOI )
+			{
+				break;
+			}
+
+			// stand alone markers do not have a length
+			if ( ucMarker == jmTEM || ( ucMarker >= jmRST0 && ucMarker <= jmRST7 ) )
+			{
+				continue;
+			}
+
+			// the length includes the two bytes of the length
+			if ( !Fill( pFile, tPos + 2 ) )
+			{
+				break;
+			}
+			const size_t tLength = m_Header[ tPos ] << 8 | m_Header[ tPos + 1 ];
+			if ( tLength < 2 )
+			{
+				break;
+			}
+
+			// the EXIF identifier is followed by the TIFF header which
+			// all IFD offsets are relative to
+			if ( ucMarker == jmAPP1 && tLength > 2 + 6 + 8 )
+			{
+				if ( !Fill( pFile, tPos + tLength ) )
+				{
+					break;
+				}
+
+				if ( memcmp( m_Header.data() + tPos + 2, "Exif\0\0", 6 ) == 0 )
+				{
+					m_tTiff = tPos + 2 + 6;
+					m_tTiffSize = tLength - 2 - 6;
+					ParseTiff();
+					break;
+				}
+			}
+
+			tPos += tLength;
+		}
+
+		fclose( pFile );
+		return true;
+	}
+
+	// free the leading bytes once the dates have been read, keeping the
+	// dates for a later patch
+	void Release()
+	{
+		vector<unsigned char>().swap( m_Header );
+		m_llHeader = 0;
+		m_tTiff = 0;
+		m_tTiffSize = 0;
+	}
+
+	// public construction
+public:
+	CExifReader()
+	{
+		m_bIntel = true;
+		m_bBig = false;
+		m_llHeader = 0;
+		m_bPng = false;
+		m_llChunk = -1;
+		m_ulChunk = 0;
+		m_tTiff = 0;
+		m_tTiffSize = 0;
+		m_tMagic = 0;
+	}
+};
+
+/////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,241 @@
+/////////////////////////////////////////////////////////////////////////////
+// Copyright  by W. T. Block, all rights reserved
+/////////////////////////////////////////////////////////////////////////////
+#pragma once
+#include "PathView.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/////////////////////////////////////////////////////////////////////////////
+// this class decides which files are images and what kind of image they
+// are. A file name's extension is looked up in a perfect hash table that
+// is built when the program is compiled: the extension is packed into a
+// number, a multiplier that gives every known extension its own slot is
+// searched for by the compiler, and a lookup is one multiply and one
+// compare. Only files whose extension names an image are considered,
+// so the other files of a folder are never opened. The first bytes of
+// those files, which the header reader fetches anyway, are then 
+// compared with the signatures of the formats so an image named as a
+// different kind of image is treated as what it is and a file that is
+// not an image is rejected before it is opened as one.
+class CFileClassifier
+{
+	// public definitions
+public:
+	typedef enum
+	{
+		fkNone = 0,				// not an image we handle
+		fkJpeg = fkNone + 1,	// JPEG (EXIF in an APP1 segment)
+		fkPng = fkJpeg + 1,		// PNG (EXIF in an eXIf chunk)
+		fkGif = fkPng + 1,		// GIF (GDI+ only)
+		fkBmp = fkGif + 1,		// BMP (GDI+ only)
+		fkTiff = fkBmp + 1,		// TIFF
+		fkRaw = fkTiff + 1,		// raw formats built on TIFF (native only)
+	} FILE_KIND;
+
+	// protected definitions
+protected:
+	// an extension packed into a number with its kind
+	typedef struct tagExtension
+	{
+		uint32_t m_ulKey;
+		FILE_KIND m_eKind;
+
+	} EXTENSION;
+
+	// the slots of the hash table (a power of 2)
+	static const int m_nBits = 5;
+	static const size_t m_tSlots = (size_t)1 << m_nBits;
+
+	// the hash table and the multiplier that spreads the keys over it
+	typedef struct tagTable
+	{
+		uint32_t m_ulMultiplier;
+		EXTENSION m_Slots[ m_tSlots ];
+
+	} TABLE;
+
+	// protected methods
+protected:
+	// pack an extension of up to four letters or digits without its dot
+	// into a number ignoring case, or zero if it cannot be an image's
+	static constexpr uint32_t GetKey( const char* pcszExt, size_t tLength )
+	{
+		if ( tLength > 0 && pcszExt[ 0 ] == '.' )
+		{
+			pcszExt++;
+			tLength--;
+		}
+		if ( tLength == 0 || tLength > 4 )
+		{
+			return 0;
+		}
+
+		uint32_t value = 0;
+		for ( size_t tChar = 0; tChar < tLength; tChar++ )
+		{
+			char cValue = pcszExt[ tChar ];
+			if ( cValue >= 'A' && cValue <= 'Z' )
+			{
+				cValue = (char)( cValue - 'A' + 'a' );
+			}
+			if ( !( cValue >= 'a' && cValue <= 'z' ) && !( cValue >= '0' && cValue <= '9' ) )
+			{
+				return 0;
+			}
+			value |= (uint32_t)(unsigned char)cValue << ( 8 * tChar );
+		}
+		return value;
+	}
+
+	// the slot of a key for a multiplier
+	static constexpr size_t GetSlot( uint32_t ulKey, uint32_t ulMultiplier )
+	{
+		return (size_t)( (uint32_t)( ulKey * ulMultiplier ) >> ( 32 - m_nBits ) );
+	}
+
+	// build the table by trying odd multipliers until every extension
+	// has a slot of its own (the multiplier is zero if none is found)
+	static constexpr TABLE BuildTable()
+	{
+		constexpr EXTENSION extensions[] =
+		{
+			{ GetKey( "jpg", 3 ), fkJpeg },
+			{ GetKey( "jpeg", 4 ), fkJpeg },
+			{ GetKey( "png", 3 ), fkPng },
+			{ GetKey( "gif", 3 ), fkGif },
+			{ GetKey( "bmp", 3 ), fkBmp },
+			{ GetKey( "tif", 3 ), fkTiff },
+			{ GetKey( "tiff", 4 ), fkTiff },
+			{ GetKey( "dng", 3 ), fkRaw },
+			{ GetKey( "cr2", 3 ), fkRaw },
+			{ GetKey( "nef", 3 ), fkRaw },
+			{ GetKey( "arw", 3 ), fkRaw },
+		};
+
+		for ( uint32_t ulTry = 0; ulTry < 100000; ulTry++ )
+		{
+			const uint32_t ulMultiplier = 0x9E3779B1u + 2 * ulTry;
+			TABLE candidate = {};
+			bool bPerfect = true;
+			for ( const EXTENSION& extension : extensions )
+			{
+				EXTENSION& slot =
+					candidate.m_Slots[ GetSlot( extension.m_ulKey, ulMultiplier ) ];
+				if ( slot.m_ulKey != 0 )
+				{
+					bPerfect = false;
+					break;
+				}
+				slot = extension;
+			}
+			if ( bPerfect )
+			{
+				candidate.m_ulMultiplier = ulMultiplier;
+				return candidate;
+			}
+		}
+		return TABLE {};
+	}
+
+	// the table which is built by the compiler
+	static const TABLE& GetTable()
+	{
+		static constexpr TABLE table = BuildTable();
+		static_assert( table.m_ulMultiplier != 0, "no perfect hash of the extensions" );
+		return table;
+	}
+
+	// public methods
+public:
+	// the kind of image a file extension (with or without its dot) of 
+	// the given length names
+	static FILE_KIND GetKind( const char* pcszExt, size_t tLength )
+	{
+		const uint32_t ulKey = GetKey( pcszExt, tLength );
+		const TABLE& table = GetTable();
+		const EXTENSION& slot = table.m_Slots[ GetSlot( ulKey, table.m_ulMultiplier ) ];
+		return ulKey != 0 && slot.m_ulKey == ulKey ? slot.m_eKind : fkNone;
+	}
+
+	// the kind of image a file extension (with or without its dot) names
+	static FILE_KIND GetKind( const char* pcszExt )
+	{
+		return GetKind( pcszExt, strlen( pcszExt ) );
+	}
+
+	// the kind of image a pathname names by its extension
+	static FILE_KIND GetPathKind( const CPathView& path )
+	{
+		const string_view ext = path.GetExtension();
+		return ext.empty() ? fkNone : GetKind( ext.data(), ext.length() );
+	}
+
+	// the kind of image the leading bytes of a file are the signature of
+	static FILE_KIND Sniff( const unsigned char* pData, size_t tSize )
+	{
+		static const unsigned char png[ 8 ] =
+		{
+			0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'
+		};
+
+		if ( tSize >= 3 && pData[ 0 ] == 0xFF && pData[ 1 ] == 0xD8 && pData[ 2 ] == 0xFF )
+		{
+			return fkJpeg;
+		}
+		if ( tSize >= 8 && memcmp( pData, png, 8 ) == 0 )
+		{
+			return fkPng;
+		}
+		if
+		(
+			tSize >= 6 &&
+			( memcmp( pData, "GIF87a", 6 ) == 0 || memcmp( pData, "GIF89a", 6 ) == 0 )
+		)
+		{
+			return fkGif;
+		}
+		if ( tSize >= 14 && pData[ 0 ] == 'B' && pData[ 1 ] == 'M' )
+		{
+			return fkBmp;
+		}
+
+		// classic and big TIFF in either byte order
+		if
+		(
+			tSize >= 4 &&
+			(
+				( pData[ 0 ] == 'I' && pData[ 1 ] == 'I' &&
+				  ( pData[ 2 ] == 42 || pData[ 2 ] == 43 ) && pData[ 3 ] == 0 ) ||
+				( pData[ 0 ] == 'M' && pData[ 1 ] == 'M' && pData[ 2 ] == 0 &&
+				  ( pData[ 3 ] == 42 || pData[ 3 ] == 43 ) )
+			)
+		)
+		{
+			// Canon marks its raw files after the TIFF header
+			if ( tSize >= 10 && pData[ 8 ] == 'C' && pData[ 9 ] == 'R' )
+			{
+				return fkRaw;
+			}
+			return fkTiff;
+		}
+
+		return fkNone;
+	}
+
+	// the kind of image a file is from the kind its name gives and its
+	// leading bytes. The other raw formats are plain TIFF files that
+	// only their names tell apart.
+	static FILE_KIND Classify( FILE_KIND eNamed, const unsigned char* pData, size_t tSize )
+	{
+		const FILE_KIND eFound = Sniff( pData, tSize );
+		if ( eFound == fkTiff && eNamed == fkRaw )
+		{
+			return fkRaw;
+		}
+		return eFound;
+	}
+};
+
+/////////////////////////////////////////////////////////////////////////////
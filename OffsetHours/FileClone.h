@@ -0,0 +1,225 @@
+/////////////////////////////////////////////////////////////////////////////
+// Copyright  by W. T. Block, all rights reserved
+/////////////////////////////////////////////////////////////////////////////
+#pragma once
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+	#ifdef __linux__
+		#include <linux/fs.h>
+		#include <sys/ioctl.h>
+		#include <sys/sendfile.h>
+	#endif
+#endif
+
+using namespace std;
+
+/////////////////////////////////////////////////////////////////////////////
+// this class copies files and ranges of files while keeping their bytes
+// out of the process wherever the platform allows. On Linux a whole file
+// is cloned with FICLONE, which shares the original's extents on copy on
+// write file systems (Btrfs, XFS) so only the blocks that are patched
+// afterwards are ever written. Where cloning is not supported the kernel
+// copies the data with copy_file_range or else sendfile, and only when
+// both fail is the data read and written through a buffer. On Windows
+// CopyFile is used, which clones the blocks itself on ReFS.
+class CFileClone
+{
+	// protected data
+protected:
+	// the size of the buffer of the last resort copy
+	static const size_t m_tBlock = 1024 * 1024;
+
+#ifndef _WIN32
+	// protected methods
+protected:
+	// copy a number of bytes from an offset of one file to the current
+	// position of another
+	static bool CopyData( int nSource, long long llOffset, int nTarget, long long llSize )
+	{
+		off_t offset = (off_t)llOffset;
+#ifdef __linux__
+		while ( llSize > 0 )
+		{
+			const ssize_t nCopied = copy_file_range
+			(
+				nSource, &offset, nTarget, nullptr, (size_t)llSize, 0
+			);
+			if ( nCopied <= 0 )
+			{
+				break;
+			}
+			llSize -= nCopied;
+		}
+
+		while ( llSize > 0 )
+		{
+			const ssize_t nCopied = sendfile( nTarget, nSource, &offset, (size_t)llSize );
+			if ( nCopied <= 0 )
+			{
+				break;
+			}
+			llSize -= nCopied;
+		}
+#endif
+
+		static thread_local vector<char> buffer( m_tBlock );
+		while ( llSize > 0 )
+		{
+			const size_t tWant = (size_t)min( llSize, (long long)m_tBlock );
+			const ssize_t nRead = pread( nSource, buffer.data(), tWant, offset );
+			if ( nRead <= 0 )
+			{
+				return false;
+			}
+
+			for ( ssize_t nWritten = 0; nWritten < nRead; )
+			{
+				const ssize_t nWrite =
+					write( nTarget, buffer.data() + nWritten, (size_t)( nRead - nWritten ) );
+				if ( nWrite <= 0 )
+				{
+					return false;
+				}
+				nWritten += nWrite;
+			}
+
+			offset += nRead;
+			llSize -= nRead;
+		}
+
+		return true;
+	}
+#endif
+
+	// public methods
+public:
+	// copy a whole file to the target which is replaced if it exists,
+	// returning false if the file cannot be copied
+	static bool Clone( const char* pcszSource, const char* pcszTarget )
+	{
+#ifdef _WIN32
+		return CopyFileA( pcszSource, pcszTarget, FALSE ) != FALSE;
+#else
+		return Clone( pcszSource, AT_FDCWD, pcszTarget );
+#endif
+	}
+
+#ifndef _WIN32
+	// copy a whole file to the target named relative to an open folder
+	// which saves resolving the folder's path for every file written to
+	// it, returning false if the file cannot be copied
+	static bool Clone( const char* pcszSource, int nFolder, const char* pcszTarget )
+	{
+		const int nSource = open( pcszSource, O_RDONLY );
+		if ( nSource < 0 )
+		{
+			return false;
+		}
+
+		struct stat status;
+		if ( fstat( nSource, &status ) != 0 )
+		{
+			close( nSource );
+			return false;
+		}
+
+		const int nTarget = openat
+		(
+			nFolder, pcszTarget, O_WRONLY | O_CREAT | O_TRUNC, status.st_mode & 0777
+		);
+		if ( nTarget < 0 )
+		{
+			close( nSource );
+			return false;
+		}
+
+		bool value = false;
+#ifdef FICLONE
+		value = ioctl( nTarget, FICLONE, nSource ) == 0;
+#endif
+		if ( !value )
+		{
+			value = CopyData( nSource, 0, nTarget, (long long)status.st_size );
+		}
+
+		close( nSource );
+		if ( close( nTarget ) != 0 )
+		{
+			value = false;
+		}
+		if ( !value )
+		{
+			unlinkat( nFolder, pcszTarget, 0 );
+		}
+
+		return value;
+	}
+#endif
+
+	// copy a range of one open file to the end of another (to the end of
+	// the source when the size is negative)
+	static bool CopyRange
+	(
+		FILE* pSource, long long llOffset, FILE* pTarget, long long llSize
+	)
+	{
+#ifdef _WIN32
+		if ( _fseeki64( pSource, llOffset, SEEK_SET ) != 0 )
+		{
+			return false;
+		}
+
+		static thread_local vector<char> buffer( m_tBlock );
+		while ( llSize != 0 )
+		{
+			const size_t tWant = llSize < 0 || llSize > (long long)m_tBlock ?
+				m_tBlock : (size_t)llSize;
+			const size_t tRead = fread( buffer.data(), 1, tWant, pSource );
+			if ( tRead == 0 )
+			{
+				return llSize < 0;
+			}
+			if ( fwrite( buffer.data(), 1, tRead, pTarget ) != tRead )
+			{
+				return false;
+			}
+			if ( llSize > 0 )
+			{
+				llSize -= (long long)tRead;
+			}
+		}
+
+		return true;
+#else
+		// what the target's stream holds goes first
+		if ( fflush( pTarget ) != 0 )
+		{
+			return false;
+		}
+
+		const int nSource = fileno( pSource );
+		if ( llSize < 0 )
+		{
+			struct stat status;
+			if ( fstat( nSource, &status ) != 0 )
+			{
+				return false;
+			}
+			llSize = max( (long long)status.st_size - llOffset, 0LL );
+		}
+
+		// the stream continues where the copy ended
+		const bool value = CopyData( nSource, llOffset, fileno( pTarget ), llSize );
+		return fseeko( pTarget, 0, SEEK_END ) == 0 && value;
+#endif
+	}
+};
+
+/////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,192 @@
+/////////////////////////////////////////////////////////////////////////////
+// Copyright  by W. T. Block, all rights reserved
+/////////////////////////////////////////////////////////////////////////////
+#pragma once
+#include <stdio.h>
+#include <string>
+#ifdef _WIN32
+	#include <windows.h>
+	#include <io.h>
+#else
+	#include <fcntl.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+using namespace std;
+
+/////////////////////////////////////////////////////////////////////////////
+// this class makes the changes to a file durable. A file is replaced by
+// writing its new contents to a temporary file beside it, flushing that
+// to the disk, giving it the permissions, owner and times of the file it
+// replaces and renaming it over the file, so a crash at any moment
+// leaves either the old or the new file and never a mixture of both.
+class CFileCommit
+{
+#ifndef _WIN32
+	// protected methods
+protected:
+	// flush the folder holding a file so a rename into it is durable
+	static bool FlushFolder( const char* pcszPath )
+	{
+		const string csPath( pcszPath );
+		const size_t tSeparator = csPath.find_last_of( '/' );
+		const string csFolder =
+			tSeparator == string::npos ? string( "." ) :
+			tSeparator == 0 ? string( "/" ) : csPath.substr( 0, tSeparator );
+
+		const int nFolder = open( csFolder.c_str(), O_RDONLY );
+		if ( nFolder < 0 )
+		{
+			return false;
+		}
+		const bool value = fsync( nFolder ) == 0;
+		return close( nFolder ) == 0 && value;
+	}
+#endif
+
+	// public methods
+public:
+	// the temporary file a file's new contents are written to
+	static inline string GetTempPath( const char* pcszPath )
+	{
+		return string( pcszPath ) + ".OffsetHours.tmp";
+	}
+
+	// replace one file with another in a single step
+	static bool Rename( const char* pcszFrom, const char* pcszTo )
+	{
+#ifdef _WIN32
+		return ::MoveFileExA
+		(
+			pcszFrom, pcszTo, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH
+		) != FALSE;
+#else
+		return rename( pcszFrom, pcszTo ) == 0;
+#endif
+	}
+
+	// flush an open file to the disk
+	static bool Commit( FILE* pFile )
+	{
+		if ( fflush( pFile ) != 0 )
+		{
+			return false;
+		}
+#ifdef _WIN32
+		return _commit( _fileno( pFile ) ) == 0;
+#else
+		return fsync( fileno( pFile ) ) == 0;
+#endif
+	}
+
+	// flush a file that was written by someone else to the disk
+	static bool Flush( const char* pcszPath )
+	{
+#ifdef _WIN32
+		const HANDLE hFile = CreateFileA
+		(
+			pcszPath, GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+			OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr
+		);
+		if ( hFile == INVALID_HANDLE_VALUE )
+		{
+			return false;
+		}
+		const bool value = FlushFileBuffers( hFile ) != FALSE;
+		return CloseHandle( hFile ) != FALSE && value;
+#else
+		const int nFile = open( pcszPath, O_RDONLY );
+		if ( nFile < 0 )
+		{
+			return false;
+		}
+		const bool value = fsync( nFile ) == 0;
+		return close( nFile ) == 0 && value;
+#endif
+	}
+
+	// give the target the permissions, owner and access and write times
+	// of the source, or its attributes and times on Windows, which are
+	// what a file loses when it is replaced by a new one. The owner can
+	// only be given by a privileged user so it is left alone otherwise.
+	// Extended attributes and access control lists are not copied.
+	static bool CopyMetadata( const char* pcszSource, const char* pcszTarget )
+	{
+#ifdef _WIN32
+		WIN32_FILE_ATTRIBUTE_DATA data;
+		if ( !GetFileAttributesExA( pcszSource, GetFileExInfoStandard, &data ) )
+		{
+			return false;
+		}
+
+		const HANDLE hFile = CreateFileA
+		(
+			pcszTarget, FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ, nullptr,
+			OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr
+		);
+		if ( hFile == INVALID_HANDLE_VALUE )
+		{
+			return false;
+		}
+		bool value = SetFileTime
+		(
+			hFile, &data.ftCreationTime, &data.ftLastAccessTime,
+			&data.ftLastWriteTime
+		) != FALSE;
+		value = CloseHandle( hFile ) != FALSE && value;
+
+		return
+			value &&
+			SetFileAttributesA( pcszTarget, data.dwFileAttributes ) != FALSE;
+#else
+		struct stat status;
+		if ( stat( pcszSource, &status ) != 0 )
+		{
+			return false;
+		}
+
+		struct stat target;
+		if
+		(
+			stat( pcszTarget, &target ) == 0 &&
+			( target.st_uid != status.st_uid || target.st_gid != status.st_gid ) &&
+			chown( pcszTarget, status.st_uid, status.st_gid ) != 0 &&
+			geteuid() == 0
+		)
+		{
+			return false;
+		}
+
+		const struct timespec times[ 2 ] = { status.st_atim, status.st_mtim };
+		return
+			chmod( pcszTarget, status.st_mode & 07777 ) == 0 &&
+			utimensat( AT_FDCWD, pcszTarget, times, 0 ) == 0;
+#endif
+	}
+
+	// replace a file with the temporary file holding its new contents,
+	// which is removed if it cannot be renamed over the file
+	static bool Replace( const char* pcszTemp, const char* pcszPath )
+	{
+		if
+		(
+			!Flush( pcszTemp ) ||
+			!CopyMetadata( pcszPath, pcszTemp ) ||
+			!Rename( pcszTemp, pcszPath )
+		)
+		{
+			remove( pcszTemp );
+			return false;
+		}
+
+#ifdef _WIN32
+		// the rename was written through to the disk
+		return true;
+#else
+		return FlushFolder( pcszPath );
+#endif
+	}
+};
+
+/////////////////////////////////////////////////////////////////////////////
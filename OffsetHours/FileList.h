@@ -0,0 +1,176 @@
+/////////////////////////////////////////////////////////////////////////////
+// Copyright  by W. T. Block, all rights reserved
+/////////////////////////////////////////////////////////////////////////////
+#pragma once
+#include "PathView.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+#ifdef _WIN32
+	#include <io.h>
+#else
+	#include <unistd.h>
+#endif
+
+using namespace std;
+
+/////////////////////////////////////////////////////////////////////////////
+// this class streams a list of pathnames from a file or the standard 
+// input to a callback as the list is read, so the files of a list that
+// another program is still writing start to be processed right away: the
+// list is read with read() rather than a stream, which returns whatever
+// a pipe holds instead of waiting for a whole block. The pathnames are
+// separated by line breaks, or by NUL characters when the first read that
+// holds a separator has one (the output of "find -print0"), which allows
+// any character but NUL in a name. Blank lines are skipped and a carriage
+// return before a line break is dropped.
+class CFileList
+{
+	// public definitions
+public:
+	// called for each pathname of the list with a view that is only good
+	// during the call
+	typedef function<void( const CPathView& path )> PATH_CALLBACK;
+
+	// protected definitions
+protected:
+	// the most bytes of each read of the list
+	static const size_t m_tBlock = 64 * 1024;
+
+	// protected methods
+protected:
+	// read the bytes the list holds so far, up to the size of the buffer,
+	// returning the number read, zero at the end of the list or -1 if it
+	// cannot be read
+	static long long ReadBlock( int nFile, char* pBuffer, size_t tSize )
+	{
+		while ( true )
+		{
+#ifdef _WIN32
+			const long long llRead = _read( nFile, pBuffer, (unsigned)tSize );
+#else
+			const long long llRead = read( nFile, pBuffer, tSize );
+#endif
+			if ( llRead >= 0 || errno != EINTR )
+			{
+				return llRead;
+			}
+		}
+	}
+
+	// hand a pathname without its separator to the callback
+	static void Add( string_view path, bool bLines, PATH_CALLBACK& callback )
+	{
+		if ( bLines && !path.empty() && path.back() == '\r' )
+		{
+			path.remove_suffix( 1 );
+		}
+		if ( !path.empty() )
+		{
+			callback( CPathView( path ) );
+		}
+	}
+
+	// public methods
+public:
+	// true if the list is read from the standard input
+	static inline bool GetStandardInput( const char* pcszPath )
+	{
+		return strcmp( pcszPath, "-" ) == 0;
+	}
+
+	// stream the pathnames of the list ("-" for the standard input) to 
+	// the callback, returning false if the list cannot be opened or read
+	static bool Read( const char* pcszPath, PATH_CALLBACK callback )
+	{
+		const bool bStandard = GetStandardInput( pcszPath );
+#ifdef _WIN32
+		const int nFile =
+			bStandard ? _fileno( stdin ) : _open( pcszPath, _O_RDONLY | _O_BINARY );
+#else
+		const int nFile =
+			bStandard ? STDIN_FILENO : open( pcszPath, O_RDONLY | O_CLOEXEC );
+#endif
+		if ( nFile < 0 )
+		{
+			return false;
+		}
+#ifdef _WIN32
+		// NUL characters and carriage returns are part of the list
+		if ( bStandard )
+		{
+			_setmode( nFile, _O_BINARY );
+		}
+#endif
+
+		// a pathname split by the end of a read is carried to the next
+		string csCarry;
+		vector<char> buffer( m_tBlock );
+		bool bLines = true;
+		bool bKnown = false;
+		long long llRead = 0;
+		while ( ( llRead = ReadBlock( nFile, buffer.data(), buffer.size() ) ) > 0 )
+		{
+			const char* pStart = buffer.data();
+			const char* pEnd = pStart + llRead;
+
+			// the separator is not known until a read holds one
+			if ( !bKnown )
+			{
+				const bool bNul = memchr( pStart, 0, (size_t)llRead ) != nullptr;
+				if ( !bNul && memchr( pStart, '\n', (size_t)llRead ) == nullptr )
+				{
+					csCarry.append( pStart, pEnd );
+					continue;
+				}
+				bLines = !bNul;
+				bKnown = true;
+			}
+			const char cSeparator = bLines ? '\n' : '\0';
+
+			while ( pStart < pEnd )
+			{
+				const char* pBreak =
+					(const char*)memchr( pStart, cSeparator, pEnd - pStart );
+				if ( pBreak == nullptr )
+				{
+					csCarry.append( pStart, pEnd );
+					break;
+				}
+
+				// most pathnames are handed over from the buffer itself
+				if ( csCarry.empty() )
+				{
+					Add( string_view( pStart, pBreak - pStart ), bLines, callback );
+
+				} else
+				{
+					csCarry.append( pStart, pBreak );
+					Add( csCarry, bLines, callback );
+					csCarry.clear();
+				}
+				pStart = pBreak + 1;
+			}
+		}
+
+		// the last pathname may not end with a separator
+		Add( csCarry, bLines, callback );
+
+		if ( !bStandard )
+		{
+#ifdef _WIN32
+			_close( nFile );
+#else
+			close( nFile );
+#endif
+		}
+		return llRead == 0;
+	}
+};
+
+/////////////////////////////////////////////////////////////////////////////
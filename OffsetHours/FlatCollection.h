@@ -0,0 +1,344 @@
+/////////////////////////////////////////////////////////////////////////////
+// Copyright  by W. T. Block, all rights reserved
+/////////////////////////////////////////////////////////////////////////////
+#pragma once
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+/////////////////////////////////////////////////////////////////////////////
+// how the keys of a CFlatCollection are ordered and looked up. A key is
+// compared through its view so a collection of string keys can be
+// searched with a string_view or a literal without building a key. The
+// default view is the key itself; other key types can specialize this
+// class the way std::string does below.
+template<class KEY>
+class CKeyTraits
+{
+	// public definitions
+public:
+	// what the keys are compared as
+	typedef KEY VIEW;
+
+	// public methods
+public:
+	// the view of a key
+	static inline const KEY& GetView( const KEY& key )
+	{
+		return key;
+	}
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// strings are compared as views of their characters
+template<>
+class CKeyTraits<string>
+{
+	// public definitions
+public:
+	// what the keys are compared as
+	typedef string_view VIEW;
+
+	// public methods
+public:
+	// the view of a key
+	static inline VIEW GetView( const string& key )
+	{
+		return VIEW( key );
+	}
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// this template class has the interface of CKeyedCollection but keeps its
+// items by value in a vector sorted by key instead of keeping pointers to
+// items allocated one at a time in a tree. A lookup is one binary search
+// over contiguous memory, adding a key greater than the last one is an
+// append, and the differences of two collections are found by a single
+// merge of their sorted items so comparing large snapshots is linear.
+// The pointers returned by find are only good until the collection is
+// next changed.
+template<class KEY, class TYPE, class TRAITS = CKeyTraits<KEY>>
+class CFlatCollection
+{
+	// public definitions
+public:
+	// pair of key and item
+	typedef pair<KEY, TYPE> PAIR_KEY_VALUE;
+
+	// the items in the order of their keys
+	typedef vector<PAIR_KEY_VALUE> ITEMS;
+
+	// what the keys are compared as
+	typedef typename TRAITS::VIEW VIEW;
+
+	// protected data
+protected:
+	// the items in the order of their keys
+	ITEMS m_Items;
+
+	// protected methods
+protected:
+	// the view of a key or of anything that converts to a view
+	template<class K>
+	static inline VIEW GetView( const K& key )
+	{
+		if constexpr ( is_same<K, KEY>::value )
+		{
+			return TRAITS::GetView( key );
+		} else
+		{
+			return VIEW( key );
+		}
+	}
+
+	// the first item whose key is not less than the view
+	typename ITEMS::const_iterator LowerBound( const VIEW& view ) const
+	{
+		return lower_bound
+		(
+			m_Items.begin(), m_Items.end(), view,
+			[]( const PAIR_KEY_VALUE& item, const VIEW& value )
+			{
+				return TRAITS::GetView( item.first ) < value;
+			}
+		);
+	}
+
+	// the position of the item with the view's key or -1
+	template<class K>
+	ptrdiff_t GetIndex( const K& key ) const
+	{
+		const VIEW view = GetView( key );
+		const auto pos = LowerBound( view );
+		if ( pos == m_Items.end() || view < TRAITS::GetView( pos->first ) )
+		{
+			return -1;
+		}
+		return pos - m_Items.begin();
+	}
+
+	// append the items of one sorted collection whose keys are missing
+	// from another sorted collection
+	static void AddMissing
+	(
+		const CFlatCollection& from, const CFlatCollection& other,
+		CFlatCollection& missing
+	)
+	{
+		ITEMS items;
+		auto pos = other.m_Items.begin();
+		const auto end = other.m_Items.end();
+		for ( const PAIR_KEY_VALUE& item : from.m_Items )
+		{
+			const VIEW view = TRAITS::GetView( item.first );
+			while ( pos != end && TRAITS::GetView( pos->first ) < view )
+			{
+				++pos;
+			}
+			if ( pos == end || view < TRAITS::GetView( pos->first ) )
+			{
+				items.push_back( item );
+			}
+		}
+
+		if ( missing.m_Items.empty() )
+		{
+			missing.m_Items.swap( items );
+			return;
+		}
+
+		for ( PAIR_KEY_VALUE& item : items )
+		{
+			missing.add( item.first, move( item.second ) );
+		}
+	}
+
+	// methods
+public:
+	// number of Items
+	inline int count() const
+	{
+		return (int)m_Items.size();
+	}
+
+	// clear all Items from the collection
+	void clear()
+	{
+		m_Items.clear();
+	}
+
+	// make room for a number of items
+	void reserve( size_t tItems )
+	{
+		m_Items.reserve( tItems );
+	}
+
+	// does the key exist in the collection?
+	template<class K>
+	bool exists( const K& key ) const
+	{
+		return GetIndex( key ) >= 0;
+	}
+
+	// find a key in the collection
+	template<class K>
+	TYPE* find( const K& key )
+	{
+		const ptrdiff_t nIndex = GetIndex( key );
+		return nIndex < 0 ? nullptr : &m_Items[ nIndex ].second;
+	}
+
+	// find a key in the collection
+	template<class K>
+	const TYPE* find( const K& key ) const
+	{
+		const ptrdiff_t nIndex = GetIndex( key );
+		return nIndex < 0 ? nullptr : &m_Items[ nIndex ].second;
+	}
+
+	// copy the item of a key with a single search, returning false if
+	// the key does not exist
+	template<class K>
+	bool try_find( const K& key, TYPE& value ) const
+	{
+		const TYPE* pValue = find( key );
+		if ( pValue == nullptr )
+		{
+			return false;
+		}
+		value = *pValue;
+		return true;
+	}
+
+	// remove a key from the collection
+	template<class K>
+	bool remove( const K& key )
+	{
+		const ptrdiff_t nIndex = GetIndex( key );
+		if ( nIndex < 0 )
+		{
+			return false;
+		}
+		m_Items.erase( m_Items.begin() + nIndex );
+		return true;
+	}
+
+	// add a key to the collection and return false if it already exists
+	bool add( const KEY& key, TYPE value )
+	{
+		// keys that arrive in order are appended
+		const VIEW view = TRAITS::GetView( key );
+		if ( m_Items.empty() || TRAITS::GetView( m_Items.back().first ) < view )
+		{
+			m_Items.emplace_back( key, move( value ) );
+			return true;
+		}
+
+		const auto pos = LowerBound( view );
+		if ( pos != m_Items.end() && !( view < TRAITS::GetView( pos->first ) ) )
+		{
+			return false;
+		}
+		m_Items.emplace( pos, key, move( value ) );
+		return true;
+	}
+
+	// add a key with an item allocated by the caller which the collection
+	// takes over (the interface of CKeyedCollection)
+	bool add( const KEY& key, TYPE* value )
+	{
+		const bool bAdded = add( key, move( *value ) );
+		delete value;
+		return bAdded;
+	}
+
+	// replace the items with the given ones in any order, which sorts
+	// them once and keeps the first item of each key
+	void assign( ITEMS&& items )
+	{
+		m_Items = move( items );
+		stable_sort
+		(
+			m_Items.begin(), m_Items.end(),
+			[]( const PAIR_KEY_VALUE& left, const PAIR_KEY_VALUE& right )
+			{
+				return TRAITS::GetView( left.first ) < TRAITS::GetView( right.first );
+			}
+		);
+		m_Items.erase
+		(
+			unique
+			(
+				m_Items.begin(), m_Items.end(),
+				[]( const PAIR_KEY_VALUE& left, const PAIR_KEY_VALUE& right )
+				{
+					return !( TRAITS::GetView( left.first ) < TRAITS::GetView( right.first ) );
+				}
+			),
+			m_Items.end()
+		);
+	}
+
+	// public properties
+public:
+	// the items in the order of their keys
+	inline const ITEMS& GetItems() const
+	{
+		return m_Items;
+	}
+
+	// does the key exist in the collection?
+	inline bool GetExists( const KEY& key ) const
+	{
+		return GetIndex( key ) >= 0;
+	}
+
+#ifdef _MSC_VER
+	// the items in the order of their keys
+	__declspec( property( get = GetItems ) )
+		ITEMS Items;
+
+	// number of Items
+	__declspec( property( get = count ) )
+		int Count;
+
+	// does the key exist in the collection?
+	__declspec( property( get = GetExists ) )
+		bool Exists[];
+#endif
+
+	// public methods
+public:
+	// get deleted items returns the items of before whose keys are
+	// missing from after
+	static bool GetDeletedItems
+	(
+		const CFlatCollection& before,
+		const CFlatCollection& after,
+		CFlatCollection& deleted
+	)
+	{
+		AddMissing( before, after, deleted );
+		return deleted.count() > 0;
+	}
+
+	// get new items returns the items of after whose keys are missing
+	// from before
+	static bool GetNewItems
+	(
+		const CFlatCollection& before,
+		const CFlatCollection& after,
+		CFlatCollection& added
+	)
+	{
+		AddMissing( after, before, added );
+		return added.count() > 0;
+	}
+};
+
+/////////////////////////////////////////////////////////////////////////////
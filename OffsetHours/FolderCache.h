@@ -0,0 +1,254 @@
+/////////////////////////////////////////////////////////////////////////////
+// Copyright  by W. T. Block, all rights reserved
+/////////////////////////////////////////////////////////////////////////////
+#pragma once
+#include <errno.h>
+#include <stdio.h>
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+using namespace std;
+
+/////////////////////////////////////////////////////////////////////////////
+// this class remembers the output folders that have been created so each
+// one costs a single trip to the file system however many files are
+// written to it, which matters most on network shares where every look
+// at a path is a round trip. The folders are looked up under a shared
+// lock so the writers only contend when a folder is seen for the first
+// time. On POSIX systems a handle of each folder is held, up to a limit,
+// so the files in it can be opened with openat without resolving the
+// folder's path again.
+class CFolderCache
+{
+	// public definitions
+public:
+	// create a folder along with any missing parents, returning true if
+	// the folder is created or already exists
+	typedef function<bool( const string& csFolder )> CREATE_CALLBACK;
+
+	// protected definitions
+protected:
+	// a folder that is known to exist
+	typedef struct tagFolder
+	{
+		// the open handle of the folder or -1 if none is held
+		int m_nHandle;
+
+	} FOLDER;
+
+	// protected data
+protected:
+	// protects the folders
+	shared_mutex m_Lock;
+
+	// the folders known to exist by pathname
+	unordered_map<string, FOLDER> m_Folders;
+
+	// the number of folder handles being held
+	size_t m_tHandles;
+
+	// the most folder handles that are held at one time
+	size_t m_tMaxHandles;
+
+	// creates the folders that are not known yet
+	CREATE_CALLBACK m_Create;
+
+	// public properties
+public:
+	// the number of folders known to exist
+	inline size_t GetSize()
+	{
+		shared_lock<shared_mutex> lock( m_Lock );
+		return m_Folders.size();
+	}
+
+	// the most folder handles that are held at one time
+	inline void SetMaxHandles( size_t value )
+	{
+		m_tMaxHandles = value;
+	}
+
+	// creates the folders that are not known yet (CreateFolder when
+	// not set)
+	inline void SetCreate( CREATE_CALLBACK value )
+	{
+		m_Create = value;
+	}
+
+	// public methods
+public:
+	// create a folder along with any missing parents, returning true if
+	// the folder is created or already exists
+	static bool CreateFolder( const string& csFolder )
+	{
+		if ( csFolder.empty() )
+		{
+			return false;
+		}
+
+#ifdef _WIN32
+		if ( CreateDirectoryA( csFolder.c_str(), nullptr ) )
+		{
+			return true;
+		}
+		DWORD dwError = GetLastError();
+		if ( dwError == ERROR_ALREADY_EXISTS )
+		{
+			return true;
+		}
+#else
+		if ( mkdir( csFolder.c_str(), 0777 ) == 0 || errno == EEXIST )
+		{
+			return true;
+		}
+		const int nError = errno;
+#endif
+
+		// create the parent first and try again
+#ifdef _WIN32
+		const size_t tSeparator = csFolder.find_last_of( "\\/" );
+#else
+		const size_t tSeparator = csFolder.find_last_of( '/' );
+#endif
+		if
+		(
+#ifdef _WIN32
+			dwError != ERROR_PATH_NOT_FOUND ||
+#else
+			nError != ENOENT ||
+#endif
+			tSeparator == string::npos || tSeparator == 0 ||
+			!CreateFolder( csFolder.substr( 0, tSeparator ) )
+		)
+		{
+			return false;
+		}
+
+#ifdef _WIN32
+		return
+			CreateDirectoryA( csFolder.c_str(), nullptr ) ||
+			GetLastError() == ERROR_ALREADY_EXISTS;
+#else
+		return mkdir( csFolder.c_str(), 0777 ) == 0 || errno == EEXIST;
+#endif
+	}
+
+#ifndef _WIN32
+	// open a file named relative to a folder's handle for reading and
+	// writing, returning null if it cannot be opened
+	static FILE* OpenFile( int nFolder, const char* pcszName )
+	{
+		const int nFile = openat( nFolder, pcszName, O_RDWR | O_CLOEXEC );
+		if ( nFile < 0 )
+		{
+			return nullptr;
+		}
+
+		FILE* pFile = fdopen( nFile, "r+b" );
+		if ( pFile == nullptr )
+		{
+			close( nFile );
+		}
+		return pFile;
+	}
+#endif
+
+	// make sure a folder exists, creating it the first time it is seen,
+	// and return the handle held for it or -1 if none is held, returning
+	// false if the folder cannot be created
+	bool Ensure( const string& csFolder, int& nHandle )
+	{
+		{
+			shared_lock<shared_mutex> lock( m_Lock );
+			auto pos = m_Folders.find( csFolder );
+			if ( pos != m_Folders.end() )
+			{
+				nHandle = pos->second.m_nHandle;
+				return true;
+			}
+		}
+
+		// creating a folder that exists is harmless so two writers that
+		// see a new folder at once can both create it
+		const bool bCreated = m_Create ? m_Create( csFolder ) : CreateFolder( csFolder );
+		if ( !bCreated )
+		{
+			return false;
+		}
+
+		unique_lock<shared_mutex> lock( m_Lock );
+		auto pos = m_Folders.find( csFolder );
+		if ( pos == m_Folders.end() )
+		{
+			FOLDER folder;
+			folder.m_nHandle = -1;
+#ifndef _WIN32
+			if ( m_tHandles < m_tMaxHandles )
+			{
+				folder.m_nHandle =
+					open( csFolder.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC );
+			}
+			if ( folder.m_nHandle >= 0 )
+			{
+				m_tHandles++;
+			}
+#endif
+			pos = m_Folders.emplace( csFolder, folder ).first;
+		}
+
+		nHandle = pos->second.m_nHandle;
+		return true;
+	}
+
+	// make sure a folder exists, creating it the first time it is seen
+	bool Ensure( const string& csFolder )
+	{
+		int nHandle = -1;
+		return Ensure( csFolder, nHandle );
+	}
+
+	// forget the folders and close their handles once the files in them
+	// are no longer being written
+	void Clear()
+	{
+		unique_lock<shared_mutex> lock( m_Lock );
+#ifndef _WIN32
+		for ( auto& pair : m_Folders )
+		{
+			if ( pair.second.m_nHandle >= 0 )
+			{
+				close( pair.second.m_nHandle );
+			}
+		}
+#endif
+		m_Folders.clear();
+		m_tHandles = 0;
+	}
+
+	// public construction
+public:
+	// handles are held for the first 256 folders which leaves most of
+	// the process's file descriptors to the files being processed
+	CFolderCache( size_t tMaxHandles = 256 )
+	{
+		m_tHandles = 0;
+		m_tMaxHandles = tMaxHandles;
+	}
+
+	~CFolderCache()
+	{
+		Clear();
+	}
+};
+
+/////////////////////////////////////////////////////////////////////////////
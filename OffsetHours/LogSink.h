@@ -0,0 +1,212 @@
+/////////////////////////////////////////////////////////////////////////////
+// Copyright  by W. T. Block, all rights reserved
+/////////////////////////////////////////////////////////////////////////////
+#pragma once
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/////////////////////////////////////////////////////////////////////////////
+// this class collects the output of every thread into one large block
+// and writes the block to the stream when it fills, so a run over a
+// million files makes a few hundred writes instead of several writes
+// per file. Producers only hold the lock long enough to copy their text
+// into the block, and the full block is written outside of that lock in
+// the order it was filled.
+class CLogSink
+{
+	// public definitions
+public:
+	// how much is written
+	typedef enum
+	{
+		lvQuiet = 0,			// nothing is written
+		lvSummary = 1,			// only the totals of the run
+		lvFile = 2,				// a record for every file
+	} VERBOSITY;
+
+	// protected data
+protected:
+	// the stream the blocks are written to
+	FILE* m_pStream;
+
+	// the level of detail written
+	VERBOSITY m_eVerbosity;
+
+	// the size a block reaches before it is written
+	size_t m_tBlock;
+
+	// protects the block being filled and the spare blocks
+	mutex m_Lock;
+
+	// serializes the writes of full blocks so they stay in order
+	mutex m_FlushLock;
+
+	// the block being filled
+	string m_Block;
+
+	// written blocks kept for reuse so the memory is allocated once
+	vector<string> m_Spares;
+
+	// protected methods
+protected:
+	// take the block being filled and replace it with a spare, then
+	// write it once the blocks taken before it have been written. The
+	// lock must be held by the caller and is released.
+	void Flush( unique_lock<mutex>& lock )
+	{
+		string block;
+		block.swap( m_Block );
+		if ( !m_Spares.empty() )
+		{
+			m_Block.swap( m_Spares.back() );
+			m_Spares.pop_back();
+		}
+		m_Block.reserve( m_tBlock );
+
+		// taking the flush lock before releasing the block lock keeps
+		// the blocks in the order they were filled
+		unique_lock<mutex> flush( m_FlushLock );
+		lock.unlock();
+
+		if ( m_pStream != nullptr )
+		{
+			if ( !block.empty() )
+			{
+				fwrite( block.data(), 1, block.size(), m_pStream );
+			}
+			fflush( m_pStream );
+		}
+		flush.unlock();
+
+		block.clear();
+		lock.lock();
+		m_Spares.push_back( move( block ) );
+		lock.unlock();
+	}
+
+	// public properties
+public:
+	// the stream the blocks are written to
+	inline FILE* GetStream() const
+	{
+		return m_pStream;
+	}
+	// the stream the blocks are written to (flush before changing it)
+	inline void SetStream( FILE* value )
+	{
+		m_pStream = value;
+	}
+
+	// the level of detail written
+	inline VERBOSITY GetVerbosity() const
+	{
+		return m_eVerbosity;
+	}
+	// the level of detail written
+	inline void SetVerbosity( VERBOSITY value )
+	{
+		m_eVerbosity = value;
+	}
+
+	// true if text of the given level is written
+	inline bool GetEnabled( VERBOSITY eLevel ) const
+	{
+		return eLevel != lvQuiet && eLevel <= m_eVerbosity;
+	}
+
+	// the size a block reaches before it is written
+	inline void SetBlockSize( size_t value )
+	{
+		lock_guard<mutex> lock( m_Lock );
+		m_tBlock = value;
+		m_Block.reserve( m_tBlock );
+	}
+
+	// public methods
+public:
+	// add text of the given level to the block, writing the block if
+	// it is full
+	void Write( VERBOSITY eLevel, const char* pcszText, size_t tLength )
+	{
+		if ( !GetEnabled( eLevel ) || tLength == 0 )
+		{
+			return;
+		}
+
+		unique_lock<mutex> lock( m_Lock );
+		m_Block.append( pcszText, tLength );
+		if ( m_Block.size() >= m_tBlock )
+		{
+			Flush( lock );
+		}
+	}
+
+	// add a null terminated string of the given level to the block
+	inline void Write( VERBOSITY eLevel, const char* pcszText )
+	{
+		Write( eLevel, pcszText, strlen( pcszText ) );
+	}
+
+	// format text of the given level into a buffer owned by the calling
+	// thread, which is reused from call to call, and add it to the block
+	void Format( VERBOSITY eLevel, const char* pcszFormat, ... )
+	{
+		if ( !GetEnabled( eLevel ) )
+		{
+			return;
+		}
+
+		static thread_local vector<char> buffer( 256 );
+
+		va_list args;
+		va_start( args, pcszFormat );
+		int nLength =
+			vsnprintf( buffer.data(), buffer.size(), pcszFormat, args );
+		va_end( args );
+
+		// grow the buffer once if the text did not fit
+		if ( nLength >= (int)buffer.size() )
+		{
+			buffer.resize( (size_t)nLength + 1 );
+			va_start( args, pcszFormat );
+			nLength =
+				vsnprintf( buffer.data(), buffer.size(), pcszFormat, args );
+			va_end( args );
+		}
+
+		if ( nLength > 0 )
+		{
+			Write( eLevel, buffer.data(), (size_t)nLength );
+		}
+	}
+
+	// write everything in the block to the stream
+	void Flush()
+	{
+		unique_lock<mutex> lock( m_Lock );
+		Flush( lock );
+	}
+
+	// public construction / destruction
+public:
+	// blocks of 256K are written to the given stream
+	CLogSink( FILE* pStream = stdout )
+	{
+		m_pStream = pStream;
+		m_eVerbosity = lvFile;
+		m_tBlock = 256 * 1024;
+		m_Block.reserve( m_tBlock );
+	}
+	~CLogSink()
+	{
+		Flush();
+	}
+};
+
+/////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,573 @@
+/////////////////////////////////////////////////////////////////////////////
+// Copyright  by W. T. Block, all rights reserved
+/////////////////////////////////////////////////////////////////////////////
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "TraceLog.h"
+#if defined( _MSC_VER )
+	#include <intrin.h>
+#endif
+
+using namespace std;
+
+/////////////////////////////////////////////////////////////////////////////
+// a latency histogram with buckets that grow on a log scale like an HDR
+// histogram: values below 16 have their own bucket and every power of 2
+// above that is split into 16 linear buckets, so any value is recorded
+// within about 6% using under a thousand counters. Each histogram is only
+// written by the thread that owns it, so the counters are relaxed atomics
+// which cost the same as plain integers but may be read by a report
+// while the run is going.
+class CLatencyHistogram
+{
+	// public definitions
+public:
+	// the number of buckets needed for 64 bit values
+	static const int m_nBuckets = 61 * 16;
+
+	// protected data
+protected:
+	// the number of values in each bucket
+	atomic<uint64_t> m_ullBuckets[ m_nBuckets ];
+
+	// the number of values recorded
+	atomic<uint64_t> m_ullCount;
+
+	// the sum of the values recorded
+	atomic<uint64_t> m_ullTotal;
+
+	// the largest value recorded
+	atomic<uint64_t> m_ullMax;
+
+	// protected methods
+protected:
+	// the position of the highest bit set (the value is not zero)
+	static inline int GetHighBit( uint64_t ullValue )
+	{
+#if defined( _MSC_VER )
+		unsigned long ulBit = 0;
+		_BitScanReverse64( &ulBit, ullValue );
+		return (int)ulBit;
+#else
+		return 63 - __builtin_clzll( ullValue );
+#endif
+	}
+
+	// add to a counter owned by the calling thread
+	static inline void Add( atomic<uint64_t>& counter, uint64_t ullValue )
+	{
+		counter.store
+		(
+			counter.load( memory_order_relaxed ) + ullValue,
+			memory_order_relaxed
+		);
+	}
+
+	// public methods
+public:
+	// the bucket a value is counted in
+	static inline int GetBucket( uint64_t ullValue )
+	{
+		if ( ullValue < 16 )
+		{
+			return (int)ullValue;
+		}
+
+		const int nBit = GetHighBit( ullValue );
+		return ( nBit - 3 ) * 16 + (int)( ( ullValue >> ( nBit - 4 ) ) & 15 );
+	}
+
+	// the smallest value counted in a bucket
+	static inline uint64_t GetLowest( int nBucket )
+	{
+		if ( nBucket < 16 )
+		{
+			return (uint64_t)nBucket;
+		}
+
+		const int nBit = nBucket / 16 + 3;
+		return (uint64_t)( 16 + nBucket % 16 ) << ( nBit - 4 );
+	}
+
+	// count a value (only called by the thread that owns the histogram)
+	inline void Record( uint64_t ullValue )
+	{
+		Add( m_ullBuckets[ GetBucket( ullValue ) ], 1 );
+		Add( m_ullCount, 1 );
+		Add( m_ullTotal, ullValue );
+		if ( ullValue > m_ullMax.load( memory_order_relaxed ) )
+		{
+			m_ullMax.store( ullValue, memory_order_relaxed );
+		}
+	}
+
+	// add the counts of another histogram to this one
+	void Merge( const CLatencyHistogram& other )
+	{
+		for ( int nBucket = 0; nBucket < m_nBuckets; nBucket++ )
+		{
+			Add( m_ullBuckets[ nBucket ], other.GetCount( nBucket ) );
+		}
+		Add( m_ullCount, other.GetCount() );
+		Add( m_ullTotal, other.GetTotal() );
+		if ( other.GetMax() > GetMax() )
+		{
+			m_ullMax.store( other.GetMax(), memory_order_relaxed );
+		}
+	}
+
+	// the number of values in a bucket
+	inline uint64_t GetCount( int nBucket ) const
+	{
+		return m_ullBuckets[ nBucket ].load( memory_order_relaxed );
+	}
+
+	// the number of values recorded
+	inline uint64_t GetCount() const
+	{
+		return m_ullCount.load( memory_order_relaxed );
+	}
+
+	// the sum of the values recorded
+	inline uint64_t GetTotal() const
+	{
+		return m_ullTotal.load( memory_order_relaxed );
+	}
+
+	// the largest value recorded
+	inline uint64_t GetMax() const
+	{
+		return m_ullMax.load( memory_order_relaxed );
+	}
+
+	// the value below which the given fraction (0..1) of the values fall
+	uint64_t GetPercentile( double dFraction ) const
+	{
+		const uint64_t ullCount = GetCount();
+		if ( ullCount == 0 )
+		{
+			return 0;
+		}
+
+		uint64_t ullRank = (uint64_t)( dFraction * (double)ullCount + 0.5 );
+		if ( ullRank < 1 )
+		{
+			ullRank = 1;
+		}
+
+		uint64_t ullSeen = 0;
+		for ( int nBucket = 0; nBucket < m_nBuckets; nBucket++ )
+		{
+			ullSeen += GetCount( nBucket );
+			if ( ullSeen >= ullRank )
+			{
+				// report the top of the bucket but never more than the max
+				const uint64_t value = nBucket + 1 < m_nBuckets ?
+					GetLowest( nBucket + 1 ) - 1 : GetMax();
+				return value < GetMax() ? value : GetMax();
+			}
+		}
+
+		return GetMax();
+	}
+
+	// public construction
+public:
+	CLatencyHistogram()
+	{
+		for ( int nBucket = 0; nBucket < m_nBuckets; nBucket++ )
+		{
+			m_ullBuckets[ nBucket ] = 0;
+		}
+		m_ullCount = 0;
+		m_ullTotal = 0;
+		m_ullMax = 0;
+	}
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// this class collects the latency of the hot spots of a run with a
+// histogram for each probe on each thread, so recording a value never
+// takes a lock or shares a cache line with another thread. A report
+// merges the threads' histograms and can be made at the end of the run
+// or while it is going.
+class CMetrics
+{
+	// public definitions
+public:
+	// the points of the run that are timed
+	typedef enum
+	{
+		mpEnumerate = 0,		// enumerate one folder
+		mpReadHeader,			// read the EXIF header of a JPEG file
+		mpFromFile,				// open an image with GDI+
+		mpProperty,				// read a date property with GDI+
+		mpParse,				// parse a date taken into a CDate
+		mpCreatePath,			// create a corrected folder
+		mpPatch,				// copy a JPEG file and patch its dates
+		mpSave,					// save an image with GDI+
+		mpRead,					// the read stage of one file
+		mpShift,				// the offset stage of one file
+		mpWrite,				// the write stage of one file
+		mpProbes
+	} PROBE;
+
+	// protected definitions
+protected:
+	// the measurements of one thread
+	typedef struct tagThreadData
+	{
+		// the latency of each probe in nanoseconds
+		CLatencyHistogram m_Histograms[ mpProbes ];
+
+		// the slowest item of each probe (a folder or file) which is
+		// protected by the lock because a report may read it
+		mutex m_Lock;
+		string m_csSlowest[ mpProbes ];
+
+	} THREAD_DATA;
+
+	// protected data
+protected:
+	// false to skip the histograms
+	bool m_bEnabled;
+
+	// the timeline the probes are also recorded in (may be null)
+	CTraceLog* m_pTrace;
+
+	// protects the list of threads
+	mutex m_Lock;
+
+	// the data of every thread that has recorded a value
+	vector<unique_ptr<THREAD_DATA>> m_Threads;
+
+	// identifies this collection to the per-thread cache
+	uint64_t m_ullInstance;
+
+	// protected methods
+protected:
+	// the data of the calling thread which is created the first time
+	// the thread records a value (the cache holds one collection, which
+	// is all a run uses)
+	THREAD_DATA* GetThreadData()
+	{
+		typedef struct tagCache
+		{
+			uint64_t m_ullInstance;
+			THREAD_DATA* m_pData;
+		} CACHE;
+		static thread_local CACHE cache = { 0, nullptr };
+
+		if ( cache.m_ullInstance != m_ullInstance )
+		{
+			lock_guard<mutex> lock( m_Lock );
+			m_Threads.push_back( unique_ptr<THREAD_DATA>( new THREAD_DATA ) );
+			cache.m_pData = m_Threads.back().get();
+			cache.m_ullInstance = m_ullInstance;
+		}
+
+		return cache.m_pData;
+	}
+
+	// public properties
+public:
+	// false to skip the histograms
+	inline bool GetEnabled() const
+	{
+		return m_bEnabled;
+	}
+	// false to skip the histograms
+	inline void SetEnabled( bool value )
+	{
+		m_bEnabled = value;
+	}
+
+	// the timeline the probes are also recorded in (may be null)
+	inline CTraceLog* GetTrace() const
+	{
+		return m_pTrace;
+	}
+	// the timeline the probes are also recorded in (may be null)
+	inline void SetTrace( CTraceLog* value )
+	{
+		m_pTrace = value;
+	}
+
+	// false to skip the clock entirely
+	inline bool GetActive() const
+	{
+		return m_bEnabled || m_pTrace != nullptr;
+	}
+
+	// the name of a probe
+	static inline const char* GetName( PROBE eProbe )
+	{
+		static const char* names[ mpProbes ] =
+		{
+			"enumerate", "read header", "from file", "property",
+			"parse", "create path", "patch", "save", "read", "shift", "write"
+		};
+		return names[ eProbe ];
+	}
+
+	// the number of threads that have recorded values
+	inline size_t GetThreads()
+	{
+		lock_guard<mutex> lock( m_Lock );
+		return m_Threads.size();
+	}
+
+	// public methods
+public:
+	// record the latency of a probe on the calling thread along with the
+	// item being processed (which may be null)
+	void Record( PROBE eProbe, uint64_t ullNanoseconds, const char* pcszItem )
+	{
+		THREAD_DATA* pData = GetThreadData();
+		CLatencyHistogram& histogram = pData->m_Histograms[ eProbe ];
+		const bool bSlowest = ullNanoseconds > histogram.GetMax();
+		histogram.Record( ullNanoseconds );
+
+		if ( bSlowest && pcszItem != nullptr )
+		{
+			lock_guard<mutex> lock( pData->m_Lock );
+			pData->m_csSlowest[ eProbe ] = pcszItem;
+		}
+	}
+
+	// the histogram of a probe merged across the threads along with the
+	// slowest item recorded
+	void GetTotals( PROBE eProbe, CLatencyHistogram& histogram, string& csSlowest )
+	{
+		uint64_t ullSlowest = 0;
+		lock_guard<mutex> lock( m_Lock );
+		for ( const unique_ptr<THREAD_DATA>& pData : m_Threads )
+		{
+			const CLatencyHistogram& thread = pData->m_Histograms[ eProbe ];
+			histogram.Merge( thread );
+			if ( thread.GetMax() >= ullSlowest )
+			{
+				ullSlowest = thread.GetMax();
+				lock_guard<mutex> slowest( pData->m_Lock );
+				csSlowest = pData->m_csSlowest[ eProbe ];
+			}
+		}
+	}
+
+	// write a table of the probes which have been recorded
+	void WriteTable( string& csTable )
+	{
+		char szLine[ 512 ];
+		snprintf
+		(
+			szLine, sizeof( szLine ),
+			"%-12s %10s %10s %10s %10s %10s %10s %10s\n",
+			"probe", "count", "total ms", "mean us", "p50 us", "p90 us",
+			"p99 us", "max us"
+		);
+		csTable += szLine;
+
+		for ( int nProbe = 0; nProbe < mpProbes; nProbe++ )
+		{
+			const PROBE eProbe = (PROBE)nProbe;
+			CLatencyHistogram histogram;
+			string csSlowest;
+			GetTotals( eProbe, histogram, csSlowest );
+			const uint64_t ullCount = histogram.GetCount();
+			if ( ullCount == 0 )
+			{
+				continue;
+			}
+
+			snprintf
+			(
+				szLine, sizeof( szLine ),
+				"%-12s %10llu %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+				GetName( eProbe ),
+				(unsigned long long)ullCount,
+				histogram.GetTotal() / 1e6,
+				histogram.GetTotal() / 1e3 / ullCount,
+				histogram.GetPercentile( 0.50 ) / 1e3,
+				histogram.GetPercentile( 0.90 ) / 1e3,
+				histogram.GetPercentile( 0.99 ) / 1e3,
+				histogram.GetMax() / 1e3
+			);
+			csTable += szLine;
+
+			if ( !csSlowest.empty() )
+			{
+				csTable += "             slowest: " + csSlowest + "\n";
+			}
+		}
+	}
+
+	// write the totals and the non-empty buckets of every probe as JSON
+	// (the latencies are in nanoseconds and each bucket is a pair of its
+	// lowest value and its count)
+	void WriteJson( string& csJson )
+	{
+		char szValue[ 256 ];
+		snprintf
+		(
+			szValue, sizeof( szValue ), "{\n  \"threads\": %zu,\n  \"probes\": [",
+			GetThreads()
+		);
+		csJson += szValue;
+
+		for ( int nProbe = 0; nProbe < mpProbes; nProbe++ )
+		{
+			const PROBE eProbe = (PROBE)nProbe;
+			CLatencyHistogram histogram;
+			string csSlowest;
+			GetTotals( eProbe, histogram, csSlowest );
+
+			snprintf
+			(
+				szValue, sizeof( szValue ),
+				"%s\n    {\"name\": \"%s\", \"count\": %llu, \"total_ns\": %llu, "
+				"\"max_ns\": %llu, \"p50_ns\": %llu, \"p90_ns\": %llu, "
+				"\"p99_ns\": %llu,\n     \"slowest\": \"",
+				nProbe == 0 ? "" : ",",
+				GetName( eProbe ),
+				(unsigned long long)histogram.GetCount(),
+				(unsigned long long)histogram.GetTotal(),
+				(unsigned long long)histogram.GetMax(),
+				(unsigned long long)histogram.GetPercentile( 0.50 ),
+				(unsigned long long)histogram.GetPercentile( 0.90 ),
+				(unsigned long long)histogram.GetPercentile( 0.99 )
+			);
+			csJson += szValue;
+
+			// escape the item for a JSON string
+			for ( const char cValue : csSlowest )
+			{
+				if ( cValue == '"' || cValue == '\\' )
+				{
+					csJson += '\\';
+					csJson += cValue;
+
+				} else if ( (unsigned char)cValue < 0x20 )
+				{
+					snprintf( szValue, sizeof( szValue ), "\\u%04x", cValue );
+					csJson += szValue;
+
+				} else
+				{
+					csJson += cValue;
+				}
+			}
+			csJson += "\",\n     \"buckets\": [";
+
+			bool bFirst = true;
+			for ( int nBucket = 0; nBucket < CLatencyHistogram::m_nBuckets; nBucket++ )
+			{
+				const uint64_t ullCount = histogram.GetCount( nBucket );
+				if ( ullCount == 0 )
+				{
+					continue;
+				}
+
+				snprintf
+				(
+					szValue, sizeof( szValue ), "%s[%llu, %llu]",
+					bFirst ? "" : ", ",
+					(unsigned long long)CLatencyHistogram::GetLowest( nBucket ),
+					(unsigned long long)ullCount
+				);
+				csJson += szValue;
+				bFirst = false;
+			}
+			csJson += "]}";
+		}
+
+		csJson += "\n  ]\n}\n";
+	}
+
+	// public construction
+public:
+	CMetrics()
+	{
+		static atomic<uint64_t> ullInstances( 0 );
+		m_ullInstance = ++ullInstances;
+		m_bEnabled = false;
+		m_pTrace = nullptr;
+	}
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// times the scope it is declared in and records the latency with the
+// given probe when it goes out of scope, and the step in the timeline when
+// there is one, doing nothing at all when the metrics are missing or
+// neither is wanted
+class CMetricTimer
+{
+	// protected data
+protected:
+	// where the latency is recorded (null when disabled)
+	CMetrics* m_pMetrics;
+
+	// the probe being timed
+	CMetrics::PROBE m_eProbe;
+
+	// the folder or file being timed (may be null)
+	const char* m_pcszItem;
+
+	// when the scope began
+	chrono::steady_clock::time_point m_tStart;
+
+	// public construction / destruction
+public:
+	CMetricTimer
+	(
+		CMetrics* pMetrics, CMetrics::PROBE eProbe, const char* pcszItem = nullptr
+	)
+	{
+		m_pMetrics =
+			pMetrics != nullptr && pMetrics->GetActive() ? pMetrics : nullptr;
+		m_eProbe = eProbe;
+		m_pcszItem = pcszItem;
+		if ( m_pMetrics != nullptr )
+		{
+			m_tStart = chrono::steady_clock::now();
+		}
+	}
+	~CMetricTimer()
+	{
+		if ( m_pMetrics == nullptr )
+		{
+			return;
+		}
+
+		const auto tEnd = chrono::steady_clock::now();
+		if ( m_pMetrics->GetEnabled() )
+		{
+			m_pMetrics->Record
+			(
+				m_eProbe,
+				(uint64_t)chrono::duration_cast<chrono::nanoseconds>
+				(
+					tEnd - m_tStart
+				).count(),
+				m_pcszItem
+			);
+		}
+
+		CTraceLog* pTrace = m_pMetrics->GetTrace();
+		if ( pTrace != nullptr )
+		{
+			pTrace->Step
+			(
+				CMetrics::GetName( m_eProbe ), m_tStart, tEnd, m_pcszItem
+			);
+		}
+	}
+};
+
+/////////////////////////////////////////////////////////////////////////////
@@ -5,6 +5,14 @@
 #include "stdafx.h"
 #include "OffsetHours.h"
 #include "CHelper.h"
+#include "ExifReader.h"
+#include "ExifPatcher.h"
+#include "FileCommit.h"
+#include "DirectoryWalker.h"
+#include "FileList.h"
+#include "Pipeline.h"
+#include "PathView.h"
+#include <signal.h>
 
 #ifdef _DEBUG
 #define new DEBUG_NEW
@@ -80,7 +88,9 @@ int FindTextMonthIndex( vector<CString>& tokens )
 // character (hex 20).
 void CDate::SetDateTaken( CString csDate )
 {
-	// reset the m_Date to undefined state
+	CMetricTimer timer( &m_Metrics, CMetrics::mpParse );
+
+	// reset the date to undefined state
 	Year = -1;
 	Month = -1;
 	Day = -1;
@@ -89,7 +99,17 @@ void CDate::SetDateTaken( CString csDate )
 	Second = 0;
 	bool value = Okay;
 
-	// parse the date into a vector of string tokens
+	// the canonical "YYYY:MM:DD HH:MM:SS" layout is parsed in place 
+	// without tokenizing or allocating
+	DATE_FIELDS fields;
+	if ( CExifDate::Parse( csDate, csDate.GetLength(), fields ) )
+	{
+		Fields = fields;
+		value = Okay;
+		return;
+	}
+
+	// parse the nonstandard date into a vector of string tokens
 	const CString csDelim( _T( ": " ) );
 	int nStart = 0;
 	vector<CString> tokens;
@@ -168,40 +188,86 @@ void CDate::SetDateTaken( CString csDate )
 } // SetDateTaken
 
 /////////////////////////////////////////////////////////////////////////////
-// get the current date taken, if any, from the given filename
-// which should be in the format "YYYY:MM:DD HH:MM:SS"
-CString GetCurrentDateTaken( LPCTSTR lpszPathName )
+// get the current date taken, if any, from the context's file
+// which should be in the format "YYYY:MM:DD HH:MM:SS". JPEG and TIFF 
+// based files only have their EXIF header or TIFF directories read into 
+// the context's reader; other files are opened by GDI+ and the image is
+// kept in the context so the write step does not need to open the file a
+// second time. The context's date is 
+// used to validate the values.
+CString GetCurrentDateTaken( FILE_CONTEXT& context )
 {
 	USES_CONVERSION;
 
 	CString value;
+	CString csOriginal;
+	CString csDigitized;
 
-	// smart pointer to the image representing this file
-	// (smart pointer release their resources when they
-	// go out of context)
-	unique_ptr<Gdiplus::Image> pImage =
-		unique_ptr<Gdiplus::Image>
-		(
-			Gdiplus::Image::FromFile( T2CW( lpszPathName ) )
+	// read the dates from the JPEG header or the TIFF directories 
+	// without building an image
+	CExifReader& reader = context.m_Reader;
+	bool bNative = false;
+	{
+		CMetricTimer timer
+		( 
+			&m_Metrics, CMetrics::mpReadHeader, context.m_csPath 
 		);
+		bNative = reader.Read( context.m_csPath );
+	}
+
+	// the first bytes of the file tell what it really is whatever its
+	// name says
+	context.m_eKind = CFileClassifier::Classify
+	( 
+		context.m_eKind, reader.GetMagic(), reader.GetMagicSize() 
+	);
+
+	if ( bNative )
+	{
+		csOriginal = reader.GetValue( CExifReader::ttDTOrig );
+		csDigitized = reader.GetValue( CExifReader::ttDTDigitized );
+
+	} else if ( context.m_eKind != CFileClassifier::fkNone )
+	{
+		// let GDI+ read the properties of other formats
 
-	// test the date properties stored in the given image
-	const CString csOriginal =
-		GetStringProperty( pImage.get(), PropertyTagExifDTOrig );
-	const CString csDigitized =
-		GetStringProperty( pImage.get(), PropertyTagExifDTDigitized );
+		// smart pointer to the image representing this file
+		// (smart pointer release their resources when they
+		// go out of context)
+		unique_ptr<Gdiplus::Image>& pImage = context.m_pImage;
+		{
+			CMetricTimer timer
+			( 
+				&m_Metrics, CMetrics::mpFromFile, context.m_csPath 
+			);
+			pImage = unique_ptr<Gdiplus::Image>
+			(
+				Gdiplus::Image::FromFile( T2CW( context.m_csPath ) )
+			);
+		}
+
+		// test the date properties stored in the given image
+		CMetricTimer timer
+		( 
+			&m_Metrics, CMetrics::mpProperty, context.m_csPath 
+		);
+		csOriginal = GetStringProperty( pImage.get(), PropertyTagExifDTOrig );
+		csDigitized = 
+			GetStringProperty( pImage.get(), PropertyTagExifDTDigitized );
+	}
 
 	// officially the original property is the date taken in this
 	// format: "YYYY:MM:DD HH:MM:SS"
-	m_Date.DateTaken = csOriginal;
-	if ( m_Date.Okay )
+	CDate& date = context.m_Date;
+	date.DateTaken = csOriginal;
+	if ( date.Okay )
 	{
 		value = csOriginal;
 
 	} else // alternately use the date digitized
 	{
-		m_Date.DateTaken = csDigitized;
-		if ( m_Date.Okay )
+		date.DateTaken = csDigitized;
+		if ( date.Okay )
 		{
 			value = csDigitized;
 		}
@@ -211,12 +277,35 @@ CString GetCurrentDateTaken( LPCTSTR lpszPathName )
 } // GetCurrentDateTaken
 
 /////////////////////////////////////////////////////////////////////////////
-// Save the data inside pImage to the given lpszPathName
-bool Save( LPCTSTR lpszPathName, Gdiplus::Image* pImage )
+// build the pathname the new version of the given image is written to,
+// which is a temporary file beside the image when it is corrected in 
+// place or the image's pathname inside of the corrected folder otherwise,
+// creating the corrected folder the first time it is seen, and return 
+// false if the folder cannot be created
+bool GetOutputPath( LPCTSTR lpszPathName, bool bInPlace, CString& csPath )
 {
-	USES_CONVERSION;
+	string csOutput;
+	if 
+	( 
+		!CDateShifter::GetOutputPath
+		( 
+			m_CorrectedFolders, lpszPathName, bInPlace, csOutput 
+		) 
+	)
+	{
+		return false;
+	}
 
-	CString csExt = CHelper::GetExtension( lpszPathName );
+	csPath = csOutput.c_str();
+	return true;
+} // GetOutputPath
+
+/////////////////////////////////////////////////////////////////////////////
+// Save the image inside the context to the given path using the encoder 
+// with the given class ID
+bool Save( const FILE_CONTEXT& context, CLSID clsid, LPCTSTR lpszPath )
+{
+	USES_CONVERSION;
 
 	// save and overwrite the selected image file with current page
 	int iValue =
@@ -231,289 +320,1066 @@ bool Save( LPCTSTR lpszPathName, Gdiplus::Image* pImage )
 	param.Parameter[ 0 ].Type = EncoderParameterValueTypeLong;
 	param.Parameter[ 0 ].NumberOfValues = 1;
 
-	// writing to the same file will fail, so save to a corrected folder
-	// below the image being corrected
-	const CString csCorrected = GetCorrectedFolder();
-	const CString csFolder = CHelper::GetFolder( lpszPathName ) + csCorrected;
-	if ( !::PathFileExists( csFolder ) )
+	CMetricTimer timer( &m_Metrics, CMetrics::mpSave, context.m_csPath );
+	Status status = 
+		context.m_pImage->Save( T2CW( lpszPath ), &clsid, &param );
+	return status == Ok;
+} // Save
+
+/////////////////////////////////////////////////////////////////////////////
+// Save the context's JPEG, PNG or TIFF based file with the new date by 
+// the portable engine without decoding the image, and return false if 
+// the file needs GDI+ to create a missing date value
+bool SaveNative( const FILE_CONTEXT& context, bool bInPlace )
+{
+	const CExifReader& reader = context.m_Reader;
+	if ( !CDateShifter::GetNative( reader ) )
 	{
-		if ( !CreatePath( csFolder ) )
-		{
-			return false;
-		}
+		return false;
 	}
 
-	// filename plus extension
-	const CString csData = CHelper::GetDataName( lpszPathName );
-	const CString csPath = csFolder + _T( "\\" ) + csData;
-
-	CLSID clsid = m_Extension.ClassID;
-	Status status = pImage->Save( T2CW( csPath ), &clsid, &param );
-	return status == Ok;
-} // Save
+	CMetricTimer timer( &m_Metrics, CMetrics::mpPatch, context.m_csPath );
+	return CDateShifter::Save
+	( 
+		m_CorrectedFolders, context.m_csPath, reader, context.m_csDate, 
+		context.m_csOldDate, bInPlace 
+	);
+} // SaveNative
 
 /////////////////////////////////////////////////////////////////////////////
-// crawl through the given directory tree which may include wild cards
-void RecursePath( LPCTSTR path )
+// hand the output of a file that has left the pipeline to the log and 
+// release it
+void FinishFile( FILE_CONTEXT* pContext )
 {
-	USES_CONVERSION;
+	const CString& csLog = pContext->m_csLog;
+	m_Log.Write( CLogSink::lvFile, csLog, csLog.GetLength() );
 
-	// valid file extensions
-	const CString csValidExt = _T( ".jpg;.jpeg;.png;.gif;.bmp;.tif;.tiff" );
+	// add the file to the manifest of a dry run
+	if ( m_Plan.GetStream() != nullptr && pContext->m_pcszStatus != nullptr )
+	{
+		PLAN_ENTRY entry;
+		entry.m_csPath = pContext->m_csPath;
+		entry.m_csOld = pContext->m_csOldDate;
+		entry.m_csNew = pContext->m_csDate;
+		entry.m_csStatus = pContext->m_pcszStatus;
+
+		static thread_local string csLine;
+		CPlanManifest::Format( entry, csLine );
+		m_Plan.Write( CLogSink::lvFile, csLine.data(), csLine.size() );
+	}
 
-	// the new folder under the image folder to contain the corrected images
-	const CString csCorrected = GetCorrectedFolder();
-	const int nCorrected = GetCorrectedFolderLength();
+	// the file no longer needs to be processed if the run is resumed
+	if ( m_Checkpoint.GetEnabled() )
+	{
+		m_Checkpoint.EndFile( (LPCTSTR)pContext->m_csPath );
+	}
 
-	// get the folder which will trim any wild card data
-	CString csPathname = CHelper::GetFolder( path );
+	delete pContext;
+} // FinishFile
 
-	// wild cards are in use if the pathname does not equal the given path
-	const bool bWildCards = csPathname != path;
-	csPathname.TrimRight( _T( "\\" ) );
-	CString csData;
+/////////////////////////////////////////////////////////////////////////////
+// stamp the file with its size and time stamp and return true if the 
+// journal shows an earlier run did everything this run would do with it,
+// which costs one look at the file system instead of reading the file.
+// The files of a plan being applied are not journaled because their new
+// dates come from the plan rather than the offset.
+bool GetUnchanged( const CRunConfig& config, FILE_CONTEXT& context )
+{
+	if ( !m_Journal.GetOpen() || context.m_bPlanned )
+	{
+		return false;
+	}
 
-	// build a string with wild-cards
-	CString strWildcard;
-	if ( bWildCards )
+	FILE_STAMP& stamp = context.m_Stamp;
+	if ( !CRunJournal::GetStamp( context.m_csPath, stamp ) )
+	{
+		return false;
+	}
+	if 
+	( 
+		m_Journal.GetHash() && 
+		!CRunJournal::GetHeaderHash( context.m_csPath, stamp ) 
+	)
 	{
-		csData = CHelper::GetDataName( path );
-		strWildcard.Format( _T( "%s\\%s" ), csPathname, csData );
+		return false;
+	}
+	context.m_bStamped = true;
 
-	} else // no wild cards, just a folder
+	if ( !m_Journal.GetUnchanged( (LPCTSTR)context.m_csPath, stamp, config.GetOffset() ) )
 	{
-		strWildcard.Format( _T( "%s\\*.*" ), csPathname );
+		return false;
 	}
 
-	// start trolling for files we are interested in
-	CFileFind finder;
-	BOOL bWorking = finder.FindFile( strWildcard );
-	while ( bWorking )
+	context.m_pcszStatus = CPlanManifest::UNCHANGED;
+	context.m_csLog = context.m_csPath + _T( "\n" );
+	context.m_csLog += _T( ".\n" );
+	context.m_csLog += _T( "Unchanged since the last run.\n" );
+	context.m_csLog += _T( ".\n" );
+	return true;
+} // GetUnchanged
+
+/////////////////////////////////////////////////////////////////////////////
+// record the outcome of a file that was stamped in the journal
+void JournalFile
+( 
+	const CRunConfig& config, const FILE_CONTEXT& context, const char* pcszStatus
+)
+{
+	if ( !context.m_bStamped )
 	{
-		bWorking = finder.FindNextFile();
+		return;
+	}
 
-		// skip "." and ".." folder names
-		if ( finder.IsDots() )
+	JOURNAL_ENTRY entry;
+	entry.m_Stamp = context.m_Stamp;
+	entry.m_llOffset = config.GetOffset();
+
+	// a file corrected in place is a new version of the file which is
+	// the one the next run must find unchanged
+	if ( config.GetInPlace() && pcszStatus == CRunJournal::CORRECTED )
+	{
+		if ( !CRunJournal::GetStamp( context.m_csPath, entry.m_Stamp ) )
 		{
-			continue;
+			return;
 		}
-
-		// if it's a directory, recursively search it
-		if ( finder.IsDirectory() )
+		if 
+		( 
+			m_Journal.GetHash() && 
+			!CRunJournal::GetHeaderHash( context.m_csPath, entry.m_Stamp ) 
+		)
 		{
+			return;
+		}
+	}
 
-			// if the user did not specify recursing into sub-folders
-			// then we can ignore any directories found
-			if ( m_bRecurse == false )
-			{
-				continue;
-			}
+	entry.m_csStatus = pcszStatus;
+	m_Journal.Record( (LPCTSTR)context.m_csPath, entry );
+} // JournalFile
 
-			// do not recurse into the corrected folder
-			const CString str = finder.GetFilePath().TrimRight( _T( "\\" ) );
-			if ( str.Right( nCorrected ) == csCorrected )
-			{
-				continue;
-			}
+/////////////////////////////////////////////////////////////////////////////
+// read stage: read the current date and time from the metadata which 
+// should be in this format from the image "YYYY:MM:DD HH:MM:SS" and 
+// return false if there is nothing more to do with the file
+bool ReadDateTaken( FILE_CONTEXT& context )
+{
+	context.m_csLog = context.m_csPath + _T( "\n" );
 
-			// if wild cards in use, build a path with the wild cards
-			if ( bWildCards )
-			{
-				CString csPath;
-				csPath.Format( _T( "%s\\%s" ), str, csData );
+	const CString csDateTaken = GetCurrentDateTaken( context );
 
-				// recurse into the new directory with wild cards
-				RecursePath( csPath );
+	// only the date locations are needed from here on
+	context.m_Reader.Release();
 
-			} else // recurse into the new directory
-			{
-				RecursePath( str + _T( "\\" ) );
-			}
+	// a file that is not an image is never opened as one
+	if ( context.m_eKind == CFileClassifier::fkNone )
+	{
+		context.m_pcszStatus = CPlanManifest::MISSING;
+		context.m_csLog += _T( ".\n" );
+		context.m_csLog += _T( "Not a readable image file.\n" );
+		context.m_csLog += _T( ".\n" );
+		return false;
+	}
 
-		} else // write the properties if it is a valid extension
-		{
-			const CString csPath = finder.GetFilePath();
-			const CString csExt = CHelper::GetExtension( csPath ).MakeLower();
-			const CString csFile = CHelper::GetFileName( csPath );
+	// if the date taken is empty, there is nothing for us
+	// to do
+	CString csOutput;
+	context.m_csOldDate = csDateTaken;
+	if ( csDateTaken.IsEmpty() )
+	{
+		context.m_pcszStatus = CPlanManifest::MISSING;
+		context.m_csLog += _T( ".\n" );
+		context.m_csLog += _T( "Old Date Taken is missing.\n" );
+		context.m_csLog += _T( ".\n" );
+		return false;
+	}
 
-			if ( -1 != csValidExt.Find( csExt ) )
-			{
-				m_Extension.FileExtension = csExt;
+	context.m_Date.DateTaken = csDateTaken;
+	if ( !context.m_Date.Okay )
+	{
+		context.m_pcszStatus = CPlanManifest::INVALID;
+		csOutput.Format
+		( 
+			_T( "Old Date Taken is invalid: %s.\n" ), csDateTaken 
+		);
+		context.m_csLog += _T( ".\n" );
+		context.m_csLog += csOutput;
+		context.m_csLog += _T( ".\n" );
+		return false;
+	}
 
-				CStdioFile fout( stdout );
-				fout.WriteString( csPath + _T( "\n" ) );
+	csOutput.Format( _T( "Old Date Taken is: %s.\n" ), csDateTaken );
+	context.m_csLog += csOutput;
 
-				// read the current date and time from the metadata
-				// which should be in this format from the image
-				// "YYYY:MM:DD HH:MM:SS"
-				const CString csDateTaken = GetCurrentDateTaken( csPath );
+	// a plan is only applied to files that have not changed since
+	// the plan was made
+	if ( context.m_bPlanned && csDateTaken != context.m_csPlannedOld )
+	{
+		context.m_pcszStatus = CPlanManifest::CHANGED;
+		csOutput.Format
+		( 
+			_T( "Old Date Taken does not match the plan: %s.\n" ), 
+			context.m_csPlannedOld 
+		);
+		context.m_csLog += _T( ".\n" );
+		context.m_csLog += csOutput;
+		context.m_csLog += _T( ".\n" );
+		return false;
+	}
+
+	return true;
+} // ReadDateTaken
+
+/////////////////////////////////////////////////////////////////////////////
+// offset stage: add the configured hour offset to the date taken and 
+// return false if the new date is not valid
+bool OffsetDateTaken( const CRunConfig& config, FILE_CONTEXT& context )
+{
+	// shift the file's date by the exact offset in whole seconds
+	// since 1970 rather than adding fractional days to an OLE date
+	// or take the new date from the plan being applied
+	DATE_FIELDS fields = context.m_Date.Fields;
+	const bool bShifted = context.m_bPlanned ?
+		CExifDate::Parse
+		( 
+			context.m_csPlannedNew, 
+			context.m_csPlannedNew.GetLength(), 
+			fields 
+		) && CExifDate::IsValid( fields ) :
+		CExifDate::Shift( fields, config.GetOffset() );
+	context.m_Date.Fields = fields;
+
+	CString csOutput;
+	context.m_csDate = context.m_Date.Date;
+	if ( !bShifted || !context.m_Date.Okay )
+	{
+		context.m_pcszStatus = CPlanManifest::RANGE;
+		csOutput.Format
+		( 
+			_T( "New Date Taken is invalid: %s.\n" ), context.m_csDate
+		);
+		context.m_csLog += _T( ".\n" );
+		context.m_csLog += csOutput;
+		context.m_csLog += _T( ".\n" );
+		context.m_csDate.Empty();
+		return false;
+	}
+
+	context.m_pcszStatus = CPlanManifest::PLANNED;
+	csOutput.Format( _T( "New Date Taken is: %s\n" ), context.m_csDate );
+	context.m_csLog += csOutput;
+	context.m_csLog += _T( ".\n" );
+	return true;
+} // OffsetDateTaken
 
-				// if the date taken is empty, there is nothing for us
-				// to do
-				CString csOutput;
-				if ( csDateTaken.IsEmpty() )
+/////////////////////////////////////////////////////////////////////////////
+// write stage: save the image with the new date into the corrected folder
+// or over the image itself when correcting in place, and return false if 
+// the image could not be saved
+bool WriteDateTaken( const CRunConfig& config, FILE_CONTEXT& context )
+{
+	USES_CONVERSION;
+
+	// the codec of the kind of image the file really is
+	const CCodecRegistry::CODEC& codec = m_Codecs.GetCodec( context.m_eKind );
+
+	// JPEG, PNG and TIFF based files have their dates patched directly in
+	// a copy of the file rather than being re-encoded by GDI+
+	const bool bInPlace = config.GetInPlace();
+	if 
+	( 
+		codec.m_bNative && context.m_pImage == nullptr && 
+		SaveNative( context, bInPlace ) 
+	)
+	{
+		return true;
+	}
+
+	// a file that failed to be patched in place may have changed since
+	// it was read, so it is not saved again by GDI+
+	if ( bInPlace && CExifPatcher::GetFits( context.m_Reader ) )
+	{
+		return false;
+	}
+
+	// GDI+ has no encoder for raw files
+	if ( !codec.m_bEncoder )
+	{
+		return false;
+	}
+
+	// reuse the image opened while reading the date or open
+	// the JPEG file that could not be patched natively
+	if ( context.m_pImage == nullptr )
+	{
+		CMetricTimer timer
+		( 
+			&m_Metrics, CMetrics::mpFromFile, context.m_csPath 
+		);
+		context.m_pImage = unique_ptr<Gdiplus::Image>
+		(
+			Gdiplus::Image::FromFile( T2CW( context.m_csPath ) )
+		);
+	}
+
+	CString csDate = context.m_csDate;
+
+	// smart pointer to the original date property item
+	// (smart pointers automatically release their resources
+	// when they go out of context)
+	unique_ptr<Gdiplus::PropertyItem> pOriginalDateItem =
+		unique_ptr<Gdiplus::PropertyItem>( new Gdiplus::PropertyItem );
+	pOriginalDateItem->id = PropertyTagExifDTOrig;
+	pOriginalDateItem->type = PropertyTagTypeASCII;
+	pOriginalDateItem->length = csDate.GetLength() + 1;
+	pOriginalDateItem->value = csDate.GetBuffer( pOriginalDateItem->length );
+
+	// smart pointer to the digitized date property item
+	unique_ptr<Gdiplus::PropertyItem> pDigitizedDateItem =
+		unique_ptr<Gdiplus::PropertyItem>( new Gdiplus::PropertyItem );
+	pDigitizedDateItem->id = PropertyTagExifDTDigitized;
+	pDigitizedDateItem->type = PropertyTagTypeASCII;
+	pDigitizedDateItem->length = csDate.GetLength() + 1;
+	pDigitizedDateItem->value = csDate.GetBuffer( pDigitizedDateItem->length );
+
+	// if these properties exist they will be replaced
+	// if these properties do not exist they will be created
+	context.m_pImage->SetPropertyItem( pOriginalDateItem.get() );
+	context.m_pImage->SetPropertyItem( pDigitizedDateItem.get() );
+
+	// save the image to the new path
+	CString csPath;
+	bool value = 
+		GetOutputPath( context.m_csPath, bInPlace, csPath ) &&
+		Save( context, codec.m_ClassID, csPath );
+
+	// release the date buffer
+	csDate.ReleaseBuffer();
+
+	// GDI+ holds the image file open until the image is released
+	if ( value && bInPlace )
+	{
+		context.m_pImage.reset();
+		value = CFileCommit::Replace( csPath, context.m_csPath );
+
+	} else if ( !value && bInPlace )
+	{
+		::DeleteFile( csPath );
+	}
+
+	return value;
+} // WriteDateTaken
+
+/////////////////////////////////////////////////////////////////////////////
+// report the backpressure of a queue between two pipeline stages
+void WriteQueueStats( LPCTSTR lpszName, CBoundedQueue<FILE_CONTEXT*>& queue )
+{
+	m_Log.Format
+	(
+		CLogSink::lvSummary,
+		"%s queue: %llu files, %llu full waits, "
+		"%llu empty waits, high water %u of %u\n",
+		lpszName, 
+		queue.GetPushes(), 
+		queue.GetFullWaits(),
+		queue.GetEmptyWaits(), 
+		(UINT)queue.GetHighWater(), 
+		(UINT)queue.GetCapacity()
+	);
+} // WriteQueueStats
+
+/////////////////////////////////////////////////////////////////////////////
+// crawl through the given directory tree which may include wild cards
+// and process the image files found with a pipeline of stages connected
+// by bounded queues: enumerate -> read and parse -> offset -> write, 
+// so slow I/O on one file does not stall the other stages. The run 
+// configuration is shared by every stage as a const reference.
+// Returns false if the plan or the file list could not be read.
+bool RecursePath( const CRunConfig& config )
+{
+	const CPathView path( config.GetPathname() );
+
+	// get the folder which will trim any wild card data
+	const string_view folder = path.GetFolder();
+	string csPathname( folder.data(), folder.length() );
+
+	// wild cards are in use if the pathname does not equal the given path
+	const bool bWildCards = folder.length() != path.GetPath().length();
+	while ( !csPathname.empty() && csPathname.back() == '\\' )
+	{
+		csPathname.pop_back();
+	}
+	string csData;
+	if ( bWildCards )
+	{
+		csData = path.GetDataName();
+	}
+
+	// a dry run records the changes in a manifest and writes no images
+	const bool bPlan = !config.GetPlan().empty();
+
+	// the totals of the run
+	atomic<unsigned long long> ullPlanned( 0 );
+	atomic<unsigned long long> ullSkipped( 0 );
+	atomic<unsigned long long> ullUnchanged( 0 );
+	atomic<unsigned long long> ullCorrected( 0 );
+	atomic<unsigned long long> ullFailed( 0 );
+
+	// the queues between the stages
+	const size_t tDepth = (size_t)config.GetQueueDepth();
+	CBoundedQueue<FILE_CONTEXT*> readQueue( tDepth );
+	CBoundedQueue<FILE_CONTEXT*> offsetQueue( tDepth );
+	CBoundedQueue<FILE_CONTEXT*> writeQueue( tDepth );
+
+	// read and parse the date taken
+	CPipelineStage readStage;
+	readStage.Start
+	(
+		config.GetReadThreads(),
+		[ & ]()
+		{
+			FILE_CONTEXT* pContext = nullptr;
+			while ( readQueue.Pop( pContext ) )
+			{
+				// skip the files an earlier run has done
+				if ( GetUnchanged( config, *pContext ) )
 				{
-					fout.WriteString( _T( ".\n") );
-					fout.WriteString( _T( "Old Date Taken is missing.\n" ));
-					fout.WriteString( _T( ".\n" ) );
+					ullUnchanged++;
+					FinishFile( pContext );
 					continue;
 				}
 
-				m_Date.DateTaken = csDateTaken;
-				bool bValid = m_Date.Okay;
-				if ( !bValid )
+				bool bRead = false;
 				{
-					csOutput.Format
+					CMetricTimer timer
 					( 
-						_T( "Old Date Taken is invalid: %s.\n" ), csDateTaken 
+						&m_Metrics, CMetrics::mpRead, pContext->m_csPath 
 					);
-					fout.WriteString( _T( ".\n" ) );
-					fout.WriteString( csOutput );
-					fout.WriteString( _T( ".\n" ) );
-					continue;
+					bRead = ReadDateTaken( *pContext );
+				}
+				if ( bRead )
+				{
+					offsetQueue.Push( pContext );
 
 				} else
 				{
-					csOutput.Format
-					(
-						_T( "Old Date Taken is: %s.\n" ), csDateTaken
+					// a file without a usable date stays that way until
+					// it is changed
+					const char* pcszStatus = pContext->m_pcszStatus;
+					if 
+					( 
+						pcszStatus == CPlanManifest::MISSING || 
+						pcszStatus == CPlanManifest::INVALID 
+					)
+					{
+						JournalFile( config, *pContext, pcszStatus );
+					}
+					ullSkipped++;
+					FinishFile( pContext );
+				}
+			}
+		},
+		[ & ]() { offsetQueue.Close(); }
+	);
+
+	// compute the new date taken
+	CPipelineStage offsetStage;
+	offsetStage.Start
+	(
+		config.GetOffsetThreads(),
+		[ & ]()
+		{
+			FILE_CONTEXT* pContext = nullptr;
+			while ( offsetQueue.Pop( pContext ) )
+			{
+				bool bShifted = false;
+				{
+					CMetricTimer timer
+					( 
+						&m_Metrics, CMetrics::mpShift, pContext->m_csPath 
 					);
-					fout.WriteString( csOutput );
+					bShifted = OffsetDateTaken( config, *pContext );
 				}
+				if ( !bShifted )
+				{
+					ullSkipped++;
+					FinishFile( pContext );
 
-				// get the date and time from the m_Date member class
-				COleDateTime oDT = m_Date.DateAndTime;
-
-				// convert the offset in hours to days which is the 
-				// internal representation of the COleDateTime class
-				const double dOffset = m_dHourOffset / 24.0;
-
-				// modify the date and time by adding in the offset
-				oDT.m_dt += dOffset; 
-
-				// change the date
-				m_Date.DateAndTime = oDT;
+				} else if ( bPlan ) // a dry run only records the change
+				{
+					ullPlanned++;
+					FinishFile( pContext );
 
-				CString csDate = m_Date.Date;
-				bValid = m_Date.Okay;
-				if ( !bValid )
+				} else
+				{
+					writeQueue.Push( pContext );
+				}
+			}
+		},
+		[ & ]() { writeQueue.Close(); }
+	);
+
+	// patch or save the image
+	CPipelineStage writeStage;
+	writeStage.Start
+	(
+		config.GetWriteThreads(),
+		[ & ]()
+		{
+			FILE_CONTEXT* pContext = nullptr;
+			while ( writeQueue.Pop( pContext ) )
+			{
+				bool bWritten = false;
 				{
-					csOutput.Format
+					CMetricTimer timer
 					( 
-						_T( "New Date Taken is invalid: %s.\n" ), csDate
+						&m_Metrics, CMetrics::mpWrite, pContext->m_csPath 
 					);
-					fout.WriteString( _T( ".\n" ) );
-					fout.WriteString( csOutput );
-					fout.WriteString( _T( ".\n" ) );
-					continue;
+					bWritten = WriteDateTaken( config, *pContext );
 				}
+				if ( bWritten )
+				{
+					JournalFile( config, *pContext, CRunJournal::CORRECTED );
+					ullCorrected++;
 
-				csOutput.Format( _T( "New Date Taken is: %s\n" ), csDate );
-				fout.WriteString( csOutput );
-				fout.WriteString( _T( ".\n" ) );
+				} else
+				{
+					ullFailed++;
+				}
+				FinishFile( pContext );
+			}
+		},
+		[]() {}
+	);
 
-				// smart pointer to the image representing this element
-				unique_ptr<Gdiplus::Image> pImage =
-					unique_ptr<Gdiplus::Image>
+	// hand an image file to the read stage along with its plan entry
+	// when a plan is being applied
+	auto queueFile = [ & ]( const CPathView& path, const PLAN_ENTRY* pEntry )
+	{
+		const CFileClassifier::FILE_KIND eKind = 
+			CFileClassifier::GetPathKind( path );
+		if ( eKind != CFileClassifier::fkNone )
+		{
+			// skip the files finished before the run was resumed
+			const string_view csPath = path.GetPath();
+			if 
+			( 
+				m_Checkpoint.GetEnabled() && 
+				!m_Checkpoint.BeginFile( string( csPath ) ) 
+			)
+			{
+				return;
+			}
+
+			FILE_CONTEXT* pContext = new FILE_CONTEXT();
+			pContext->m_csPath.SetString( csPath.data(), (int)csPath.length() );
+			pContext->m_eKind = eKind;
+			if ( pEntry != nullptr )
+			{
+				pContext->m_bPlanned = true;
+				pContext->m_csPlannedOld = pEntry->m_csOld.c_str();
+				pContext->m_csPlannedNew = pEntry->m_csNew.c_str();
+			}
+			readQueue.Push( pContext );
+		}
+	};
+
+	// sample the depth of the queues into the timeline so stalls of a
+	// stage show up next to the steps that caused them
+	atomic<bool> bSampling( true );
+	thread sampler;
+	CTraceLog* pTrace = m_Metrics.GetTrace();
+	if ( pTrace != nullptr )
+	{
+		sampler = thread
+		(
+			[ & ]()
+			{
+				char szArgs[ 80 ];
+				while ( bSampling )
+				{
+					snprintf
 					(
-						Gdiplus::Image::FromFile( T2CW( csPath ) )
+						szArgs, sizeof( szArgs ),
+						"\"read\": %zu, \"offset\": %zu, \"write\": %zu",
+						readQueue.GetSize(), offsetQueue.GetSize(),
+						writeQueue.GetSize()
 					);
+					pTrace->Counter( "queue depth", szArgs );
+					this_thread::sleep_for( chrono::milliseconds( 10 ) );
+				}
+			}
+		);
+	}
 
-				// smart pointer to the original date property item
-				// (smart pointers automatically release their resources
-				// when they go out of context)
-				unique_ptr<Gdiplus::PropertyItem> pOriginalDateItem =
-					unique_ptr<Gdiplus::PropertyItem>( new Gdiplus::PropertyItem );
-				pOriginalDateItem->id = PropertyTagExifDTOrig;
-				pOriginalDateItem->type = PropertyTagTypeASCII;
-				pOriginalDateItem->length = csDate.GetLength() + 1;
-				pOriginalDateItem->value = csDate.GetBuffer( pOriginalDateItem->length );
-
-				// smart pointer to the digitized date property item
-				unique_ptr<Gdiplus::PropertyItem> pDigitizedDateItem =
-					unique_ptr<Gdiplus::PropertyItem>( new Gdiplus::PropertyItem );
-				pDigitizedDateItem->id = PropertyTagExifDTDigitized;
-				pDigitizedDateItem->type = PropertyTagTypeASCII;
-				pDigitizedDateItem->length = csDate.GetLength() + 1;
-				pDigitizedDateItem->value = csDate.GetBuffer( pDigitizedDateItem->length );
-
-				// if these properties exist they will be replaced
-				// if these properties do not exist they will be created
-				pImage->SetPropertyItem( pOriginalDateItem.get() );
-				pImage->SetPropertyItem( pDigitizedDateItem.get() );
-
-				// save the image to the new path
-				Save( csPath, pImage.get() );
-
-				// release the date buffer
-				csDate.ReleaseBuffer();
+	// write a checkpoint of the walk every so often so the run can be
+	// resumed if it dies
+	atomic<bool> bWalking( true );
+	thread checkpointer;
+	if ( m_Checkpoint.GetEnabled() )
+	{
+		checkpointer = thread
+		(
+			[ & ]()
+			{
+				const auto tInterval = 
+					chrono::seconds( config.GetCheckpointSeconds() );
+				auto tNext = chrono::steady_clock::now() + tInterval;
+				while ( bWalking )
+				{
+					this_thread::sleep_for( chrono::milliseconds( 100 ) );
+					if ( chrono::steady_clock::now() >= tNext )
+					{
+						m_Checkpoint.Save();
+						tNext = chrono::steady_clock::now() + tInterval;
+					}
+				}
+			}
+		);
+	}
+
+	CDirectoryWalker walker;
+	walker.SetMetrics( &m_Metrics );
+	if ( m_Checkpoint.GetEnabled() )
+	{
+		// complete folders are not walked again by a resumed run
+		walker.SetFolderCallback
+		(
+			[]( const string& csFolder, const string& csParent )
+			{
+				return m_Checkpoint.BeginFolder( csFolder, csParent );
 			}
+		);
+		walker.SetDoneCallback
+		(
+			[]( const string& csFolder )
+			{
+				m_Checkpoint.EndFolder( csFolder );
+			}
+		);
+	}
+
+	// false when the plan or the file list could not be read
+	bool bListed = true;
+	if ( !config.GetApply().empty() )
+	{
+		// the files and their new dates come from the manifest of a 
+		// dry run instead of the folders
+		const bool bRead = CPlanManifest::Read
+		(
+			config.GetApply().c_str(),
+			[ & ]( const PLAN_ENTRY& entry )
+			{
+				if ( entry.m_csStatus == CPlanManifest::PLANNED )
+				{
+					queueFile( CPathView( entry.m_csPath ), &entry );
+				}
+			}
+		);
+		if ( !bRead )
+		{
+			m_Log.Format
+			( 
+				CLogSink::lvSummary, ".\nUnable to read the plan: %s\n.\n",
+				config.GetApply().c_str()
+			);
+			bListed = false;
 		}
+
+	} else if ( !config.GetFilesFrom().empty() )
+	{
+		// the files come from a list which is processed as it is read
+		// instead of from the folders
+		const bool bRead = CFileList::Read
+		(
+			config.GetFilesFrom().c_str(),
+			[ & ]( const CPathView& path )
+			{
+				queueFile( path, nullptr );
+			}
+		);
+		if ( !bRead )
+		{
+			m_Log.Format
+			( 
+				CLogSink::lvSummary, ".\nUnable to read the file list: %s\n.\n",
+				config.GetFilesFrom().c_str()
+			);
+			bListed = false;
+		}
+
+	} else // enumerate the folders
+	{
+		// the walker will not enter the corrected folders
+		walker.SetThreads( config.GetWalkThreads() );
+		walker.SetExclude( (LPCTSTR)GetCorrectedFolder() );
+		walker.Walk
+		(
+			csPathname,
+			csData,
+			config.GetRecurse(),
+			[ & ]( const CPathView& path, int )
+			{
+				queueFile( path, nullptr );
+			}
+		);
 	}
+	readQueue.Close();
 
-	// clean up and go home
-	finder.Close();
+	readStage.Join();
+	offsetStage.Join();
+	writeStage.Join();
+
+	if ( sampler.joinable() )
+	{
+		bSampling = false;
+		sampler.join();
+	}
+
+	// a finished run has nothing to resume
+	if ( checkpointer.joinable() )
+	{
+		bWalking = false;
+		checkpointer.join();
+
+		const bool bFinished = m_Checkpoint.GetFinished();
+		if ( bFinished ? !m_Checkpoint.Remove() : !m_Checkpoint.Save() )
+		{
+			m_Log.Format
+			( 
+				CLogSink::lvSummary, ".\nUnable to update the checkpoint: %s\n.\n",
+				config.GetCheckpoint().c_str()
+			);
+		}
+		if ( m_Checkpoint.GetResumed() > 0 )
+		{
+			m_Log.Format
+			( 
+				CLogSink::lvSummary, 
+				".\n%llu files were finished before the run was resumed\n",
+				m_Checkpoint.GetResumed()
+			);
+		}
+	}
+
+	m_Log.Format
+	(
+		CLogSink::lvSummary,
+		".\n%llu folders, %llu files, %llu planned, %llu corrected, "
+		"%llu unchanged, %llu skipped, %llu failed\n.\n",
+		walker.GetDirectories(),
+		readQueue.GetPushes(),
+		ullPlanned.load(),
+		ullCorrected.load(),
+		ullUnchanged.load(),
+		ullSkipped.load(),
+		ullFailed.load()
+	);
+
+	if ( config.GetQueueStats() )
+	{
+		WriteQueueStats( _T( "Read" ), readQueue );
+		WriteQueueStats( _T( "Offset" ), offsetQueue );
+		WriteQueueStats( _T( "Write" ), writeQueue );
+		m_Log.Write( CLogSink::lvSummary, ".\n" );
+	}
+
+	m_Log.Flush();
+
+	return bListed;
 
 } // RecursePath
 
 /////////////////////////////////////////////////////////////////////////////
-// set the current file extension which will automatically lookup the
-// related mime type and class ID and set their respective properties
-void CExtension::SetFileExtension( CString value )
+// look up the GDI+ encoders of the kinds of image, which must be done
+// once after GDI+ has started and before any lookup, and return false
+// if the encoders could not be listed
+bool CCodecRegistry::Build()
 {
-	m_csFileExtension = value;
+	UINT num = 0;
+	UINT size = 0;
+
+	// gets the number of available image encoders and 
+	// the total size of the array
+	Gdiplus::GetImageEncodersSize( &num, &size );
+	if ( size == 0 )
+	{
+		return false;
+	}
 
-	if ( m_mapExtensions.Exists[ value ] )
+	// a smart pointer to the image codex information
+	unique_ptr<ImageCodecInfo> pImageCodecInfo =
+		unique_ptr<ImageCodecInfo>
+		( 
+			(ImageCodecInfo*)malloc( size ) 
+		);
+	if ( pImageCodecInfo == nullptr )
 	{
-		MimeType = *m_mapExtensions.find( value );
+		return false;
+	}
+
+	// Returns an array of ImageCodecInfo objects that contain 
+	// information about the image encoders built into GDI+.
+	Gdiplus::GetImageEncoders( num, size, pImageCodecInfo.get() );
 
-		// populate the mime type map the first time it is referenced
-		if ( m_mapMimeTypes.Count == 0 )
+	// give each kind of image the encoder of its mime type
+	for ( CODEC& codec : m_Codecs )
+	{
+		if ( *codec.m_pcwszMimeType == L'\0' )
 		{
-			UINT num = 0;
-			UINT size = 0;
+			continue;
+		}
 
-			// gets the number of available image encoders and 
-			// the total size of the array
-			Gdiplus::GetImageEncodersSize( &num, &size );
-			if ( size == 0 )
+		for ( UINT nIndex = 0; nIndex < num; ++nIndex )
+		{
+			const ImageCodecInfo& info = pImageCodecInfo.get()[ nIndex ];
+			if ( wcscmp( info.MimeType, codec.m_pcwszMimeType ) == 0 )
 			{
-				return;
+				codec.m_ClassID = info.Clsid;
+				codec.m_bEncoder = true;
+				break;
 			}
+		}
+	}
 
-			// a smart pointer to the image codex information
-			unique_ptr<ImageCodecInfo> pImageCodecInfo =
-				unique_ptr<ImageCodecInfo>
-				( 
-					(ImageCodecInfo*)malloc( size ) 
-				);
-			if ( pImageCodecInfo == nullptr )
-			{
-				return;
-			}
+	return true;
+} // CCodecRegistry::Build
+
+/////////////////////////////////////////////////////////////////////////////
+// report the latency of the hot spots of the run
+void WriteMetrics()
+{
+	string csTable = ".\n";
+	m_Metrics.WriteTable( csTable );
+	csTable += ".\n";
+	m_Log.Write( CLogSink::lvSummary, csTable.c_str(), csTable.length() );
+	m_Log.Flush();
+} // WriteMetrics
+
+/////////////////////////////////////////////////////////////////////////////
+// write the latency of the hot spots of the run as JSON
+bool WriteMetricsFile( const string& csPath )
+{
+	string csJson;
+	m_Metrics.WriteJson( csJson );
+
+	FILE* pFile = fopen( csPath.c_str(), "wb" );
+	if ( pFile == nullptr )
+	{
+		return false;
+	}
+
+	const bool bWritten = 
+		fwrite( csJson.data(), 1, csJson.size(), pFile ) == csJson.size();
+	return fclose( pFile ) == 0 && bWritten;
+} // WriteMetricsFile
+
+/////////////////////////////////////////////////////////////////////////////
+// ask for a report of the metrics while the run is going (Ctrl+Break on
+// Windows, SIGUSR1 elsewhere), the report is written by the monitor 
+// thread because little is safe to call inside of a signal handler
+void OnReportSignal( int nSignal )
+{
+	m_bReportMetrics = true;
+	signal( nSignal, OnReportSignal );
+} // OnReportSignal
+
+/////////////////////////////////////////////////////////////////////////////
+// process the files of a run once the command line has been validated
+// and return the exit code
+int Run( const CRunConfig& config )
+{
+	m_Log.SetVerbosity( config.GetVerbosity() );
+
+	// open the manifest of a dry run
+	const string& csPlan = config.GetPlan();
+	FILE* pPlan = nullptr;
+	if ( csPlan == "-" )
+	{
+		// keep the manifest on the console free of other output
+		pPlan = stdout;
+		m_Log.SetVerbosity( CLogSink::lvQuiet );
+
+	} else if ( !csPlan.empty() )
+	{
+		pPlan = fopen( csPlan.c_str(), "wb" );
+		if ( pPlan == nullptr )
+		{
+			_tprintf( _T( ".\nUnable to create the plan: %s\n.\n" ), csPlan.c_str() );
+			return 6;
+		}
+	}
+
+	if ( pPlan != nullptr )
+	{
+		m_Plan.SetStream( pPlan );
+		m_Plan.Write( CLogSink::lvFile, CPlanManifest::GetHeader() );
+	}
+
+	// skip the files done by earlier runs
+	const string& csJournal = config.GetJournal();
+	if ( !csJournal.empty() )
+	{
+		m_Journal.SetHash( config.GetJournalHash() );
+		if ( !m_Journal.Open( csJournal.c_str() ) )
+		{
+			_tprintf
+			( 
+				_T( ".\nUnable to open the journal: %s\n.\n" ), 
+				csJournal.c_str() 
+			);
+			return 7;
+		}
+	}
+
+	// keep checkpoints of the walk and continue from the last one
+	const string& csCheckpoint = config.GetCheckpoint();
+	if ( !csCheckpoint.empty() )
+	{
+		string csError;
+		const bool bOpen = m_Checkpoint.Open
+		( 
+			csCheckpoint.c_str(), config.GetPathname(), config.GetOffset(),
+			config.GetResume(), csError
+		);
+		if ( !bOpen )
+		{
+			_tprintf
+			( 
+				_T( ".\nUnable to resume %s: %s\n.\n" ), 
+				csCheckpoint.c_str(), csError.c_str()
+			);
+			return 8;
+		}
+	}
 
-			// Returns an array of ImageCodecInfo objects that contain 
-			// information about the image encoders built into GDI+.
-			Gdiplus::GetImageEncoders( num, size, pImageCodecInfo.get() );
+	// start up COM
+	AfxOleInit();
+	::CoInitialize( NULL );
 
-			// populate the map of mime types the first time it is 
-			// needed
-			for ( UINT nIndex = 0; nIndex < num; ++nIndex )
+	// reference to GDI+
+	InitGdiplus();
+
+	// look up the encoders once for every writer to share
+	m_Codecs.Build();
+
+	// time the hot spots and report them on request while the run is 
+	// going
+	atomic<bool> bRunning( true );
+	thread monitor;
+	if ( config.GetMetrics() )
+	{
+		m_Metrics.SetEnabled( true );
+#ifdef SIGBREAK
+		signal( SIGBREAK, OnReportSignal );
+#else
+		signal( SIGUSR1, OnReportSignal );
+#endif
+		monitor = thread
+		(
+			[ & ]()
 			{
-				CString csKey;
-				csKey = CW2A( pImageCodecInfo.get()[ nIndex ].MimeType );
-				CLSID classID = pImageCodecInfo.get()[ nIndex ].Clsid;
-				m_mapMimeTypes.add( csKey, new CLSID( classID ) );
+				while ( bRunning )
+				{
+					if ( m_bReportMetrics.exchange( false ) )
+					{
+						WriteMetrics();
+					}
+					this_thread::sleep_for( chrono::milliseconds( 100 ) );
+				}
 			}
+		);
+	}
+
+	// record a timeline of the folders and the steps of each file
+	const string& csTrace = config.GetTrace();
+	unique_ptr<CTraceLog> pTrace;
+	if ( !csTrace.empty() )
+	{
+		pTrace = unique_ptr<CTraceLog>( new CTraceLog );
+		m_Metrics.SetTrace( pTrace.get() );
+	}
+
+	// each corrected folder is created by the first writer that needs it
+	m_CorrectedFolders.SetCreate
+	(
+		[]( const string& csFolder )
+		{
+			CMetricTimer timer
+			( 
+				&m_Metrics, CMetrics::mpCreatePath, csFolder.c_str() 
+			);
+			return CreatePath( csFolder.c_str() );
 		}
+	);
 
-		ClassID = *m_mapMimeTypes.find( MimeType );
+	// crawl through directory tree defined by the command line
+	// parameter trolling for image files
+	const bool bListed = RecursePath( config );
+	m_CorrectedFolders.Clear();
 
-	} else
+	if ( pTrace != nullptr )
+	{
+		m_Metrics.SetTrace( nullptr );
+		if ( !pTrace->Write( csTrace.c_str() ) )
+		{
+			_tprintf
+			( 
+				_T( ".\nUnable to write the trace: %s\n.\n" ), 
+				csTrace.c_str() 
+			);
+		}
+	}
+
+	// clean up references to GDI+
+	TerminateGdiplus();
+
+	if ( config.GetMetrics() )
+	{
+		bRunning = false;
+		monitor.join();
+		WriteMetrics();
+
+		const string& csMetricsFile = config.GetMetricsFile();
+		if ( !csMetricsFile.empty() && !WriteMetricsFile( csMetricsFile ) )
+		{
+			_tprintf
+			( 
+				_T( ".\nUnable to write the metrics: %s\n.\n" ), 
+				csMetricsFile.c_str() 
+			);
+		}
+	}
+
+	// finish the journal
+	if ( !m_Journal.Close() )
+	{
+		_tprintf
+		( 
+			_T( ".\nUnable to write the journal: %s\n.\n" ), 
+			csJournal.c_str() 
+		);
+	}
+
+	// finish the manifest
+	if ( pPlan != nullptr )
+	{
+		m_Plan.Flush();
+		m_Plan.SetStream( nullptr );
+		if ( pPlan != stdout )
+		{
+			fclose( pPlan );
+		}
+	}
+
+	// the files to process could not be read
+	if ( !bListed )
 	{
-		MimeType = _T( "" );
+		return 4;
 	}
-} // CExtension::SetFileExtension
+
+	// all is good
+	return 0;
+
+} // Run
 
 /////////////////////////////////////////////////////////////////////////////
 // a console application that can crawl through the file
@@ -558,9 +1424,48 @@ int _tmain( int argc, TCHAR* argv[], TCHAR* envp[] )
 		}
 	}
 
+	// the settings of the run which are only read once processing starts
+	CRunConfig config;
+
+	// separate the options from the positional parameters
+	vector<string> arrOptions;
+	for ( const CString& csArg : arrArgs )
+	{
+		arrOptions.push_back( (LPCTSTR)csArg );
+	}
+
+	string csError;
+	if ( !config.ParseOptions( arrOptions, csError ) )
+	{
+		fOut.WriteString( _T( ".\n" ) );
+		fOut.WriteString( CString( csError.c_str() ) + _T( "\n" ) );
+		fOut.WriteString( _T( ".\n" ) );
+		nArgs = 0;
+
+	} else
+	{
+		arrArgs.clear();
+		for ( const string& csArg : arrOptions )
+		{
+			arrArgs.push_back( CString( csArg.c_str() ) );
+		}
+		nArgs = arrArgs.size();
+	}
+
+	// applying a plan takes the files and dates from the plan
+	const bool bApply = !config.GetApply().empty();
+
+	// a list of files only needs the hour offset
+	const bool bFilesFrom = !config.GetFilesFrom().empty();
+
 	// if the expected number of parameters are not found
 	// give the user some usage information
-	if ( nArgs != 3 && nArgs != 4 )
+	if 
+	( 
+		bApply ? nArgs != 1 : 
+		bFilesFrom ? nArgs != 2 : 
+		nArgs != 3 && nArgs != 4 
+	)
 	{
 		fOut.WriteString( _T( ".\n" ) );
 		fOut.WriteString
@@ -574,7 +1479,9 @@ int _tmain( int argc, TCHAR* argv[], TCHAR* envp[] )
 			_T( ".\n" ) 
 			_T( "Usage:\n" )
 			_T( ".\n" )
-			_T( ".  OffsetHours pathname hour_offset [recurse_folders]\n" )
+			_T( ".  OffsetHours [options] pathname hour_offset [recurse_folders]\n" )
+			_T( ".  OffsetHours [options] --apply plan_file\n" )
+			_T( ".  OffsetHours [options] --files-from list_file hour_offset\n" )
 			_T( ".\n" )
 			_T( "Where:\n" )
 			_T( ".\n" )
@@ -613,10 +1520,66 @@ int _tmain( int argc, TCHAR* argv[], TCHAR* envp[] )
 			_T( ".    not fall into the same pattern and therefore\n" )
 			_T( ".    sub-folders will not be found by the search).\n" )
 		);
+		fOut.WriteString
+		(
+			_T( ".  options tune the pipeline of stages that process files:\n" )
+			_T( ".    --walk-threads n    folder enumeration threads\n" )
+			_T( ".    --read-threads n    header read and date parse threads\n" )
+			_T( ".    --offset-threads n  date offset threads\n" )
+			_T( ".    --write-threads n   patch and save threads\n" )
+			_T( ".    --queue-depth n     files waiting between stages\n" )
+			_T( ".    --queue-stats       report the queue backpressure\n" )
+			_T( ".    --verbosity level   quiet, summary or file (default)\n" )
+			_T( ".    --plan plan_file    write the planned changes to the\n" )
+			_T( ".                        file (- for the console) and do\n" )
+			_T( ".                        not write any images\n" )
+			_T( ".    --apply plan_file   apply the planned changes of a\n" )
+			_T( ".                        file written by --plan\n" )
+			_T( ".    --files-from file   process the files listed one per\n" )
+			_T( ".                        line or separated by NULs (- for\n" )
+			_T( ".                        the console) instead of a tree\n" )
+			_T( ".    --metrics           report the latency of each step\n" )
+			_T( ".                        at the end (or on Ctrl+Break)\n" )
+			_T( ".    --metrics-file file also write the latencies as JSON\n" )
+			_T( ".    --trace file        write a timeline of the run in the\n" )
+			_T( ".                        Trace Event format (chrome://tracing)\n" )
+			_T( ".    --journal file      skip the files the journal records\n" )
+			_T( ".                        as done and record this run's files\n" )
+			_T( ".    --journal-hash      also compare a hash of each file's\n" )
+			_T( ".                        EXIF header with the journal\n" )
+			_T( ".    --checkpoint file   keep checkpoints of the walk in the\n" )
+			_T( ".                        file so the run can be resumed\n" )
+			_T( ".    --checkpoint-seconds n  seconds between checkpoints\n" )
+			_T( ".    --resume            continue from the checkpoint file\n" )
+			_T( ".    --in-place          correct the images themselves instead\n" )
+			_T( ".                        of writing copies to Corrected folders\n" )
+		);
 		fOut.WriteString( _T( ".\n" ) );
 		return 3;
 	}
 
+	if ( bApply )
+	{
+		return Run( config );
+	}
+
+	// the files of a list are processed as the list is read
+	if ( bFilesFrom )
+	{
+		const double dHourOffset = _tstof( arrArgs[ 1 ] );
+		if ( !CRunConfig::GetValidHourOffset( dHourOffset ) )
+		{
+			csMessage.Format( _T( "Invalid hour offset: %s\n" ), arrArgs[ 1 ] );
+			fOut.WriteString( _T( ".\n" ) );
+			fOut.WriteString( csMessage );
+			fOut.WriteString( _T( ".\n" ) );
+			return 5;
+		}
+
+		config.SetHourOffset( dHourOffset );
+		return Run( config );
+	}
+
 	// display the executable path
 	//csMessage.Format( _T( "Executable pathname: %s\n" ), arrArgs[ 0 ] );
 	//fOut.WriteString( _T( ".\n" ) );
@@ -627,7 +1590,11 @@ int _tmain( int argc, TCHAR* argv[], TCHAR* envp[] )
 	CString csPathParameter = arrArgs[ 1 ];
 
 	// trim off any wild card data
-	const CString csFolder = CHelper::GetFolder( csPathParameter );
+	const CPathView path( (LPCTSTR)csPathParameter );
+	const CString csFolder
+	( 
+		path.GetFolder().data(), (int)path.GetFolder().length() 
+	);
 
 	// test for current folder character (a period)
 	bool bExists = csPathParameter == _T( "." );
@@ -666,9 +1633,9 @@ int _tmain( int argc, TCHAR* argv[], TCHAR* envp[] )
 	}
 
 	// get the number of hours to offset the date taken metadata
-	m_dHourOffset = _tstof( arrArgs[ 2 ] );
+	const double dHourOffset = _tstof( arrArgs[ 2 ] );
 
-	if ( NearlyEqual( m_dHourOffset, 0.0 ))
+	if ( !CRunConfig::GetValidHourOffset( dHourOffset ) )
 	{
 		csMessage.Format( _T( "Invalid hour offset: %s\n" ), arrArgs[ 2 ] );
 		fOut.WriteString( _T( ".\n" ) );
@@ -677,8 +1644,10 @@ int _tmain( int argc, TCHAR* argv[], TCHAR* envp[] )
 		return 5;
 	}
 
+	config.SetHourOffset( dHourOffset );
+
 	// default to no recursion through sub-folders
-	m_bRecurse = false;
+	bool bRecurse = false;
 
 	// test for the recursion parameter
 	if ( nArgs == 4 )
@@ -689,26 +1658,14 @@ int _tmain( int argc, TCHAR* argv[], TCHAR* envp[] )
 		// if the text is "true" the turn on recursion
 		if ( csRecurse == _T( "true" ))
 		{
-			m_bRecurse = true;
+			bRecurse = true;
 		}
 	}
 
-	// start up COM
-	AfxOleInit();
-	::CoInitialize( NULL );
-
-	// reference to GDI+
-	InitGdiplus();
-
-	// crawl through directory tree defined by the command line
-	// parameter trolling for image files
-	RecursePath( csPathParameter );
-
-	// clean up references to GDI+
-	TerminateGdiplus();
+	config.SetRecurse( bRecurse );
+	config.SetPathname( (LPCTSTR)csPathParameter );
 
-	// all is good
-	return 0;
+	return Run( config );
 
 } // _tmain
 
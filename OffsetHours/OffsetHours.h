@@ -4,11 +4,23 @@
 #pragma once
 
 #include "resource.h"
-#include "KeyedCollection.h"
+#include "FlatCollection.h"
+#include "ExifDate.h"
+#include "ExifReader.h"
+#include "LogSink.h"
+#include "Metrics.h"
+#include "PlanManifest.h"
+#include "RunConfig.h"
+#include "RunJournal.h"
+#include "Checkpoint.h"
+#include "FileClassifier.h"
+#include "FolderCache.h"
+#include "DateShifter.h"
 #include <comutil.h>
 #include <vector>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <gdiplus.h>
 #pragma comment(lib, "gdiplus.lib")
 #ifdef _DEBUG
@@ -20,6 +32,26 @@
 using namespace Gdiplus;
 using namespace std;
 
+/////////////////////////////////////////////////////////////////////////////
+// CString keys of a CFlatCollection are compared as views of their 
+// characters so they can be looked up without building a CString
+template<>
+class CKeyTraits<CString>
+{
+	// public definitions
+public:
+	// what the keys are compared as
+	typedef basic_string_view<TCHAR> VIEW;
+
+	// public methods
+public:
+	// the view of a key
+	static inline VIEW GetView( const CString& key )
+	{
+		return VIEW( (LPCTSTR)key, (size_t)key.GetLength() );
+	}
+};
+
 /////////////////////////////////////////////////////////////////////////////
 // this class records the date and time information in each image file 
 // referenced
@@ -78,23 +110,19 @@ protected:
 	bool m_bOkay;
 
 	// rapid month lookup
-	CKeyedCollection<CString, int> m_MonthLookup;
+	CFlatCollection<CString, int> m_MonthLookup;
 
 	// public properties
 public:
 	// date and time formatted as a string
 	inline CString GetDate()
 	{
-		CString value;
-		COleDateTime oDT = DateAndTime;
-		COleDateTime::DateTimeStatus eStatus = oDT.GetStatus();
-		bool bOkay = COleDateTime::DateTimeStatus::valid == eStatus;
-
-		// if the status is good, format into a string
-		if ( bOkay )
+		// if the fields are good, format into a string
+		if ( Okay )
 		{
-			value = oDT.Format( _T( "%Y:%m:%d %H:%M:%S" ) );
-			m_csDate = value;
+			char szDate[ 20 ];
+			CExifDate::Format( Fields, szDate );
+			m_csDate = szDate;
 		}
 
 		return m_csDate;
@@ -198,12 +226,11 @@ public:
 	__declspec( property( get = GetSecond, put = SetSecond ) )
 		int Second;
 
-	// boolean indicator that all is well
+	// boolean indicator that all is well which checks the fields
+	// against the calendar without building a COleDateTime
 	inline bool GetOkay()
 	{
-		COleDateTime oDT( Year, Month, Day, Hour, Minute, Second );
-		COleDateTime::DateTimeStatus eStatus = oDT.GetStatus();
-		Okay = COleDateTime::DateTimeStatus::valid == eStatus;
+		Okay = CExifDate::IsValid( Fields );
 		return m_bOkay;
 	}
 	// boolean indicator that all is well
@@ -215,6 +242,29 @@ public:
 	__declspec( property( get = GetOkay, put = SetOkay ) )
 		bool Okay;
 
+	// the date and time as plain fields
+	inline DATE_FIELDS GetFields()
+	{
+		const DATE_FIELDS value = 
+		{ 
+			Year, Month, Day, Hour, Minute, Second 
+		};
+		return value;
+	}
+	// the date and time as plain fields
+	inline void SetFields( const DATE_FIELDS& value )
+	{
+		Year = value.m_nYear;
+		Month = value.m_nMonth;
+		Day = value.m_nDay;
+		Hour = value.m_nHour;
+		Minute = value.m_nMinute;
+		Second = value.m_nSecond;
+	}
+	// the date and time as plain fields
+	__declspec( property( get = GetFields, put = SetFields ) )
+		DATE_FIELDS Fields;
+
 	// gets the date and time from the properties
 	inline COleDateTime GetDateAndTime()
 	{
@@ -275,15 +325,20 @@ public:
 		int value = 0;
 
 		// the key is the first three characters in lower case
-		const CString csKey = month.Left( 3 ).MakeLower();
-
-		// if the key exists in the cross reference, then lookup the
-		// month of the year (1..12)
-		if ( m_MonthLookup.Exists[ csKey ] )
+		TCHAR szKey[ 3 ];
+		const int nKey = min( month.GetLength(), 3 );
+		for ( int nChar = 0; nChar < nKey; nChar++ )
 		{
-			value = *m_MonthLookup.find( csKey );
+			szKey[ nChar ] = (TCHAR)_totlower( month[ nChar ] );
 		}
 
+		// lookup the month of the year (1..12) in the cross reference
+		// by a view of the key so no string is allocated
+		m_MonthLookup.try_find
+		( 
+			CKeyTraits<CString>::VIEW( szKey, (size_t)nKey ), value 
+		);
+
 		return value;
 	}
 
@@ -316,11 +371,7 @@ public:
 		const int nMonths = _countof( months );
 		for ( int nMonth = 0; nMonth < nMonths; nMonth++ )
 		{
-			m_MonthLookup.add
-			( 
-				months[ nMonth ], 
-				new int( nMonth + 1 )
-			);
+			m_MonthLookup.add( months[ nMonth ], nMonth + 1 );
 		}
 
 		Okay = false;
@@ -328,162 +379,195 @@ public:
 };
 
 ////////////////////////////////////////////////////////////////////////////
-// this class creates a fast look up of the mime type and class ID as 
-// defined by GDI+ for common file extensions
-class CExtension
+// this class knows how each kind of image is written: whether its dates
+// are patched natively and which GDI+ encoder saves it otherwise. It is
+// built once when GDI+ has started and is only read after that, so every
+// writer thread shares it without locks and a file needs a single lookup
+// of its kind to find its codec.
+class CCodecRegistry
 {
-	// protected definitions
-protected:
-	typedef struct tagExtensionLookup
+	// public definitions
+public:
+	// how the images of one kind are written
+	typedef struct tagCodec
 	{
-		CString m_csFileExtension;
-		CString m_csMimeType;
+		// the kind of image
+		CFileClassifier::FILE_KIND m_eKind;
 
-	} EXTENSION_LOOKUP;
+		// true if the dates are patched without decoding the image
+		bool m_bNative;
 
-	typedef struct tagClassLookup
-	{
-		CString m_csMimeType;
-		CLSID m_ClassID;
+		// the mime type of the kind's GDI+ encoder
+		LPCWSTR m_pcwszMimeType;
 
-	} CLASS_LOOKUP;
+		// true if GDI+ has an encoder for the kind
+		bool m_bEncoder;
 
-	// protected data
-protected:
-	// current file extension
-	CString m_csFileExtension;
-
-	// current mime type
-	CString m_csMimeType;
+		// the class ID of the GDI+ encoder
+		CLSID m_ClassID;
 
-	// current class ID
-	CLSID m_ClassID;
+	} CODEC;
 
-	// cross reference of file extensions to mime types
-	CKeyedCollection<CString, CString> m_mapExtensions;
+	// protected definitions
+protected:
+	// one slot for each kind of image
+	static const int m_nKinds = CFileClassifier::fkRaw + 1;
 
-	// cross reference of mime types to class IDs
-	CKeyedCollection<CString, CLSID> m_mapMimeTypes;
+	// protected data
+protected:
+	// the codecs in the order of their kinds
+	CODEC m_Codecs[ m_nKinds ];
 
-	// public properties
+	// public methods
 public:
-	// current file extension
-	inline CString GetFileExtension()
-	{
-		return m_csFileExtension;
-	}
-	// current file extension
-	void SetFileExtension( CString value );
-	// current file extension
-	__declspec( property( get = GetFileExtension, put = SetFileExtension ) )
-		CString FileExtension;
+	// look up the GDI+ encoders of the kinds of image, which must be done
+	// once after GDI+ has started and before any lookup, and return false
+	// if the encoders could not be listed
+	bool Build();
 
-	// image extension associated with the current file extension
-	inline CString GetMimeType()
-	{
-		return m_csMimeType;
-	}
-	// image extension associated with the current file extension
-	inline void SetMimeType( CString value )
+	// the codec of a kind of image
+	inline const CODEC& GetCodec( CFileClassifier::FILE_KIND eKind ) const
 	{
-		m_csMimeType = value;
+		const int nKind = (int)eKind;
+		return m_Codecs[ nKind >= 0 && nKind < m_nKinds ? nKind : 0 ];
 	}
-	// get image extension associated with the current file extension
-	__declspec( property( get = GetMimeType, put = SetMimeType ) )
-		CString MimeType;
 
-	// class ID associated with the current file extension
-	inline CLSID GetClassID()
+	// the codec of a file extension (with or without its dot)
+	inline const CODEC& GetCodec( const char* pcszExt ) const
 	{
-		return m_ClassID;
+		return GetCodec( CFileClassifier::GetKind( pcszExt ) );
 	}
-	// class ID associated with the current file extension
-	inline void SetClassID( CLSID value )
-	{
-		m_ClassID = value;
-	}
-	// class ID associated with the current file extension
-	__declspec( property( get = GetClassID, put = SetClassID ) )
-		CLSID ClassID;
-
-	// public methods
-public:
-
-	// protected methods
-protected:
-
-	// public virtual methods
-public:
-
-	// protected virtual methods
-protected:
 
 	// public construction
 public:
-	CExtension()
+	CCodecRegistry()
 	{
-		// extension conversion table
-		static EXTENSION_LOOKUP ExtensionLookup[] =
+		// the kinds of image with the mime types of their encoders
+		static const struct
 		{
-			{ _T( ".bmp" ), _T( "image/bmp" ) },
-			{ _T( ".dib" ), _T( "image/bmp" ) },
-			{ _T( ".rle" ), _T( "image/bmp" ) },
-			{ _T( ".gif" ), _T( "image/gif" ) },
-			{ _T( ".jpeg" ), _T( "image/jpeg" ) },
-			{ _T( ".jpg" ), _T( "image/jpeg" ) },
-			{ _T( ".jpe" ), _T( "image/jpeg" ) },
-			{ _T( ".jfif" ), _T( "image/jpeg" ) },
-			{ _T( ".png" ), _T( "image/png" ) },
-			{ _T( ".tiff" ), _T( "image/tiff" ) },
-			{ _T( ".tif" ), _T( "image/tiff" ) }
-		};
+			CFileClassifier::FILE_KIND m_eKind;
+			bool m_bNative;
+			LPCWSTR m_pcwszMimeType;
 
-		// build a cross reference of file extensions to 
-		// mime types
-		const int nPairs = _countof( ExtensionLookup );
-		for ( int nPair = 0; nPair < nPairs; nPair++ )
+		} CodecLookup[] =
 		{
-			const CString csKey =
-				ExtensionLookup[ nPair ].m_csFileExtension;
-
-			CString* pValue = new CString
-			(
-				ExtensionLookup[ nPair ].m_csMimeType
-			);
+			{ CFileClassifier::fkNone, false, L"" },
+			{ CFileClassifier::fkJpeg, true, L"image/jpeg" },
+			{ CFileClassifier::fkPng, true, L"image/png" },
+			{ CFileClassifier::fkGif, false, L"image/gif" },
+			{ CFileClassifier::fkBmp, false, L"image/bmp" },
+			{ CFileClassifier::fkTiff, true, L"image/tiff" },
+			{ CFileClassifier::fkRaw, true, L"" },
+		};
+		static_assert
+		( 
+			_countof( CodecLookup ) == m_nKinds, "a kind of image has no codec" 
+		);
 
-			// add the pair to the collection
-			m_mapExtensions.add( csKey, pValue );
+		for ( const auto& lookup : CodecLookup )
+		{
+			CODEC& codec = m_Codecs[ lookup.m_eKind ];
+			codec.m_eKind = lookup.m_eKind;
+			codec.m_bNative = lookup.m_bNative;
+			codec.m_pcwszMimeType = lookup.m_pcwszMimeType;
+			codec.m_bEncoder = false;
+			codec.m_ClassID = CLSID_NULL;
 		}
 	}
 };
 
+////////////////////////////////////////////////////////////////////////////
+// the processing context of one image file. Everything that changes while
+// a file is processed lives here and belongs to the one thread working on
+// the file, so several files can be in flight without any locks.
+typedef struct tagFileContext
+{
+	// the pathname of the image file
+	CString m_csPath;
+
+	// the kind of image the file is from its extension and then from 
+	// its first bytes once they are read
+	CFileClassifier::FILE_KIND m_eKind;
+
+	// the dates and their locations in the EXIF header (JPEG files)
+	CExifReader m_Reader;
+
+	// the image opened by GDI+ to read the dates (other formats) which
+	// is kept for the write stage
+	unique_ptr<Gdiplus::Image> m_pImage;
+
+	// the date taken which is offset by the offset stage
+	CDate m_Date;
+
+	// the date taken found in the file
+	CString m_csOldDate;
+
+	// the new date taken in "YYYY:MM:DD HH:MM:SS" format
+	CString m_csDate;
+
+	// the outcome recorded in a plan (one of the CPlanManifest values)
+	const char* m_pcszStatus;
+
+	// true when the file comes from a plan being applied
+	bool m_bPlanned;
+
+	// the old and new dates of the plan being applied
+	CString m_csPlannedOld;
+	CString m_csPlannedNew;
+
+	// the size and time stamp of the file when it was read, which is
+	// recorded in the journal (only set when there is a journal)
+	FILE_STAMP m_Stamp;
+	bool m_bStamped;
+
+	// the output reported for the file, written when it leaves the 
+	// pipeline so the output of files in flight does not interleave
+	CString m_csLog;
+
+} FILE_CONTEXT;
+
 ////////////////////////////////////////////////////////////////////////////
 // used for Gdiplus library
 ULONG_PTR m_gdiplusToken;
 
-/////////////////////////////////////////////////////////////////////////////
-// this class records the date and time information in each image file 
-// referenced
-CDate m_Date;
+////////////////////////////////////////////////////////////////////////////
+// how each kind of image is written (built once GDI+ has started)
+CCodecRegistry m_Codecs;
+
+////////////////////////////////////////////////////////////////////////////
+// buffers the output of every thread and writes it in large blocks
+CLogSink m_Log;
+
+////////////////////////////////////////////////////////////////////////////
+// the manifest of a dry run (only opened with the --plan option)
+CLogSink m_Plan( nullptr );
+
+////////////////////////////////////////////////////////////////////////////
+// the files done by earlier runs (only opened with the --journal option)
+CRunJournal m_Journal;
+
+////////////////////////////////////////////////////////////////////////////
+// the progress of the walk (only kept with the --checkpoint option)
+CCheckpoint m_Checkpoint;
 
 ////////////////////////////////////////////////////////////////////////////
-// this class creates a fast look up of the mime type and class ID as 
-// defined by GDI+ for common file extensions
-CExtension m_Extension;
+// the corrected folders that have been created during the run
+CFolderCache m_CorrectedFolders;
 
 ////////////////////////////////////////////////////////////////////////////
-// the number of hours the date taken metadata will be offset
-double m_dHourOffset;
+// the latency of the hot spots of the run (only enabled by the --metrics
+// option)
+CMetrics m_Metrics;
 
 ////////////////////////////////////////////////////////////////////////////
-// when true, sub-folders will be processed as well as the base folder
-bool m_bRecurse;
+// set by the signal handler to report the metrics while the run is going
+atomic<bool> m_bReportMetrics( false );
 
 /////////////////////////////////////////////////////////////////////////////
 // the new folder under the image folder to contain the corrected images
 static inline CString GetCorrectedFolder()
 {
-	return _T( "Corrected" );
+	return CString( CDateShifter::GetCorrectedFolder() );
 }
 
 /////////////////////////////////////////////////////////////////////////////
@@ -502,7 +586,14 @@ static inline int GetCorrectedFolderLength()
 // returns true if the path is created or already exists
 bool CreatePath( LPCTSTR pszPath )
 {
-	if ( ERROR_SUCCESS == SHCreateDirectoryEx( NULL, pszPath, NULL ) )
+	// another thread may have created the folder first
+	const int nResult = SHCreateDirectoryEx( NULL, pszPath, NULL );
+	if 
+	( 
+		ERROR_SUCCESS == nResult || 
+		ERROR_ALREADY_EXISTS == nResult || 
+		ERROR_FILE_EXISTS == nResult 
+	)
 	{
 		return true;
 	}
@@ -0,0 +1,153 @@
+/////////////////////////////////////////////////////////////////////////////
+// Copyright  by W. T. Block, all rights reserved
+/////////////////////////////////////////////////////////////////////////////
+#pragma once
+#include <stddef.h>
+#include <string_view>
+
+using namespace std;
+
+/////////////////////////////////////////////////////////////////////////////
+// this class splits a pathname into its drive, directory, file name and
+// extension the way _tsplitpath does, but with a single scan from the end
+// of the path and without copying it: each part is a view of the caller's
+// characters, which must outlive the view. On Windows either kind of
+// slash separates the folders and a leading "X:" is the drive, while on
+// other platforms only a slash is a separator and there is no drive,
+// since a backslash or a colon is an ordinary character of a name there.
+class CPathView
+{
+	// protected data
+protected:
+	// the whole pathname
+	string_view m_Path;
+
+	// the length of the drive ("C:" or empty)
+	size_t m_tDrive;
+
+	// where the data name (file name and extension) starts
+	size_t m_tName;
+
+	// where the extension (with its dot) starts or the length of the
+	// path when there is none
+	size_t m_tExt;
+
+	// protected methods
+protected:
+	// true for a separator of the platform's folders
+	static inline bool GetSeparator( char cValue )
+	{
+#ifdef _WIN32
+		return cValue == '\\' || cValue == '/';
+#else
+		return cValue == '/';
+#endif
+	}
+
+	// find the extension in the data name which starts at m_tName
+	void SplitName()
+	{
+		const size_t tLength = m_Path.length();
+		m_tExt = tLength;
+		for ( size_t tChar = tLength; tChar > m_tName; tChar-- )
+		{
+			if ( m_Path[ tChar - 1 ] == '.' )
+			{
+				m_tExt = tChar - 1;
+				break;
+			}
+		}
+
+#ifdef _WIN32
+		m_tDrive = m_Path.length() >= 2 && m_Path[ 1 ] == ':' ? 2 : 0;
+#else
+		m_tDrive = 0;
+#endif
+		if ( m_tDrive > m_tName )
+		{
+			m_tName = m_tDrive;
+			m_tExt = m_tExt < m_tName ? tLength : m_tExt;
+		}
+	}
+
+	// public properties
+public:
+	// the whole pathname
+	inline string_view GetPath() const
+	{
+		return m_Path;
+	}
+
+	// the drive ("C:" or empty)
+	inline string_view GetDrive() const
+	{
+		return m_Path.substr( 0, m_tDrive );
+	}
+
+	// the directory after the drive with its trailing separator
+	inline string_view GetDirectory() const
+	{
+		return m_Path.substr( m_tDrive, m_tName - m_tDrive );
+	}
+
+	// the drive and directory with the trailing separator
+	inline string_view GetFolder() const
+	{
+		return m_Path.substr( 0, m_tName );
+	}
+
+	// the file name without its extension
+	inline string_view GetFileName() const
+	{
+		return m_Path.substr( m_tName, m_tExt - m_tName );
+	}
+
+	// the extension with its dot (empty when there is none)
+	inline string_view GetExtension() const
+	{
+		return m_Path.substr( m_tExt );
+	}
+
+	// the file name and extension
+	inline string_view GetDataName() const
+	{
+		return m_Path.substr( m_tName );
+	}
+
+	// public construction
+public:
+	// split a pathname scanning back from its end for the last separator
+	// and the last dot after it
+	CPathView( string_view path )
+	{
+		m_Path = path;
+		m_tName = 0;
+		for ( size_t tChar = path.length(); tChar > 0; tChar-- )
+		{
+			if ( GetSeparator( path[ tChar - 1 ] ) )
+			{
+				m_tName = tChar;
+				break;
+			}
+		}
+		SplitName();
+	}
+
+	// split a null terminated pathname
+	CPathView( const char* pcszPath ) :
+		CPathView( string_view( pcszPath ) )
+	{
+	}
+
+	// split a pathname whose data name is known to start at the given
+	// position, as it is when the caller has just appended the name to
+	// its folder, so only the name is scanned
+	CPathView( string_view path, size_t tName )
+	{
+		m_Path = path;
+		m_tName = tName < path.length() ? tName : path.length();
+		SplitName();
+	}
+};
+
+/////////////////////////////////////////////////////////////////////////////
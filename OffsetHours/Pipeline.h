@@ -0,0 +1,367 @@
+/////////////////////////////////////////////////////////////////////////////
+// Copyright  by W. T. Block, all rights reserved
+/////////////////////////////////////////////////////////////////////////////
+#pragma once
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/////////////////////////////////////////////////////////////////////////////
+// a bounded multiple producer / multiple consumer queue that connects two
+// stages of a pipeline. Each cell carries a sequence number so producers
+// and consumers claim cells with a single compare and swap and never take
+// a lock. A producer that finds the queue full waits, which slows the
+// upstream stage down to the pace of the downstream stage (backpressure),
+// and the number of times that happens is counted so the worker counts
+// of the stages can be balanced.
+template<class TYPE>
+class CBoundedQueue
+{
+	// protected definitions
+protected:
+	typedef struct tagCell
+	{
+		// the position the cell is ready for
+		atomic<size_t> m_tSequence;
+
+		// the value stored in the cell
+		TYPE m_Value;
+
+	} CELL;
+
+	// protected data
+protected:
+	// ring of cells (a power of 2 in size)
+	unique_ptr<CELL[]> m_Cells;
+
+	// size of the ring less one
+	size_t m_tMask;
+
+	// the next position to be written (on its own cache line)
+	alignas( 64 ) atomic<size_t> m_tEnqueue;
+
+	// the next position to be read (on its own cache line)
+	alignas( 64 ) atomic<size_t> m_tDequeue;
+
+	// set when the producers are finished
+	alignas( 64 ) atomic<bool> m_bClosed;
+
+	// the number of values pushed
+	atomic<unsigned long long> m_ullPushes;
+
+	// the number of pushes that found the queue full
+	atomic<unsigned long long> m_ullFullWaits;
+
+	// the number of pops that found the queue empty
+	atomic<unsigned long long> m_ullEmptyWaits;
+
+	// the largest number of values waiting in the queue
+	atomic<size_t> m_tHighWater;
+
+	// protected methods
+protected:
+	// back off while waiting on another stage, spinning briefly and
+	// then sleeping so idle workers do not steal time from busy ones
+	static inline void Wait( int& nSpins )
+	{
+		if ( ++nSpins < 64 )
+		{
+			this_thread::yield();
+
+		} else
+		{
+			this_thread::sleep_for( chrono::microseconds( 100 ) );
+		}
+	}
+
+	// public properties
+public:
+	// the number of values pushed
+	inline unsigned long long GetPushes() const
+	{
+		return m_ullPushes;
+	}
+
+	// the number of pushes that found the queue full (the downstream
+	// stage could not keep up)
+	inline unsigned long long GetFullWaits() const
+	{
+		return m_ullFullWaits;
+	}
+
+	// the number of pops that found the queue empty (the upstream
+	// stage could not keep up)
+	inline unsigned long long GetEmptyWaits() const
+	{
+		return m_ullEmptyWaits;
+	}
+
+	// the largest number of values that were waiting in the queue
+	inline size_t GetHighWater() const
+	{
+		return m_tHighWater;
+	}
+
+	// the number of cells in the ring
+	inline size_t GetCapacity() const
+	{
+		return m_tMask + 1;
+	}
+
+	// the number of values waiting in the queue (a sample which may be
+	// stale by the time it is used)
+	inline size_t GetSize() const
+	{
+		const size_t tDequeue = m_tDequeue.load( memory_order_relaxed );
+		const size_t tEnqueue = m_tEnqueue.load( memory_order_relaxed );
+		return tEnqueue > tDequeue ? tEnqueue - tDequeue : 0;
+	}
+
+	// public methods
+public:
+	// push a value if there is room without waiting
+	bool TryPush( const TYPE& value )
+	{
+		size_t tPos = m_tEnqueue.load( memory_order_relaxed );
+		CELL* pCell = nullptr;
+
+		do
+		{
+			pCell = &m_Cells[ tPos & m_tMask ];
+			const size_t tSequence =
+				pCell->m_tSequence.load( memory_order_acquire );
+			const intptr_t nDiff = (intptr_t)tSequence - (intptr_t)tPos;
+
+			if ( nDiff == 0 )
+			{
+				if
+				(
+					m_tEnqueue.compare_exchange_weak
+					(
+						tPos, tPos + 1, memory_order_relaxed
+					)
+				)
+				{
+					break;
+				}
+
+			} else if ( nDiff < 0 ) // full
+			{
+				return false;
+
+			} else // another producer claimed the cell
+			{
+				tPos = m_tEnqueue.load( memory_order_relaxed );
+			}
+
+		} while ( true );
+
+		pCell->m_Value = value;
+		pCell->m_tSequence.store( tPos + 1, memory_order_release );
+
+		m_ullPushes.fetch_add( 1, memory_order_relaxed );
+		const size_t tWaiting =
+			tPos + 1 - m_tDequeue.load( memory_order_relaxed );
+		size_t tHigh = m_tHighWater.load( memory_order_relaxed );
+		while
+		(
+			tWaiting > tHigh && tWaiting <= GetCapacity() &&
+			!m_tHighWater.compare_exchange_weak( tHigh, tWaiting )
+		)
+		{
+		}
+
+		return true;
+	}
+
+	// pop a value if one is waiting without waiting
+	bool TryPop( TYPE& value )
+	{
+		size_t tPos = m_tDequeue.load( memory_order_relaxed );
+		CELL* pCell = nullptr;
+
+		do
+		{
+			pCell = &m_Cells[ tPos & m_tMask ];
+			const size_t tSequence =
+				pCell->m_tSequence.load( memory_order_acquire );
+			const intptr_t nDiff = (intptr_t)tSequence - (intptr_t)( tPos + 1 );
+
+			if ( nDiff == 0 )
+			{
+				if
+				(
+					m_tDequeue.compare_exchange_weak
+					(
+						tPos, tPos + 1, memory_order_relaxed
+					)
+				)
+				{
+					break;
+				}
+
+			} else if ( nDiff < 0 ) // empty
+			{
+				return false;
+
+			} else // another consumer claimed the cell
+			{
+				tPos = m_tDequeue.load( memory_order_relaxed );
+			}
+
+		} while ( true );
+
+		value = pCell->m_Value;
+		pCell->m_tSequence.store( tPos + m_tMask + 1, memory_order_release );
+		return true;
+	}
+
+	// push a value waiting for room if the queue is full
+	void Push( const TYPE& value )
+	{
+		if ( TryPush( value ) )
+		{
+			return;
+		}
+
+		m_ullFullWaits.fetch_add( 1, memory_order_relaxed );
+		int nSpins = 0;
+		while ( !TryPush( value ) )
+		{
+			Wait( nSpins );
+		}
+	}
+
+	// pop a value waiting for one if the queue is empty, returning
+	// false once the queue is closed and drained
+	bool Pop( TYPE& value )
+	{
+		if ( TryPop( value ) )
+		{
+			return true;
+		}
+
+		m_ullEmptyWaits.fetch_add( 1, memory_order_relaxed );
+		int nSpins = 0;
+		do
+		{
+			if ( m_bClosed.load( memory_order_acquire ) )
+			{
+				// a value may have been pushed just before closing
+				return TryPop( value );
+			}
+
+			Wait( nSpins );
+
+		} while ( !TryPop( value ) );
+
+		return true;
+	}
+
+	// called by the upstream stage when it will push no more values
+	void Close()
+	{
+		m_bClosed.store( true, memory_order_release );
+	}
+
+	// public construction
+public:
+	// the capacity is rounded up to a power of 2
+	CBoundedQueue( size_t tCapacity )
+	{
+		size_t tSize = 2;
+		while ( tSize < tCapacity )
+		{
+			tSize <<= 1;
+		}
+
+		m_Cells = unique_ptr<CELL[]>( new CELL[ tSize ] );
+		for ( size_t tCell = 0; tCell < tSize; tCell++ )
+		{
+			m_Cells[ tCell ].m_tSequence.store( tCell, memory_order_relaxed );
+		}
+
+		m_tMask = tSize - 1;
+		m_tEnqueue = 0;
+		m_tDequeue = 0;
+		m_bClosed = false;
+		m_ullPushes = 0;
+		m_ullFullWaits = 0;
+		m_ullEmptyWaits = 0;
+		m_tHighWater = 0;
+	}
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// runs the worker threads of one stage of a pipeline and calls a finish
+// function when the last of its workers returns, which is where the stage
+// closes its output queue so the next stage can drain and stop
+class CPipelineStage
+{
+	// protected data
+protected:
+	// the stage's worker threads
+	vector<thread> m_Threads;
+
+	// the number of workers that have not returned
+	atomic<int> m_nRunning;
+
+	// public methods
+public:
+	// start the given number of workers running the work function
+	void Start( int nWorkers, function<void()> work, function<void()> finish )
+	{
+		if ( nWorkers < 1 )
+		{
+			nWorkers = 1;
+		}
+
+		m_nRunning = nWorkers;
+		for ( int nWorker = 0; nWorker < nWorkers; nWorker++ )
+		{
+			m_Threads.push_back
+			(
+				thread
+				(
+					[ this, work, finish ]()
+					{
+						work();
+						if ( --m_nRunning == 0 )
+						{
+							finish();
+						}
+					}
+				)
+			);
+		}
+	}
+
+	// wait for all of the workers to return
+	void Join()
+	{
+		for ( thread& worker : m_Threads )
+		{
+			worker.join();
+		}
+		m_Threads.clear();
+	}
+
+	// public construction / destruction
+public:
+	CPipelineStage()
+	{
+		m_nRunning = 0;
+	}
+	~CPipelineStage()
+	{
+		Join();
+	}
+};
+
+/////////////////////////////////////////////////////////////////////////////
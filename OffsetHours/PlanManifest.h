@@ -0,0 +1,232 @@
+/////////////////////////////////////////////////////////////////////////////
+// Copyright  by W. T. Block, all rights reserved
+/////////////////////////////////////////////////////////////////////////////
+#pragma once
+#include <stdio.h>
+#include <string.h>
+#include <functional>
+#include <string>
+#include <string_view>
+
+using namespace std;
+
+/////////////////////////////////////////////////////////////////////////////
+// one line of a plan: a file, its date taken before and after the offset
+// and what the run did or would do with it
+typedef struct tagPlanEntry
+{
+	// the full pathname of the image
+	string m_csPath;
+
+	// the date taken found in the file (empty if missing)
+	string m_csOld;
+
+	// the date taken after the offset (empty if not computed)
+	string m_csNew;
+
+	// the outcome for the file (see CPlanManifest)
+	string m_csStatus;
+
+} PLAN_ENTRY;
+
+/////////////////////////////////////////////////////////////////////////////
+// this class reads and writes the manifest of a dry run which has one
+// tab separated line per file: "path<TAB>old<TAB>new<TAB>status". Lines
+// beginning with '#' are comments. Tabs, line breaks and percent signs in
+// a path are encoded so every entry is exactly one line, which lets the
+// manifest be streamed, sampled with ordinary text tools and fed to a
+// later run that applies it.
+class CPlanManifest
+{
+	// public definitions
+public:
+	// the date would be changed (the only status that is applied)
+	static constexpr const char* PLANNED = "planned";
+
+	// the file has no date taken
+	static constexpr const char* MISSING = "missing";
+
+	// the date taken cannot be parsed
+	static constexpr const char* INVALID = "invalid";
+
+	// the new date would be outside of the supported years
+	static constexpr const char* RANGE = "out-of-range";
+
+	// the date taken no longer matches the plan being applied
+	static constexpr const char* CHANGED = "changed";
+
+	// the file has not changed since the run recorded in the journal
+	static constexpr const char* UNCHANGED = "unchanged";
+
+	// called for each entry read from a manifest
+	typedef function<void( const PLAN_ENTRY& entry )> ENTRY_CALLBACK;
+
+	// public methods
+public:
+	// append a path with its tabs, line breaks and percent signs encoded
+	// as "%XX", which leaves the folder separators of Windows readable
+	static void Escape( string_view value, string& csLine )
+	{
+		static const char hex[] = "0123456789ABCDEF";
+		for ( const char cValue : value )
+		{
+			if ( cValue == '\t' || cValue == '\n' || cValue == '\r' || cValue == '%' )
+			{
+				csLine += '%';
+				csLine += hex[ ( cValue >> 4 ) & 0xF ];
+				csLine += hex[ cValue & 0xF ];
+
+			} else
+			{
+				csLine += cValue;
+			}
+		}
+	}
+
+	// the value of a hexadecimal digit or -1
+	static inline int GetHex( char cValue )
+	{
+		if ( cValue >= '0' && cValue <= '9' )
+		{
+			return cValue - '0';
+		}
+		if ( cValue >= 'A' && cValue <= 'F' )
+		{
+			return cValue - 'A' + 10;
+		}
+		if ( cValue >= 'a' && cValue <= 'f' )
+		{
+			return cValue - 'a' + 10;
+		}
+		return -1;
+	}
+
+	// the reverse of Escape
+	static string Unescape( string_view value )
+	{
+		string csValue;
+		csValue.reserve( value.size() );
+
+		const size_t tLength = value.size();
+		for ( size_t tChar = 0; tChar < tLength; tChar++ )
+		{
+			char cValue = value[ tChar ];
+			if ( cValue == '%' && tChar + 2 < tLength )
+			{
+				const int nHigh = GetHex( value[ tChar + 1 ] );
+				const int nLow = GetHex( value[ tChar + 2 ] );
+				if ( nHigh >= 0 && nLow >= 0 )
+				{
+					cValue = (char)( nHigh * 16 + nLow );
+					tChar += 2;
+				}
+			}
+			csValue += cValue;
+		}
+
+		return csValue;
+	}
+
+	// the comment line that starts a manifest
+	static inline const char* GetHeader()
+	{
+		return "# path\told date\tnew date\tstatus\n";
+	}
+
+	// format an entry as a line of the manifest ending with a line break
+	static void Format( const PLAN_ENTRY& entry, string& csLine )
+	{
+		csLine.clear();
+		Escape( entry.m_csPath, csLine );
+		csLine += '\t';
+		csLine += entry.m_csOld;
+		csLine += '\t';
+		csLine += entry.m_csNew;
+		csLine += '\t';
+		csLine += entry.m_csStatus;
+		csLine += '\n';
+	}
+
+	// parse a line of the manifest without its line break, returning
+	// false for comments, blank lines and lines without four fields
+	static bool Parse( string_view line, PLAN_ENTRY& entry )
+	{
+		if ( !line.empty() && line.back() == '\r' )
+		{
+			line.remove_suffix( 1 );
+		}
+		if ( line.empty() || line[ 0 ] == '#' )
+		{
+			return false;
+		}
+
+		string_view fields[ 4 ];
+		for ( int nField = 0; nField < 3; nField++ )
+		{
+			const size_t tTab = line.find( '\t' );
+			if ( tTab == string_view::npos )
+			{
+				return false;
+			}
+			fields[ nField ] = line.substr( 0, tTab );
+			line.remove_prefix( tTab + 1 );
+		}
+		fields[ 3 ] = line;
+
+		entry.m_csPath = Unescape( fields[ 0 ] );
+		entry.m_csOld = fields[ 1 ];
+		entry.m_csNew = fields[ 2 ];
+		entry.m_csStatus = fields[ 3 ];
+		return !entry.m_csPath.empty();
+	}
+
+	// stream the entries of the manifest to the callback one line at a
+	// time, returning false if the manifest cannot be opened
+	static bool Read( const char* pcszPath, ENTRY_CALLBACK callback )
+	{
+		FILE* pFile = fopen( pcszPath, "rb" );
+		if ( pFile == nullptr )
+		{
+			return false;
+		}
+
+		PLAN_ENTRY entry;
+		string csLine;
+		char buffer[ 64 * 1024 ];
+		size_t tRead = 0;
+		while ( ( tRead = fread( buffer, 1, sizeof( buffer ), pFile ) ) > 0 )
+		{
+			const char* pStart = buffer;
+			const char* pEnd = buffer + tRead;
+			while ( pStart < pEnd )
+			{
+				const char* pBreak =
+					(const char*)memchr( pStart, '\n', pEnd - pStart );
+				if ( pBreak == nullptr )
+				{
+					csLine.append( pStart, pEnd );
+					break;
+				}
+
+				csLine.append( pStart, pBreak );
+				if ( Parse( csLine, entry ) )
+				{
+					callback( entry );
+				}
+				csLine.clear();
+				pStart = pBreak + 1;
+			}
+		}
+
+		// the last line may not end with a line break
+		if ( Parse( csLine, entry ) )
+		{
+			callback( entry );
+		}
+
+		fclose( pFile );
+		return true;
+	}
+};
+
+/////////////////////////////////////////////////////////////////////////////
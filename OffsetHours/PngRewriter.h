@@ -0,0 +1,352 @@
+/////////////////////////////////////////////////////////////////////////////
+// Copyright  by W. T. Block, all rights reserved
+/////////////////////////////////////////////////////////////////////////////
+#pragma once
+#include "Crc32.h"
+#include "ExifReader.h"
+#include "FileClone.h"
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+using namespace std;
+
+/////////////////////////////////////////////////////////////////////////////
+// this class writes a copy of a PNG file whose eXIf chunk lacks one of
+// the original and digitized dates, with an eXIf chunk that holds both.
+// The EXIF data of the existing chunk is kept byte for byte and new 
+// copies of IFD0 and the EXIF sub-IFD holding the dates are appended to
+// it, so every offset in the old data stays valid. The chunks before 
+// and after the eXIf chunk, including the image data, are copied 
+// through by the kernel where it can without being parsed; only the new
+// chunk has its CRC computed. A PNG file without an eXIf chunk has no 
+// date to shift and is never rewritten.
+class CPngRewriter
+{
+	// protected definitions
+protected:
+	// a directory entry with its value or offset in the file's byte order
+	typedef struct tagEntry
+	{
+		unsigned short m_usTag;
+		unsigned short m_usType;
+		unsigned long m_ulCount;
+		unsigned char m_Value[ 4 ];
+
+	} ENTRY;
+
+	// protected data
+protected:
+	// true for Intel (little endian) byte order, false for Motorola
+	bool m_bIntel;
+
+	// the EXIF data being built
+	vector<unsigned char> m_Tiff;
+
+	// protected methods
+protected:
+	// read an unsigned 16 bit value of the EXIF data
+	inline unsigned short GetShort( size_t tPos ) const
+	{
+		const unsigned char* p = m_Tiff.data() + tPos;
+		return m_bIntel ?
+			(unsigned short)( p[ 0 ] | p[ 1 ] << 8 ) :
+			(unsigned short)( p[ 0 ] << 8 | p[ 1 ] );
+	}
+
+	// read an unsigned 32 bit value of the EXIF data
+	inline unsigned long GetLong( size_t tPos ) const
+	{
+		const unsigned char* p = m_Tiff.data() + tPos;
+		return m_bIntel ?
+			(unsigned long)p[ 0 ] | (unsigned long)p[ 1 ] << 8 |
+			(unsigned long)p[ 2 ] << 16 | (unsigned long)p[ 3 ] << 24 :
+			(unsigned long)p[ 0 ] << 24 | (unsigned long)p[ 1 ] << 16 |
+			(unsigned long)p[ 2 ] << 8 | (unsigned long)p[ 3 ];
+	}
+
+	// store a 32 bit value in the file's byte order
+	inline void PutLong( unsigned char* p, unsigned long ulValue ) const
+	{
+		for ( int nByte = 0; nByte < 4; nByte++ )
+		{
+			p[ m_bIntel ? nByte : 3 - nByte ] = (unsigned char)( ulValue >> ( 8 * nByte ) );
+		}
+	}
+
+	// append a 16 or 32 bit value in the file's byte order
+	inline void AppendShort( unsigned short usValue )
+	{
+		const unsigned char value[ 2 ] =
+		{
+			(unsigned char)( m_bIntel ? usValue : usValue >> 8 ),
+			(unsigned char)( m_bIntel ? usValue >> 8 : usValue )
+		};
+		m_Tiff.insert( m_Tiff.end(), value, value + 2 );
+	}
+	inline void AppendLong( unsigned long ulValue )
+	{
+		unsigned char value[ 4 ];
+		PutLong( value, ulValue );
+		m_Tiff.insert( m_Tiff.end(), value, value + 4 );
+	}
+
+	// start appending on a word boundary as TIFF requires
+	inline void Align()
+	{
+		if ( m_Tiff.size() % 2 != 0 )
+		{
+			m_Tiff.push_back( 0 );
+		}
+	}
+
+	// read the entries of a directory and the offset of the next one,
+	// returning false if the directory is outside of the data
+	bool ReadDirectory( unsigned long ulIFD, vector<ENTRY>& entries, unsigned long& ulNext )
+	{
+		if ( ulIFD < 8 || (size_t)ulIFD + 2 > m_Tiff.size() )
+		{
+			return false;
+		}
+
+		const unsigned short usEntries = GetShort( ulIFD );
+		const size_t tEnd = (size_t)ulIFD + 2 + (size_t)usEntries * 12;
+		if ( tEnd + 4 > m_Tiff.size() )
+		{
+			return false;
+		}
+
+		for ( size_t tPos = ulIFD + 2; tPos < tEnd; tPos += 12 )
+		{
+			ENTRY entry;
+			entry.m_usTag = GetShort( tPos );
+			entry.m_usType = GetShort( tPos + 2 );
+			entry.m_ulCount = GetLong( tPos + 4 );
+			memcpy( entry.m_Value, m_Tiff.data() + tPos + 8, 4 );
+			entries.push_back( entry );
+		}
+		ulNext = GetLong( tEnd );
+		return true;
+	}
+
+	// append a directory with its entries in ascending order of tag as
+	// TIFF requires and return its offset
+	unsigned long AppendDirectory( vector<ENTRY>& entries, unsigned long ulNext )
+	{
+		sort
+		(
+			entries.begin(), entries.end(),
+			[]( const ENTRY& left, const ENTRY& right )
+			{
+				return left.m_usTag < right.m_usTag;
+			}
+		);
+
+		Align();
+		const unsigned long ulIFD = (unsigned long)m_Tiff.size();
+		AppendShort( (unsigned short)entries.size() );
+		for ( const ENTRY& entry : entries )
+		{
+			AppendShort( entry.m_usTag );
+			AppendShort( entry.m_usType );
+			AppendLong( entry.m_ulCount );
+			m_Tiff.insert( m_Tiff.end(), entry.m_Value, entry.m_Value + 4 );
+		}
+		AppendLong( ulNext );
+		return ulIFD;
+	}
+
+	// replace an entry of a directory or add it
+	void SetEntry( vector<ENTRY>& entries, const ENTRY& entry )
+	{
+		for ( ENTRY& existing : entries )
+		{
+			if ( existing.m_usTag == entry.m_usTag )
+			{
+				existing = entry;
+				return;
+			}
+		}
+		entries.push_back( entry );
+	}
+
+	// an entry of the given tag holding a 32 bit value
+	ENTRY GetLongEntry( unsigned short usTag, unsigned long ulValue ) const
+	{
+		ENTRY entry;
+		entry.m_usTag = usTag;
+		entry.m_usType = 4; // LONG
+		entry.m_ulCount = 1;
+		PutLong( entry.m_Value, ulValue );
+		return entry;
+	}
+
+	// build the EXIF data from the data of the existing chunk with both
+	// dates set to the given value
+	bool Build( const vector<unsigned char>& old, const char* pcszDate )
+	{
+		m_Tiff = old;
+		if
+		(
+			m_Tiff.size() < 8 ||
+			!( ( m_Tiff[ 0 ] == 'I' && m_Tiff[ 1 ] == 'I' ) ||
+			   ( m_Tiff[ 0 ] == 'M' && m_Tiff[ 1 ] == 'M' ) )
+		)
+		{
+			return false;
+		}
+
+		m_bIntel = m_Tiff[ 0 ] == 'I';
+		if ( GetShort( 2 ) != 42 )
+		{
+			return false;
+		}
+		unsigned long ulIFD0 = GetLong( 4 );
+
+		vector<ENTRY> ifd0;
+		unsigned long ulNext0 = 0;
+		if ( !ReadDirectory( ulIFD0, ifd0, ulNext0 ) )
+		{
+			return false;
+		}
+
+		vector<ENTRY> exif;
+		unsigned long ulNextExif = 0;
+		for ( const ENTRY& entry : ifd0 )
+		{
+			if ( entry.m_usTag == CExifReader::ttExifIFD )
+			{
+				unsigned long ulExif = 0;
+				for ( int nByte = 0; nByte < 4; nByte++ )
+				{
+					ulExif |= (unsigned long)entry.m_Value[ m_bIntel ? nByte : 3 - nByte ] << ( 8 * nByte );
+				}
+				if ( !ReadDirectory( ulExif, exif, ulNextExif ) )
+				{
+					return false;
+				}
+			}
+		}
+
+		// the dates with room for the terminating NUL
+		const unsigned short usTags[ 2 ] =
+		{
+			CExifReader::ttDTOrig, CExifReader::ttDTDigitized
+		};
+		for ( const unsigned short usTag : usTags )
+		{
+			Align();
+			ENTRY entry = GetLongEntry( usTag, (unsigned long)m_Tiff.size() );
+			entry.m_usType = 2; // ASCII
+			entry.m_ulCount = 20;
+			m_Tiff.insert( m_Tiff.end(), pcszDate, pcszDate + 20 );
+			SetEntry( exif, entry );
+		}
+
+		// the new directories replace the old ones which are left behind
+		const unsigned long ulExif = AppendDirectory( exif, ulNextExif );
+		SetEntry( ifd0, GetLongEntry( CExifReader::ttExifIFD, ulExif ) );
+		ulIFD0 = AppendDirectory( ifd0, ulNext0 );
+		PutLong( m_Tiff.data() + 4, ulIFD0 );
+		return true;
+	}
+
+	// public methods
+public:
+	// write a copy of the PNG file read by the reader to the target with
+	// an eXIf chunk holding the given date ("YYYY:MM:DD HH:MM:SS") as its
+	// original and digitized dates, returning false if the file cannot
+	// be rewritten
+	bool Write
+	(
+		const char* pcszSource, const char* pcszTarget,
+		const CExifReader& reader, const char* pcszDate
+	)
+	{
+		const long long llChunk = reader.GetChunk();
+		if ( !reader.GetPng() || llChunk < 8 || strlen( pcszDate ) != 19 )
+		{
+			return false;
+		}
+
+		FILE* pSource = fopen( pcszSource, "rb" );
+		if ( pSource == nullptr )
+		{
+			return false;
+		}
+
+		// the EXIF data of the existing chunk
+		vector<unsigned char> old( reader.GetChunkLength() );
+		const long long llResume = llChunk + 12 + (long long)old.size();
+		if
+		(
+			!CExifReader::Seek( pSource, llChunk + 8 ) ||
+			fread( old.data(), 1, old.size(), pSource ) != old.size()
+		)
+		{
+			fclose( pSource );
+			return false;
+		}
+
+		if ( !Build( old, pcszDate ) )
+		{
+			fclose( pSource );
+			return false;
+		}
+
+		FILE* pTarget = fopen( pcszTarget, "wb" );
+		if ( pTarget == nullptr )
+		{
+			fclose( pSource );
+			return false;
+		}
+
+		// the new chunk: length, type, data and the CRC of type and data
+		vector<unsigned char> chunk;
+		const unsigned long ulLength = (unsigned long)m_Tiff.size();
+		const unsigned char length[ 4 ] =
+		{
+			(unsigned char)( ulLength >> 24 ), (unsigned char)( ulLength >> 16 ),
+			(unsigned char)( ulLength >> 8 ), (unsigned char)ulLength
+		};
+		chunk.insert( chunk.end(), length, length + 4 );
+		chunk.insert( chunk.end(), { 'e', 'X', 'I', 'f' } );
+		chunk.insert( chunk.end(), m_Tiff.begin(), m_Tiff.end() );
+		const uint32_t ulCrc = CCrc32::Update( 0, chunk.data() + 4, chunk.size() - 4 );
+		chunk.insert
+		(
+			chunk.end(),
+			{
+				(unsigned char)( ulCrc >> 24 ), (unsigned char)( ulCrc >> 16 ),
+				(unsigned char)( ulCrc >> 8 ), (unsigned char)ulCrc
+			}
+		);
+
+		bool value =
+			CFileClone::CopyRange( pSource, 0, pTarget, llChunk ) &&
+			fwrite( chunk.data(), 1, chunk.size(), pTarget ) == chunk.size() &&
+			CFileClone::CopyRange( pSource, llResume, pTarget, -1 );
+
+		fclose( pSource );
+		if ( fclose( pTarget ) != 0 )
+		{
+			value = false;
+		}
+		if ( !value )
+		{
+			remove( pcszTarget );
+		}
+
+		return value;
+	}
+
+	// public construction
+public:
+	CPngRewriter()
+	{
+		m_bIntel = false;
+	}
+};
+
+/////////////////////////////////////////////////////////////////////////////
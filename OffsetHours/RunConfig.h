@@ -0,0 +1,497 @@
+/////////////////////////////////////////////////////////////////////////////
+// Copyright  by W. T. Block, all rights reserved
+/////////////////////////////////////////////////////////////////////////////
+#pragma once
+#include "ExifDate.h"
+#include "LogSink.h"
+#include <ctype.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/////////////////////////////////////////////////////////////////////////////
+// the settings of a run which are filled in from the command line before
+// any file is processed and are then shared by every thread as a const
+// reference, so no locks are needed to read them
+class CRunConfig
+{
+	// protected data
+protected:
+	// the root of the tree to be scanned which may contain wild cards
+	string m_csPathname;
+
+	// the number of hours the date taken metadata will be offset
+	double m_dHourOffset;
+
+	// the same offset as a whole number of milliseconds
+	int64_t m_llOffset;
+
+	// when true, sub-folders will be processed as well as the base folder
+	bool m_bRecurse;
+
+	// directory enumeration threads
+	int m_nWalkThreads;
+
+	// header read and date parse threads
+	int m_nReadThreads;
+
+	// date offset threads
+	int m_nOffsetThreads;
+
+	// patch and write threads
+	int m_nWriteThreads;
+
+	// the capacity of each queue between the pipeline stages
+	int m_nQueueDepth;
+
+	// report the backpressure of the queues at the end of the run
+	bool m_bQueueStats;
+
+	// how much output the run writes
+	CLogSink::VERBOSITY m_eVerbosity;
+
+	// write a manifest of the planned changes here instead of writing
+	// any images ("-" for the standard output)
+	string m_csPlan;
+
+	// apply the planned changes of this manifest instead of walking
+	// the tree
+	string m_csApply;
+
+	// process the files of this list ("-" for the standard input) 
+	// instead of walking the tree
+	string m_csFilesFrom;
+
+	// time the hot spots of the run and report them at the end
+	bool m_bMetrics;
+
+	// also write the timings here as JSON
+	string m_csMetricsFile;
+
+	// write a timeline of the run here in the Trace Event format
+	string m_csTrace;
+
+	// skip the files this journal records as done and record the files
+	// this run does in it
+	string m_csJournal;
+
+	// include a hash of the EXIF header in the journal's file stamps
+	bool m_bJournalHash;
+
+	// keep checkpoints of the walk here so the run can be resumed
+	string m_csCheckpoint;
+
+	// the number of seconds between checkpoints
+	int m_nCheckpointSeconds;
+
+	// continue from the checkpoint a run left behind
+	bool m_bResume;
+
+	// correct the files themselves instead of writing corrected copies
+	bool m_bInPlace;
+
+	// public properties
+public:
+	// the root of the tree to be scanned which may contain wild cards
+	inline const string& GetPathname() const
+	{
+		return m_csPathname;
+	}
+	// the root of the tree to be scanned which may contain wild cards
+	inline void SetPathname( const string& value )
+	{
+		m_csPathname = value;
+	}
+
+	// the number of hours the date taken metadata will be offset
+	inline double GetHourOffset() const
+	{
+		return m_dHourOffset;
+	}
+	// the number of hours the date taken metadata will be offset
+	inline void SetHourOffset( double value )
+	{
+		m_dHourOffset = value;
+		m_llOffset = CExifDate::GetOffsetMilliseconds( value );
+	}
+
+	// the offset in milliseconds which is rounded once from the hours
+	// so every date is shifted by exactly the same amount
+	inline int64_t GetOffset() const
+	{
+		return m_llOffset;
+	}
+
+	// when true, sub-folders will be processed as well as the base folder
+	inline bool GetRecurse() const
+	{
+		return m_bRecurse;
+	}
+	// when true, sub-folders will be processed as well as the base folder
+	inline void SetRecurse( bool value )
+	{
+		m_bRecurse = value;
+	}
+
+	// directory enumeration threads
+	inline int GetWalkThreads() const
+	{
+		return m_nWalkThreads;
+	}
+
+	// header read and date parse threads
+	inline int GetReadThreads() const
+	{
+		return m_nReadThreads;
+	}
+
+	// date offset threads
+	inline int GetOffsetThreads() const
+	{
+		return m_nOffsetThreads;
+	}
+
+	// patch and write threads
+	inline int GetWriteThreads() const
+	{
+		return m_nWriteThreads;
+	}
+
+	// the capacity of each queue between the pipeline stages
+	inline int GetQueueDepth() const
+	{
+		return m_nQueueDepth;
+	}
+
+	// report the backpressure of the queues at the end of the run
+	inline bool GetQueueStats() const
+	{
+		return m_bQueueStats;
+	}
+
+	// how much output the run writes
+	inline CLogSink::VERBOSITY GetVerbosity() const
+	{
+		return m_eVerbosity;
+	}
+
+	// write a manifest of the planned changes here instead of writing
+	// any images ("-" for the standard output)
+	inline const string& GetPlan() const
+	{
+		return m_csPlan;
+	}
+
+	// apply the planned changes of this manifest instead of walking
+	// the tree
+	inline const string& GetApply() const
+	{
+		return m_csApply;
+	}
+
+	// process the files of this list ("-" for the standard input) 
+	// instead of walking the tree
+	inline const string& GetFilesFrom() const
+	{
+		return m_csFilesFrom;
+	}
+
+	// time the hot spots of the run and report them at the end
+	inline bool GetMetrics() const
+	{
+		return m_bMetrics;
+	}
+
+	// also write the timings here as JSON
+	inline const string& GetMetricsFile() const
+	{
+		return m_csMetricsFile;
+	}
+
+	// write a timeline of the run here in the Trace Event format
+	inline const string& GetTrace() const
+	{
+		return m_csTrace;
+	}
+
+	// skip the files this journal records as done and record the files
+	// this run does in it
+	inline const string& GetJournal() const
+	{
+		return m_csJournal;
+	}
+
+	// include a hash of the EXIF header in the journal's file stamps
+	inline bool GetJournalHash() const
+	{
+		return m_bJournalHash;
+	}
+
+	// keep checkpoints of the walk here so the run can be resumed
+	inline const string& GetCheckpoint() const
+	{
+		return m_csCheckpoint;
+	}
+
+	// the number of seconds between checkpoints
+	inline int GetCheckpointSeconds() const
+	{
+		return m_nCheckpointSeconds;
+	}
+
+	// continue from the checkpoint a run left behind
+	inline bool GetResume() const
+	{
+		return m_bResume;
+	}
+
+	// correct the files themselves instead of writing corrected copies
+	inline bool GetInPlace() const
+	{
+		return m_bInPlace;
+	}
+
+	// public methods
+public:
+	// true if the hour offset is one a run can be given: not zero within
+	// the 0.0001 hours the front end has always allowed, and no more than
+	// 10,000 years of 8,766 hours either way so the offset in milliseconds
+	// cannot overflow. Infinity and NaN are rejected.
+	static inline bool GetValidHourOffset( double dHours )
+	{
+		const double dMagnitude = fabs( dHours );
+		return dMagnitude >= 0.0001 && dMagnitude <= 10000.0 * 8766.0;
+	}
+
+	// remove the "--name value" options from the arguments (the first
+	// argument is the executable) and apply them, returning false with
+	// an error message if an option is not recognized
+	bool ParseOptions( vector<string>& arrArgs, string& csError )
+	{
+		vector<string> arrPositional;
+		const size_t nArgs = arrArgs.size();
+
+		for ( size_t nArg = 0; nArg < nArgs; nArg++ )
+		{
+			string csArg = arrArgs[ nArg ];
+			if ( nArg == 0 || csArg.compare( 0, 2, "--" ) != 0 )
+			{
+				arrPositional.push_back( csArg );
+				continue;
+			}
+
+			for ( char& cArg : csArg )
+			{
+				cArg = (char)tolower( (unsigned char)cArg );
+			}
+
+			// switches without a value
+			if ( csArg == "--queue-stats" )
+			{
+				m_bQueueStats = true;
+				continue;
+			}
+			if ( csArg == "--metrics" )
+			{
+				m_bMetrics = true;
+				continue;
+			}
+			if ( csArg == "--journal-hash" )
+			{
+				m_bJournalHash = true;
+				continue;
+			}
+			if ( csArg == "--resume" )
+			{
+				m_bResume = true;
+				continue;
+			}
+			if ( csArg == "--in-place" )
+			{
+				m_bInPlace = true;
+				continue;
+			}
+
+			// options followed by a value
+			if ( nArg + 1 >= nArgs )
+			{
+				csError = "Missing value for option: " + csArg;
+				return false;
+			}
+
+			const string csValue = arrArgs[ ++nArg ];
+
+			// options with a named value
+			if ( csArg == "--verbosity" )
+			{
+				if ( csValue == "quiet" )
+				{
+					m_eVerbosity = CLogSink::lvQuiet;
+
+				} else if ( csValue == "summary" )
+				{
+					m_eVerbosity = CLogSink::lvSummary;
+
+				} else if ( csValue == "file" )
+				{
+					m_eVerbosity = CLogSink::lvFile;
+
+				} else
+				{
+					csError = "Invalid value for " + csArg + ": " + csValue;
+					return false;
+				}
+				continue;
+			}
+
+			// options with a file name value
+			if ( csArg == "--metrics-file" )
+			{
+				m_bMetrics = true;
+				m_csMetricsFile = csValue;
+				continue;
+			}
+			if ( csArg == "--trace" )
+			{
+				m_csTrace = csValue;
+				continue;
+			}
+			if ( csArg == "--journal" )
+			{
+				m_csJournal = csValue;
+				continue;
+			}
+			if ( csArg == "--checkpoint" )
+			{
+				m_csCheckpoint = csValue;
+				continue;
+			}
+			if ( csArg == "--files-from" )
+			{
+				m_csFilesFrom = csValue;
+				continue;
+			}
+			if ( csArg == "--plan" || csArg == "--apply" )
+			{
+				( csArg == "--plan" ? m_csPlan : m_csApply ) = csValue;
+				if ( !m_csPlan.empty() && !m_csApply.empty() )
+				{
+					csError = "--plan and --apply cannot be combined";
+					return false;
+				}
+				continue;
+			}
+
+			const int nValue = atoi( csValue.c_str() );
+			int* pnOption = nullptr;
+
+			if ( csArg == "--walk-threads" )
+			{
+				pnOption = &m_nWalkThreads;
+
+			} else if ( csArg == "--read-threads" )
+			{
+				pnOption = &m_nReadThreads;
+
+			} else if ( csArg == "--offset-threads" )
+			{
+				pnOption = &m_nOffsetThreads;
+
+			} else if ( csArg == "--write-threads" )
+			{
+				pnOption = &m_nWriteThreads;
+
+			} else if ( csArg == "--queue-depth" )
+			{
+				pnOption = &m_nQueueDepth;
+
+			} else if ( csArg == "--checkpoint-seconds" )
+			{
+				pnOption = &m_nCheckpointSeconds;
+
+			} else // not an option we know about
+			{
+				csError = "Unknown option: " + csArg;
+				return false;
+			}
+
+			if ( nValue < 1 )
+			{
+				csError = "Invalid value for " + csArg + ": " + csValue;
+				return false;
+			}
+
+			*pnOption = nValue;
+		}
+
+		// a plan being applied has its own list of files
+		if ( !m_csFilesFrom.empty() && !m_csApply.empty() )
+		{
+			csError = "--files-from cannot be combined with --apply";
+			return false;
+		}
+
+		// checkpoints follow the walk of the folders
+		if ( m_bResume && m_csCheckpoint.empty() )
+		{
+			csError = "--resume needs a --checkpoint file";
+			return false;
+		}
+		if ( !m_csCheckpoint.empty() && ( !m_csPlan.empty() || !m_csApply.empty() ) )
+		{
+			csError = "--checkpoint cannot be combined with --plan or --apply";
+			return false;
+		}
+		if ( !m_csCheckpoint.empty() && !m_csFilesFrom.empty() )
+		{
+			csError = "--checkpoint cannot be combined with --files-from";
+			return false;
+		}
+
+		// a resumed run processes the files that were in flight again,
+		// which is only safe while the originals are left unchanged
+		if ( !m_csCheckpoint.empty() && m_bInPlace )
+		{
+			csError = "--checkpoint cannot be combined with --in-place";
+			return false;
+		}
+
+		arrArgs = arrPositional;
+		return true;
+	}
+
+	// public construction
+public:
+	// the default pipeline uses a thread per core for each stage that
+	// waits on the file system
+	CRunConfig()
+	{
+		int nCores = (int)thread::hardware_concurrency();
+		if ( nCores < 1 )
+		{
+			nCores = 1;
+		}
+
+		m_dHourOffset = 0.0;
+		m_llOffset = 0;
+		m_bRecurse = false;
+		m_nWalkThreads = nCores;
+		m_nReadThreads = nCores;
+		m_nOffsetThreads = 1;
+		m_nWriteThreads = nCores;
+		m_nQueueDepth = 256;
+		m_bQueueStats = false;
+		m_eVerbosity = CLogSink::lvFile;
+		m_bMetrics = false;
+		m_bJournalHash = false;
+		m_nCheckpointSeconds = 30;
+		m_bResume = false;
+		m_bInPlace = false;
+	}
+};
+
+/////////////////////////////////////////////////////////////////////////////
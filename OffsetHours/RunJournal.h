@@ -0,0 +1,448 @@
+/////////////////////////////////////////////////////////////////////////////
+// Copyright  by W. T. Block, all rights reserved
+/////////////////////////////////////////////////////////////////////////////
+#pragma once
+#include "ExifReader.h"
+#include "FileCommit.h"
+#include "PlanManifest.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include <sys/stat.h>
+#endif
+
+using namespace std;
+
+/////////////////////////////////////////////////////////////////////////////
+// what identifies the version of a file without reading it
+typedef struct tagFileStamp
+{
+	// the size of the file in bytes
+	uint64_t m_ullSize;
+
+	// the time the file was last written in the file system's ticks
+	int64_t m_llModified;
+
+	// a hash of the file's EXIF header (zero when not computed)
+	uint64_t m_ullHash;
+
+} FILE_STAMP;
+
+/////////////////////////////////////////////////////////////////////////////
+// what a run did with one version of a file
+typedef struct tagJournalEntry
+{
+	// the version of the file that was processed
+	FILE_STAMP m_Stamp;
+
+	// the offset in milliseconds that was applied
+	int64_t m_llOffset;
+
+	// the outcome (one of the CRunJournal values)
+	string m_csStatus;
+
+} JOURNAL_ENTRY;
+
+/////////////////////////////////////////////////////////////////////////////
+// this class keeps a journal of the files a run has processed so a later
+// run over the same tree can skip every file that has not changed since,
+// after nothing more than a look at its size and time stamp. The journal
+// is a text file with one tab separated line per file appended as files
+// are finished: "path<TAB>size<TAB>modified<TAB>hash<TAB>offset<TAB>status"
+// where the later lines of a path replace the earlier ones. It is read
+// into memory when opened and rewritten without the replaced lines once
+// they outnumber the live ones. A corrected file is only skipped when it
+// was corrected by the same offset, while a file without a usable date is
+// skipped whatever the offset. The corrected copies are not checked, so a
+// journal should be deleted along with the corrected folders it describes.
+class CRunJournal
+{
+	// public definitions
+public:
+	// the file was written with the offset
+	static constexpr const char* CORRECTED = "corrected";
+
+	// the file has no date taken
+	static constexpr const char* MISSING = CPlanManifest::MISSING;
+
+	// the date taken cannot be parsed
+	static constexpr const char* INVALID = CPlanManifest::INVALID;
+
+	// the number of bytes at the start of a file that are hashed
+	static const size_t m_tHashBytes = 64 * 1024;
+
+	// protected data
+protected:
+	// the pathname of the journal
+	string m_csPath;
+
+	// the file being appended to (null when closed)
+	FILE* m_pFile;
+
+	// serializes the appends
+	mutex m_Lock;
+
+	// the last entry of each path read when the journal was opened
+	unordered_map<string, JOURNAL_ENTRY> m_Entries;
+
+	// hash the EXIF header of each file as part of its stamp
+	bool m_bHash;
+
+	// the number of entries appended by this run
+	unsigned long long m_ullRecorded;
+
+	// protected methods
+protected:
+	// add a 64 bit FNV-1a hash of the data to the hash
+	static inline uint64_t Hash( uint64_t ullHash, const unsigned char* pData, size_t tSize )
+	{
+		for ( size_t tByte = 0; tByte < tSize; tByte++ )
+		{
+			ullHash ^= pData[ tByte ];
+			ullHash *= 0x100000001b3ULL;
+		}
+		return ullHash;
+	}
+
+	// format an entry as a line of the journal ending with a line break
+	static void Format( const string& csPath, const JOURNAL_ENTRY& entry, string& csLine )
+	{
+		csLine.clear();
+		CPlanManifest::Escape( csPath, csLine );
+
+		char szValue[ 128 ];
+		snprintf
+		(
+			szValue, sizeof( szValue ), "\t%llu\t%lld\t%016llx\t%lld\t",
+			(unsigned long long)entry.m_Stamp.m_ullSize,
+			(long long)entry.m_Stamp.m_llModified,
+			(unsigned long long)entry.m_Stamp.m_ullHash,
+			(long long)entry.m_llOffset
+		);
+		csLine += szValue;
+		csLine += entry.m_csStatus;
+		csLine += '\n';
+	}
+
+	// parse a line of the journal without its line break, returning
+	// false for comments, blank lines and damaged lines (such as the
+	// last line of a run that was killed while writing it)
+	static bool Parse( string_view line, string& csPath, JOURNAL_ENTRY& entry )
+	{
+		if ( line.empty() || line[ 0 ] == '#' )
+		{
+			return false;
+		}
+
+		string_view fields[ 6 ];
+		for ( int nField = 0; nField < 5; nField++ )
+		{
+			const size_t tTab = line.find( '\t' );
+			if ( tTab == string_view::npos )
+			{
+				return false;
+			}
+			fields[ nField ] = line.substr( 0, tTab );
+			line.remove_prefix( tTab + 1 );
+		}
+		fields[ 5 ] = line;
+		if ( fields[ 0 ].empty() || fields[ 5 ].empty() )
+		{
+			return false;
+		}
+
+		const string csNumbers[ 4 ] =
+		{
+			string( fields[ 1 ] ), string( fields[ 2 ] ),
+			string( fields[ 3 ] ), string( fields[ 4 ] )
+		};
+		csPath = CPlanManifest::Unescape( fields[ 0 ] );
+		entry.m_Stamp.m_ullSize = strtoull( csNumbers[ 0 ].c_str(), nullptr, 10 );
+		entry.m_Stamp.m_llModified = strtoll( csNumbers[ 1 ].c_str(), nullptr, 10 );
+		entry.m_Stamp.m_ullHash = strtoull( csNumbers[ 2 ].c_str(), nullptr, 16 );
+		entry.m_llOffset = strtoll( csNumbers[ 3 ].c_str(), nullptr, 10 );
+		entry.m_csStatus = fields[ 5 ];
+		return true;
+	}
+
+	// write the live entries to a new journal which replaces the old
+	// one, so a failure leaves the old journal as it was
+	bool Compact()
+	{
+		const string csTemp = m_csPath + ".tmp";
+		FILE* pFile = fopen( csTemp.c_str(), "wb" );
+		if ( pFile == nullptr )
+		{
+			return false;
+		}
+
+		bool bWritten = fputs( GetHeader(), pFile ) >= 0;
+		string csLine;
+		for ( const auto& entry : m_Entries )
+		{
+			Format( entry.first, entry.second, csLine );
+			bWritten &= fwrite( csLine.data(), 1, csLine.size(), pFile ) == csLine.size();
+		}
+
+		if ( fclose( pFile ) != 0 || !bWritten || !CFileCommit::Rename( csTemp.c_str(), m_csPath.c_str() ) )
+		{
+			remove( csTemp.c_str() );
+			return false;
+		}
+
+		return true;
+	}
+
+	// public properties
+public:
+	// hash the EXIF header of each file as part of its stamp
+	inline bool GetHash() const
+	{
+		return m_bHash;
+	}
+	// hash the EXIF header of each file as part of its stamp
+	inline void SetHash( bool value )
+	{
+		m_bHash = value;
+	}
+
+	// true when the journal is open
+	inline bool GetOpen() const
+	{
+		return m_pFile != nullptr;
+	}
+
+	// the number of files in the journal when it was opened
+	inline size_t GetSize() const
+	{
+		return m_Entries.size();
+	}
+
+	// the number of entries appended by this run
+	inline unsigned long long GetRecorded() const
+	{
+		return m_ullRecorded;
+	}
+
+	// the comment line that starts a journal
+	static inline const char* GetHeader()
+	{
+		return "# path\tsize\tmodified\thash\toffset ms\tstatus\n";
+	}
+
+	// public methods
+public:
+	// read the size and time stamp of a file with a single call to the
+	// file system, returning false if the file cannot be found
+	static bool GetStamp( const char* pcszPath, FILE_STAMP& stamp )
+	{
+		stamp.m_ullHash = 0;
+#ifdef _WIN32
+		WIN32_FILE_ATTRIBUTE_DATA data;
+		if ( !::GetFileAttributesExA( pcszPath, GetFileExInfoStandard, &data ) )
+		{
+			return false;
+		}
+		stamp.m_ullSize =
+			( (uint64_t)data.nFileSizeHigh << 32 ) | data.nFileSizeLow;
+		stamp.m_llModified = (int64_t)
+		(
+			( (uint64_t)data.ftLastWriteTime.dwHighDateTime << 32 ) |
+			data.ftLastWriteTime.dwLowDateTime
+		);
+#else
+		struct stat data;
+		if ( stat( pcszPath, &data ) != 0 )
+		{
+			return false;
+		}
+		stamp.m_ullSize = (uint64_t)data.st_size;
+		stamp.m_llModified =
+			(int64_t)data.st_mtim.tv_sec * 1000000000 + data.st_mtim.tv_nsec;
+#endif
+		return true;
+	}
+
+	// hash the EXIF header of a file into the stamp, which for a JPEG or
+	// PNG file is the EXIF data the reader finds and for other formats is
+	// the start of the file, returning false if the file cannot be read
+	static bool GetHeaderHash( const char* pcszPath, FILE_STAMP& stamp )
+	{
+		static thread_local CExifReader reader;
+		if ( !reader.Read( pcszPath ) && reader.GetHeader().empty() )
+		{
+			return false;
+		}
+
+		const unsigned char* pStart = reader.GetExif();
+		size_t tSize = reader.GetExifSize();
+		if ( pStart == nullptr )
+		{
+			pStart = reader.GetHeader().data();
+			tSize = reader.GetHeader().size();
+			tSize = tSize < m_tHashBytes ? tSize : m_tHashBytes;
+		}
+
+		// never let a hash be mistaken for a missing one
+		const uint64_t ullHash = Hash( 0xcbf29ce484222325ULL, pStart, tSize );
+		stamp.m_ullHash = ullHash == 0 ? 1 : ullHash;
+		return true;
+	}
+
+	// open the journal reading the entries of earlier runs and creating
+	// it if it does not exist, returning false if it cannot be written
+	bool Open( const char* pcszPath )
+	{
+		Close();
+		m_csPath = pcszPath;
+		m_Entries.clear();
+
+		// stream the earlier entries keeping the last one of each path
+		size_t tLines = 0;
+		bool bDamaged = false;
+		FILE* pFile = fopen( pcszPath, "rb" );
+		if ( pFile != nullptr )
+		{
+			string csLine;
+			string csPath;
+			JOURNAL_ENTRY entry;
+			char buffer[ 64 * 1024 ];
+			size_t tRead = 0;
+			while ( ( tRead = fread( buffer, 1, sizeof( buffer ), pFile ) ) > 0 )
+			{
+				const char* pStart = buffer;
+				const char* pEnd = buffer + tRead;
+				while ( pStart < pEnd )
+				{
+					const char* pBreak =
+						(const char*)memchr( pStart, '\n', pEnd - pStart );
+					if ( pBreak == nullptr )
+					{
+						csLine.append( pStart, pEnd );
+						break;
+					}
+
+					csLine.append( pStart, pBreak );
+					if ( Parse( csLine, csPath, entry ) )
+					{
+						m_Entries[ csPath ] = entry;
+						tLines++;
+					}
+					csLine.clear();
+					pStart = pBreak + 1;
+				}
+			}
+			fclose( pFile );
+
+			// the last line of a run that was killed while writing it
+			bDamaged = !csLine.empty();
+		}
+
+		// drop the replaced lines once they outnumber the live ones
+		if ( tLines > 2 * m_Entries.size() + 1024 && Compact() )
+		{
+			bDamaged = false;
+		}
+
+		const bool bNew = tLines == 0;
+		m_pFile = fopen( pcszPath, bNew ? "wb" : "ab" );
+		if ( m_pFile == nullptr )
+		{
+			return false;
+		}
+		setvbuf( m_pFile, nullptr, _IOFBF, 256 * 1024 );
+		if ( bNew )
+		{
+			fputs( GetHeader(), m_pFile );
+
+		} else if ( bDamaged ) // end the damaged line
+		{
+			fputc( '\n', m_pFile );
+		}
+
+		return true;
+	}
+
+	// true if an earlier run processed this version of the file in a
+	// way that would not change with the given offset
+	bool GetUnchanged( const string& csPath, const FILE_STAMP& stamp, int64_t llOffset ) const
+	{
+		const auto pos = m_Entries.find( csPath );
+		if ( pos == m_Entries.end() )
+		{
+			return false;
+		}
+
+		const JOURNAL_ENTRY& entry = pos->second;
+		if
+		(
+			entry.m_Stamp.m_ullSize != stamp.m_ullSize ||
+			entry.m_Stamp.m_llModified != stamp.m_llModified ||
+			entry.m_Stamp.m_ullHash != stamp.m_ullHash
+		)
+		{
+			return false;
+		}
+
+		return entry.m_csStatus != CORRECTED || entry.m_llOffset == llOffset;
+	}
+
+	// append the outcome of a file to the journal (called by any thread)
+	void Record( const string& csPath, const JOURNAL_ENTRY& entry )
+	{
+		static thread_local string csLine;
+		Format( csPath, entry, csLine );
+
+		lock_guard<mutex> lock( m_Lock );
+		if ( m_pFile != nullptr )
+		{
+			fwrite( csLine.data(), 1, csLine.size(), m_pFile );
+			m_ullRecorded++;
+		}
+	}
+
+	// write the buffered entries to the journal
+	bool Flush()
+	{
+		lock_guard<mutex> lock( m_Lock );
+		return m_pFile == nullptr || fflush( m_pFile ) == 0;
+	}
+
+	// finish writing the journal, returning false if the entries could
+	// not all be written
+	bool Close()
+	{
+		lock_guard<mutex> lock( m_Lock );
+		if ( m_pFile == nullptr )
+		{
+			return true;
+		}
+
+		const bool value = fclose( m_pFile ) == 0;
+		m_pFile = nullptr;
+		return value;
+	}
+
+	// public construction / destruction
+public:
+	CRunJournal()
+	{
+		m_pFile = nullptr;
+		m_bHash = false;
+		m_ullRecorded = 0;
+	}
+	~CRunJournal()
+	{
+		Close();
+	}
+};
+
+/////////////////////////////////////////////////////////////////////////////
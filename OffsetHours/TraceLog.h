@@ -0,0 +1,318 @@
+/////////////////////////////////////////////////////////////////////////////
+// Copyright  by W. T. Block, all rights reserved
+/////////////////////////////////////////////////////////////////////////////
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/////////////////////////////////////////////////////////////////////////////
+// one event of a timeline
+typedef struct tagTraceEvent
+{
+	// the name of the step (a string literal)
+	const char* m_pcszName;
+
+	// 'X' for a step with a duration or 'C' for a counter
+	char m_cPhase;
+
+	// nanoseconds since the trace began
+	uint64_t m_ullStart;
+
+	// the length of a step in nanoseconds
+	uint64_t m_ullDuration;
+
+	// the end of the folder or file pathname of a step, or the JSON
+	// arguments of a counter
+	char m_szItem[ 80 ];
+
+} TRACE_EVENT;
+
+/////////////////////////////////////////////////////////////////////////////
+// this class records a timeline of a run and writes it in the Trace Event
+// format read by chrome://tracing and Perfetto. Every thread records into
+// its own ring of events which no other thread writes, so recording is
+// a copy into the ring and a release store of its position. When a ring
+// fills, the oldest events are overwritten so a long run keeps its most
+// recent events. The rings are read once the threads are done.
+class CTraceLog
+{
+	// protected definitions
+protected:
+	// the ring of one thread
+	typedef struct tagRing
+	{
+		// the events (a power of 2 in number)
+		unique_ptr<TRACE_EVENT[]> m_Events;
+
+		// the number of events ever recorded
+		atomic<uint64_t> m_ullNext;
+
+		// the thread's number in the timeline
+		int m_nThread;
+
+	} RING;
+
+	// protected data
+protected:
+	// when the trace began
+	chrono::steady_clock::time_point m_tStart;
+
+	// the number of events in each ring
+	size_t m_tEvents;
+
+	// protects the list of rings
+	mutex m_Lock;
+
+	// the ring of every thread that has recorded an event
+	vector<unique_ptr<RING>> m_Rings;
+
+	// identifies this trace to the per-thread cache
+	uint64_t m_ullInstance;
+
+	// protected methods
+protected:
+	// the ring of the calling thread which is created the first time the
+	// thread records an event (the cache holds one trace, which is all
+	// a run uses)
+	RING* GetRing()
+	{
+		typedef struct tagCache
+		{
+			uint64_t m_ullInstance;
+			RING* m_pRing;
+		} CACHE;
+		static thread_local CACHE cache = { 0, nullptr };
+
+		if ( cache.m_ullInstance != m_ullInstance )
+		{
+			RING* pRing = new RING;
+			pRing->m_Events = unique_ptr<TRACE_EVENT[]>( new TRACE_EVENT[ m_tEvents ] );
+			pRing->m_ullNext = 0;
+
+			lock_guard<mutex> lock( m_Lock );
+			pRing->m_nThread = (int)m_Rings.size() + 1;
+			m_Rings.push_back( unique_ptr<RING>( pRing ) );
+			cache.m_pRing = pRing;
+			cache.m_ullInstance = m_ullInstance;
+		}
+
+		return cache.m_pRing;
+	}
+
+	// claim the next event of the calling thread's ring
+	inline TRACE_EVENT& Claim( RING*& pRing, uint64_t& ullPos )
+	{
+		pRing = GetRing();
+		ullPos = pRing->m_ullNext.load( memory_order_relaxed );
+		return pRing->m_Events[ ullPos & ( m_tEvents - 1 ) ];
+	}
+
+	// copy the end of an item which is usually the interesting part of
+	// a pathname
+	static inline void CopyItem( char* pszItem, size_t tSize, const char* pcszItem )
+	{
+		if ( pcszItem == nullptr )
+		{
+			pszItem[ 0 ] = 0;
+			return;
+		}
+
+		size_t tLength = strlen( pcszItem );
+		if ( tLength >= tSize )
+		{
+			pcszItem += tLength - ( tSize - 1 );
+			tLength = tSize - 1;
+		}
+		memcpy( pszItem, pcszItem, tLength );
+		pszItem[ tLength ] = 0;
+	}
+
+	// append a string escaped for JSON
+	static void AppendJson( string& csJson, const char* pcszValue )
+	{
+		for ( ; *pcszValue != 0; pcszValue++ )
+		{
+			const char cValue = *pcszValue;
+			if ( cValue == '"' || cValue == '\\' )
+			{
+				csJson += '\\';
+				csJson += cValue;
+
+			} else if ( (unsigned char)cValue < 0x20 )
+			{
+				char szValue[ 8 ];
+				snprintf( szValue, sizeof( szValue ), "\\u%04x", cValue );
+				csJson += szValue;
+
+			} else
+			{
+				csJson += cValue;
+			}
+		}
+	}
+
+	// public properties
+public:
+	// nanoseconds since the trace began
+	inline uint64_t GetTime( chrono::steady_clock::time_point tWhen ) const
+	{
+		return (uint64_t)chrono::duration_cast<chrono::nanoseconds>
+		(
+			tWhen - m_tStart
+		).count();
+	}
+
+	// public methods
+public:
+	// record a step of the calling thread from start to end
+	void Step
+	(
+		const char* pcszName,
+		chrono::steady_clock::time_point tStart,
+		chrono::steady_clock::time_point tEnd,
+		const char* pcszItem
+	)
+	{
+		RING* pRing = nullptr;
+		uint64_t ullPos = 0;
+		TRACE_EVENT& event = Claim( pRing, ullPos );
+		event.m_pcszName = pcszName;
+		event.m_cPhase = 'X';
+		event.m_ullStart = GetTime( tStart );
+		event.m_ullDuration = (uint64_t)chrono::duration_cast<chrono::nanoseconds>
+		(
+			tEnd - tStart
+		).count();
+		CopyItem( event.m_szItem, sizeof( event.m_szItem ), pcszItem );
+		pRing->m_ullNext.store( ullPos + 1, memory_order_release );
+	}
+
+	// record the values of a counter where the arguments are JSON name
+	// and value pairs like "\"read\": 4, \"write\": 2"
+	void Counter( const char* pcszName, const char* pcszArgs )
+	{
+		RING* pRing = nullptr;
+		uint64_t ullPos = 0;
+		TRACE_EVENT& event = Claim( pRing, ullPos );
+		event.m_pcszName = pcszName;
+		event.m_cPhase = 'C';
+		event.m_ullStart = GetTime( chrono::steady_clock::now() );
+		event.m_ullDuration = 0;
+		CopyItem( event.m_szItem, sizeof( event.m_szItem ), pcszArgs );
+		pRing->m_ullNext.store( ullPos + 1, memory_order_release );
+	}
+
+	// write the events of every thread in the Trace Event format,
+	// returning false if the file cannot be written. The threads that
+	// record events should be finished.
+	bool Write( const char* pcszPath )
+	{
+		FILE* pFile = fopen( pcszPath, "wb" );
+		if ( pFile == nullptr )
+		{
+			return false;
+		}
+
+		string csJson = "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+		bool bFirst = true;
+		char szValue[ 256 ];
+		bool bWritten = true;
+
+		lock_guard<mutex> lock( m_Lock );
+		for ( const unique_ptr<RING>& pRing : m_Rings )
+		{
+			const uint64_t ullNext = pRing->m_ullNext.load( memory_order_acquire );
+			const uint64_t ullFirst = ullNext > m_tEvents ? ullNext - m_tEvents : 0;
+
+			snprintf
+			(
+				szValue, sizeof( szValue ),
+				"%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, "
+				"\"tid\": %d, \"args\": {\"name\": \"thread %d\", "
+				"\"dropped_events\": %llu}}",
+				bFirst ? "" : ",\n", pRing->m_nThread, pRing->m_nThread,
+				(unsigned long long)ullFirst
+			);
+			csJson += szValue;
+			bFirst = false;
+
+			for ( uint64_t ullPos = ullFirst; ullPos < ullNext; ullPos++ )
+			{
+				const TRACE_EVENT& event =
+					pRing->m_Events[ ullPos & ( m_tEvents - 1 ) ];
+				snprintf
+				(
+					szValue, sizeof( szValue ),
+					",\n{\"name\": \"%s\", \"ph\": \"%c\", \"pid\": 1, "
+					"\"tid\": %d, \"ts\": %.3f",
+					event.m_pcszName, event.m_cPhase, pRing->m_nThread,
+					event.m_ullStart / 1000.0
+				);
+				csJson += szValue;
+
+				if ( event.m_cPhase == 'C' )
+				{
+					csJson += ", \"args\": {";
+					csJson += event.m_szItem;
+					csJson += "}}";
+
+				} else
+				{
+					snprintf
+					(
+						szValue, sizeof( szValue ), ", \"dur\": %.3f",
+						event.m_ullDuration / 1000.0
+					);
+					csJson += szValue;
+					if ( event.m_szItem[ 0 ] != 0 )
+					{
+						csJson += ", \"args\": {\"item\": \"";
+						AppendJson( csJson, event.m_szItem );
+						csJson += "\"}";
+					}
+					csJson += "}";
+				}
+
+				// write in large blocks
+				if ( csJson.size() > 1024 * 1024 )
+				{
+					bWritten &=
+						fwrite( csJson.data(), 1, csJson.size(), pFile ) == csJson.size();
+					csJson.clear();
+				}
+			}
+		}
+
+		csJson += "\n]}\n";
+		bWritten &= fwrite( csJson.data(), 1, csJson.size(), pFile ) == csJson.size();
+		return fclose( pFile ) == 0 && bWritten;
+	}
+
+	// public construction
+public:
+	// each thread keeps its most recent events up to the given number
+	// (rounded up to a power of 2)
+	CTraceLog( size_t tEvents = 64 * 1024 )
+	{
+		static atomic<uint64_t> ullInstances( 0 );
+		m_ullInstance = ++ullInstances;
+		m_tStart = chrono::steady_clock::now();
+
+		m_tEvents = 2;
+		while ( m_tEvents < tEvents )
+		{
+			m_tEvents <<= 1;
+		}
+	}
+};
+
+/////////////////////////////////////////////////////////////////////////////
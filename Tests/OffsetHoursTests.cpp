@@ -0,0 +1,325 @@
+/////////////////////////////////////////////////////////////////////////////
+// Copyright  by W. T. Block, all rights reserved
+/////////////////////////////////////////////////////////////////////////////
+// round trip checks of the portable engine's formats: the EXIF date 
+// arithmetic, the lines of the plan manifest and of the run journal and
+// the CRC of PNG chunks. Each group is a test of its own which is named
+// on the command line, so ctest reports them one at a time.
+#include "Crc32.h"
+#include "ExifDate.h"
+#include "PlanManifest.h"
+#include "RunConfig.h"
+#include "RunJournal.h"
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+using namespace std;
+
+/////////////////////////////////////////////////////////////////////////////
+// the number of checks that failed
+static int m_nFailed = 0;
+
+/////////////////////////////////////////////////////////////////////////////
+// report a check that failed with where it is
+#define CHECK( condition ) \
+	do \
+	{ \
+		if ( !( condition ) ) \
+		{ \
+			printf( "%s(%d): failed: %s\n", __FILE__, __LINE__, #condition ); \
+			m_nFailed++; \
+		} \
+	} while ( false )
+
+/////////////////////////////////////////////////////////////////////////////
+// shift a date by the given hours the way a run does and return the new
+// date, or an empty string if it cannot be shifted
+static string Shift( const char* pcszDate, double dHours )
+{
+	char szDate[ 20 ];
+	const int64_t llOffset = CExifDate::GetOffsetMilliseconds( dHours );
+	if ( !CExifDate::Shift( pcszDate, strlen( pcszDate ), llOffset, szDate ) )
+	{
+		return string();
+	}
+	return szDate;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// parse, shift and format EXIF dates across leap days, month ends and
+// year boundaries in both directions
+static void TestExifDate()
+{
+	DATE_FIELDS fields;
+	CHECK( CExifDate::Parse( "2024:02:29 13:45:07", fields ) );
+	CHECK( fields.m_nYear == 2024 && fields.m_nMonth == 2 && fields.m_nDay == 29 );
+	CHECK( fields.m_nHour == 13 && fields.m_nMinute == 45 && fields.m_nSecond == 7 );
+	CHECK( CExifDate::IsValid( fields ) );
+
+	char szDate[ 20 ];
+	CExifDate::Format( fields, szDate );
+	CHECK( strcmp( szDate, "2024:02:29 13:45:07" ) == 0 );
+
+	// the layout must be exact, the value may be followed by its NUL
+	CHECK( CExifDate::Parse( string_view( "2024:02:29 13:45:07", 20 ), fields ) );
+	CHECK( !CExifDate::Parse( "2024-02-29 13:45:07", fields ) );
+	CHECK( !CExifDate::Parse( "2024:02:29 13:45:0", fields ) );
+	CHECK( !CExifDate::Parse( "2024:02:29 13:45:07Z", fields ) );
+	CHECK( !CExifDate::Parse( "    :  :     :  :  ", fields ) );
+
+	// February 29 only in leap years of the Gregorian calendar
+	CHECK( CExifDate::Parse( "2023:02:29 00:00:00", fields ) );
+	CHECK( !CExifDate::IsValid( fields ) );
+	CHECK( CExifDate::Parse( "1900:02:29 00:00:00", fields ) );
+	CHECK( !CExifDate::IsValid( fields ) );
+	CHECK( CExifDate::Parse( "2000:02:29 00:00:00", fields ) );
+	CHECK( CExifDate::IsValid( fields ) );
+
+	// into and out of leap days
+	CHECK( Shift( "2024:02:28 23:30:00", 1 ) == "2024:02:29 00:30:00" );
+	CHECK( Shift( "2023:02:28 23:30:00", 1 ) == "2023:03:01 00:30:00" );
+	CHECK( Shift( "2024:03:01 00:30:00", -1 ) == "2024:02:29 23:30:00" );
+	CHECK( Shift( "2000:02:28 12:00:00", 24 ) == "2000:02:29 12:00:00" );
+	CHECK( Shift( "2100:02:28 12:00:00", 24 ) == "2100:03:01 12:00:00" );
+
+	// across year boundaries and by whole years
+	CHECK( Shift( "2023:12:31 23:00:00", 2 ) == "2024:01:01 01:00:00" );
+	CHECK( Shift( "2024:01:01 00:00:00", -1 ) == "2023:12:31 23:00:00" );
+	CHECK( Shift( "2024:01:01 00:00:00", 366 * 24 ) == "2025:01:01 00:00:00" );
+	CHECK( Shift( "2023:06:15 08:00:00", -365 * 24 ) == "2022:06:15 08:00:00" );
+
+	// the fractions of the usage text are whole seconds
+	CHECK( Shift( "2024:12:31 23:59:59", 0.0002777777777777 ) == "2025:01:01 00:00:00" );
+	CHECK( Shift( "2024:01:01 00:00:00", -0.0166666666666666 ) == "2023:12:31 23:59:00" );
+	CHECK( CExifDate::GetOffsetMilliseconds( 0.0002777777777777 ) == 1000 );
+
+	// shifting back undoes the shift
+	CHECK( Shift( Shift( "1999:12:31 22:15:30", 7.5 ).c_str(), -7.5 ) == "1999:12:31 22:15:30" );
+
+	// results outside of years 100 through 9999 are rejected, as are
+	// invalid dates and the largest offset a run accepts
+	CHECK( Shift( "9999:12:31 23:00:00", 1 ).empty() );
+	CHECK( Shift( "0100:01:01 00:30:00", -1 ).empty() );
+	CHECK( Shift( "2023:02:29 00:00:00", 1 ).empty() );
+	CHECK( Shift( "2000:01:01 00:00:00", 10000.0 * 8766.0 ).empty() );
+	CHECK( CRunConfig::GetValidHourOffset( 10000.0 * 8766.0 ) );
+	CHECK( !CRunConfig::GetValidHourOffset( 10000.0 * 8766.0 + 1 ) );
+	CHECK( !CRunConfig::GetValidHourOffset( 0.00001 ) );
+
+	// a batch of records marks the ones that cannot be shifted
+	const char dates[ 3 ][ 20 ] =
+	{
+		"2024:02:29 23:00:00", "2024:13:01 00:00:00", "2019:12:31 23:00:00"
+	};
+	char shifted[ 3 ][ 20 ];
+	const int64_t llHour = CExifDate::GetOffsetMilliseconds( 1 );
+	CHECK( CExifDate::ShiftBatch( dates[ 0 ], 3, llHour, shifted[ 0 ] ) == 2 );
+	CHECK( strcmp( shifted[ 0 ], "2024:03:01 00:00:00" ) == 0 );
+	CHECK( shifted[ 1 ][ 0 ] == 0 );
+	CHECK( strcmp( shifted[ 2 ], "2020:01:01 00:00:00" ) == 0 );
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// escape and format manifest lines and parse them back
+static void TestPlanManifest()
+{
+	// tabs, line breaks and percent signs are encoded, separators are not
+	const string csPath = "C:\\photos\\a\tb%c\nd\re/f.jpg";
+	string csEscaped;
+	CPlanManifest::Escape( csPath, csEscaped );
+	CHECK( csEscaped == "C:\\photos\\a%09b%25c%0Ad%0De/f.jpg" );
+	CHECK( CPlanManifest::Unescape( csEscaped ) == csPath );
+
+	// lower case digits decode and broken escapes are kept as they are
+	CHECK( CPlanManifest::Unescape( "a%0ab" ) == "a\nb" );
+	CHECK( CPlanManifest::Unescape( "100%" ) == "100%" );
+	CHECK( CPlanManifest::Unescape( "%G1%2" ) == "%G1%2" );
+
+	PLAN_ENTRY entry;
+	entry.m_csPath = csPath;
+	entry.m_csOld = "2024:02:29 23:00:00";
+	entry.m_csNew = "2024:03:01 00:00:00";
+	entry.m_csStatus = CPlanManifest::PLANNED;
+
+	string csLine;
+	CPlanManifest::Format( entry, csLine );
+	CHECK
+	( 
+		csLine == 
+		"C:\\photos\\a%09b%25c%0Ad%0De/f.jpg\t2024:02:29 23:00:00\t"
+		"2024:03:01 00:00:00\tplanned\n"
+	);
+
+	// the line break is not part of the line, a carriage return may be
+	PLAN_ENTRY parsed;
+	csLine.pop_back();
+	CHECK( CPlanManifest::Parse( csLine, parsed ) );
+	CHECK( parsed.m_csPath == entry.m_csPath && parsed.m_csOld == entry.m_csOld );
+	CHECK( parsed.m_csNew == entry.m_csNew && parsed.m_csStatus == entry.m_csStatus );
+	CHECK( CPlanManifest::Parse( csLine + "\r", parsed ) );
+	CHECK( parsed.m_csStatus == CPlanManifest::PLANNED );
+
+	// an entry without dates keeps its empty fields
+	CHECK( CPlanManifest::Parse( "/a.png\t\t\tmissing", parsed ) );
+	CHECK( parsed.m_csPath == "/a.png" && parsed.m_csOld.empty() && parsed.m_csNew.empty() );
+	CHECK( parsed.m_csStatus == CPlanManifest::MISSING );
+
+	// comments, blank lines and short lines are not entries
+	string csHeader = CPlanManifest::GetHeader();
+	csHeader.pop_back();
+	CHECK( !CPlanManifest::Parse( csHeader, parsed ) );
+	CHECK( !CPlanManifest::Parse( "", parsed ) );
+	CHECK( !CPlanManifest::Parse( "\r", parsed ) );
+	CHECK( !CPlanManifest::Parse( "/a.png\t2024:01:01 00:00:00\tplanned", parsed ) );
+	CHECK( !CPlanManifest::Parse( "\t\t\tplanned", parsed ) );
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// write journal entries, check their lines and read them back
+static void TestRunJournal()
+{
+	const string csJournal = "OffsetHoursTests.journal";
+	remove( csJournal.c_str() );
+
+	JOURNAL_ENTRY corrected;
+	corrected.m_Stamp.m_ullSize = 123456789012ULL;
+	corrected.m_Stamp.m_llModified = -42;
+	corrected.m_Stamp.m_ullHash = 0xFEDCBA9876543210ULL;
+	corrected.m_llOffset = -3600000;
+	corrected.m_csStatus = CRunJournal::CORRECTED;
+
+	JOURNAL_ENTRY missing;
+	missing.m_Stamp.m_ullSize = 1;
+	missing.m_Stamp.m_llModified = 1700000000;
+	missing.m_Stamp.m_ullHash = 0;
+	missing.m_llOffset = 1000;
+	missing.m_csStatus = CRunJournal::MISSING;
+
+	const string csPath = "/photos/a\tb%.jpg";
+	{
+		CRunJournal journal;
+		CHECK( journal.Open( csJournal.c_str() ) );
+		journal.Record( csPath, missing );
+		journal.Record( csPath, corrected );
+		journal.Record( "/photos/c.png", missing );
+		CHECK( journal.Close() );
+	}
+
+	// the header and one line per entry in the documented layout
+	string csText;
+	FILE* pFile = fopen( csJournal.c_str(), "rb" );
+	CHECK( pFile != nullptr );
+	if ( pFile != nullptr )
+	{
+		char buffer[ 4096 ];
+		size_t tRead = 0;
+		while ( ( tRead = fread( buffer, 1, sizeof( buffer ), pFile ) ) > 0 )
+		{
+			csText.append( buffer, tRead );
+		}
+		fclose( pFile );
+	}
+	CHECK
+	(
+		csText ==
+		string( CRunJournal::GetHeader() ) +
+		"/photos/a%09b%25.jpg\t1\t1700000000\t0000000000000000\t1000\tmissing\n"
+		"/photos/a%09b%25.jpg\t123456789012\t-42\tfedcba9876543210\t-3600000\tcorrected\n"
+		"/photos/c.png\t1\t1700000000\t0000000000000000\t1000\tmissing\n"
+	);
+
+	// a line cut short by a killed run is ignored
+	pFile = fopen( csJournal.c_str(), "ab" );
+	CHECK( pFile != nullptr );
+	if ( pFile != nullptr )
+	{
+		fputs( "/photos/d.jpg\t1\t2", pFile );
+		fclose( pFile );
+	}
+
+	// the last line of a path wins, a corrected file only counts for
+	// the same offset and a file without a date for any offset
+	CRunJournal journal;
+	CHECK( journal.Open( csJournal.c_str() ) );
+	CHECK( journal.GetUnchanged( csPath, corrected.m_Stamp, -3600000 ) );
+	CHECK( !journal.GetUnchanged( csPath, corrected.m_Stamp, 3600000 ) );
+	CHECK( !journal.GetUnchanged( csPath, missing.m_Stamp, -3600000 ) );
+	CHECK( journal.GetUnchanged( "/photos/c.png", missing.m_Stamp, 5 ) );
+	CHECK( !journal.GetUnchanged( "/photos/d.jpg", missing.m_Stamp, 5 ) );
+
+	FILE_STAMP touched = corrected.m_Stamp;
+	touched.m_llModified++;
+	CHECK( !journal.GetUnchanged( csPath, touched, -3600000 ) );
+	CHECK( journal.Close() );
+
+	remove( csJournal.c_str() );
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// CRCs of PNG chunks (over their type and data) and the standard check
+// value, whole and in pieces that do not fill the eight byte slices
+static void TestCrc32()
+{
+	CHECK( CCrc32::Update( 0, "IEND", 4 ) == 0xAE426082 );
+	CHECK( CCrc32::Update( 0, "123456789", 9 ) == 0xCBF43926 );
+	CHECK( CCrc32::Update( 0, "", 0 ) == 0 );
+
+	// the header chunk of a 1 by 1 pixel RGBA image
+	const unsigned char ihdr[ 17 ] =
+	{
+		'I', 'H', 'D', 'R', 0, 0, 0, 1, 0, 0, 0, 1, 8, 6, 0, 0, 0
+	};
+	CHECK( CCrc32::Update( 0, ihdr, sizeof( ihdr ) ) == 0x1F15C489 );
+
+	for ( size_t tSplit = 0; tSplit <= sizeof( ihdr ); tSplit++ )
+	{
+		const uint32_t ulCrc = CCrc32::Update( 0, ihdr, tSplit );
+		CHECK
+		(
+			CCrc32::Update( ulCrc, ihdr + tSplit, sizeof( ihdr ) - tSplit ) ==
+			0x1F15C489
+		);
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// run the named group of checks (or all of them) and return nonzero if
+// any of them failed
+int main( int argc, char* argv[] )
+{
+	typedef struct tagTest
+	{
+		const char* m_pcszName;
+		void( *m_pTest )();
+
+	} TEST;
+
+	static const TEST tests[] =
+	{
+		{ "ExifDate", TestExifDate },
+		{ "PlanManifest", TestPlanManifest },
+		{ "RunJournal", TestRunJournal },
+		{ "Crc32", TestCrc32 },
+	};
+
+	const char* pcszName = argc > 1 ? argv[ 1 ] : nullptr;
+	bool bFound = false;
+	for ( const TEST& test : tests )
+	{
+		if ( pcszName == nullptr || strcmp( pcszName, test.m_pcszName ) == 0 )
+		{
+			test.m_pTest();
+			bFound = true;
+		}
+	}
+
+	if ( !bFound )
+	{
+		printf( "Unknown test: %s\n", pcszName );
+		return 1;
+	}
+
+	printf( "%d failed\n", m_nFailed );
+	return m_nFailed == 0 ? 0 : 1;
+}